@@ -351,6 +351,7 @@ int PBSD_mgr_put(int, int, int, int, char *, struct attropl *, char *, int, char
 int PBSD_manager(int, int, int, int, char *, struct attropl *, char *);
 int PBSD_msg_put(int, char *, int, char *, char *, int, char **);
 int PBSD_relnodes_put(int, char *, char *, char *, int, char **);
+int PBSD_run_put(int, char *, char *, char *, int);
 int PBSD_py_spawn_put(int, char *, char **, char **, int, char **);
 int PBSD_sig_put(int, char *, char *, char *, int, char **);
 int PBSD_term_put(int, int, char *);
@@ -50,6 +50,45 @@
 #include "pbs_ecl.h"
 
 
+/**
+ * @brief
+ *	-send a run job batch request without reading the reply.
+ *	The caller reads the reply with PBSD_rdrpy() if req_type has one.
+ *
+ * @param[in] c - connection handle
+ * @param[in] jobid- job identifier
+ * @param[in] location - string of vnodes/resources to be allocated to the job
+ * @param[in] extend - extend string for encoding req
+ * @param[in] req_type - PBS_BATCH_RunJob, PBS_BATCH_AsyrunJob or PBS_BATCH_AsyrunJob_ack
+ *
+ * @return      int
+ * @retval      0       success
+ * @retval      !0      error
+ */
+int
+PBSD_run_put(int c, char *jobid, char *location, char *extend, int req_type)
+{
+	int rc;
+
+	if (location == NULL)
+		location = "";
+
+	DIS_tcp_funcs();
+
+	if ((rc = encode_DIS_ReqHdr(c, req_type, pbs_current_user)) ||
+		(rc = encode_DIS_Run(c, jobid, location, 0)) ||
+		(rc = encode_DIS_ReqExtend(c, extend))) {
+		if (set_conn_errtxt(c, dis_emsg[rc]) != 0)
+			return (pbs_errno = PBSE_SYSTEM);
+		return (pbs_errno = PBSE_PROTOCOL);
+	}
+
+	if (dis_flush(c))
+		return (pbs_errno = PBSE_PROTOCOL);
+
+	return 0;
+}
+
 /**
  * @brief	Inner function for pbs_asynrunjob and pbs_asynrunjob_ack
  *
@@ -67,14 +106,10 @@ static int
 __runjob_inner(int c, char *jobid, char *location, char *extend, int req_type)
 {
 	int rc = 0;
-	unsigned long resch = 0;
 
 	if ((jobid == NULL) || (*jobid == '\0'))
 		return (pbs_errno = PBSE_IVALREQ);
 
-	if (location == NULL)
-		location = "";
-
 	/* initialize the thread context data, if not already initialized */
 	if (pbs_client_thread_init_thread_context() != 0)
 		return pbs_errno;
@@ -84,26 +119,9 @@ __runjob_inner(int c, char *jobid, char *location, char *extend, int req_type)
 	if (pbs_client_thread_lock_connection(c) != 0)
 		return pbs_errno;
 
-	/* setup DIS support routines for following DIS calls */
-
-	DIS_tcp_funcs();
-
 	/* send run request */
 
-	if ((rc = encode_DIS_ReqHdr(c, req_type, pbs_current_user)) ||
-		(rc = encode_DIS_Run(c, jobid, location, resch)) ||
-		(rc = encode_DIS_ReqExtend(c, extend))) {
-		if (set_conn_errtxt(c, dis_emsg[rc]) != 0)
-			pbs_errno = PBSE_SYSTEM;
-		else
-			pbs_errno = PBSE_PROTOCOL;
-
-		pbs_client_thread_unlock_connection(c);
-		return pbs_errno;
-	}
-
-	if (dis_flush(c)) {
-		pbs_errno = PBSE_PROTOCOL;
+	if (PBSD_run_put(c, jobid, location, extend, req_type) != 0) {
 		pbs_client_thread_unlock_connection(c);
 		return pbs_errno;
 	}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file    arena.cpp
+ *
+ * @brief
+ * 		arena.cpp - per-cycle arena for small scheduler objects.
+ *
+ * Functions included are:
+ * 	arena_alloc()
+ * 	arena_free()
+ * 	arena_cycle_start()
+ * 	arena_cycle_end()
+ * 	arena_stats()
+ * 	arena_suspend()
+ * 	arena_resume()
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <new>
+#include <vector>
+
+#include "constant.h"
+#include "log.h"
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_NUM_CLASSES (ARENA_MAX_OBJ_SIZE / ARENA_ALIGN)
+
+/* the kind of memory behind an object */
+#define ARENA_KIND_HEAP 0x50414548
+#define ARENA_KIND_CYCLE 0x4c435943
+
+/* header in front of every object handed out by arena_alloc() */
+union arena_hdr {
+	struct {
+		unsigned int kind;	/* ARENA_KIND_HEAP or ARENA_KIND_CYCLE */
+		unsigned int sclass;	/* size class of an arena object */
+	} h;
+	char pad[ARENA_ALIGN];
+};
+
+/* the arena of one thread */
+struct arena_thread {
+	std::vector<char *> blocks;	/* blocks allocated this cycle */
+	char *cur;			/* next free byte in the current block */
+	size_t left;			/* bytes left in the current block */
+	void *free_list[ARENA_NUM_CLASSES];	/* freed objects by size class */
+	int suspended;			/* arena_suspend() nesting level */
+	size_t num_objs;		/* objects handed out this cycle */
+};
+
+static std::vector<arena_thread *> arenas;	/* arenas of all threads */
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool arena_active = false;
+static thread_local arena_thread *my_arena = NULL;
+
+/**
+ * @brief	return the calling thread's arena, creating it on first use
+ *
+ * @return	arena_thread *
+ * @retval	NULL	: malloc error
+ */
+static arena_thread *
+get_arena(void)
+{
+	if (my_arena != NULL)
+		return my_arena;
+
+	try {
+		my_arena = new arena_thread();
+	} catch (std::bad_alloc &e) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&arena_lock);
+	arenas.push_back(my_arena);
+	pthread_mutex_unlock(&arena_lock);
+
+	return my_arena;
+}
+
+/**
+ * @brief	allocate a zeroed object.  During a cycle, small objects come
+ *		from the calling thread's arena.  Otherwise they come from the heap.
+ *
+ * @param[in]	size - size of the object
+ *
+ * @return	void *
+ * @retval	the new object
+ * @retval	NULL	: malloc error
+ */
+void *
+arena_alloc(size_t size)
+{
+	arena_hdr *hdr;
+	arena_thread *at;
+
+	if (arena_active && size <= ARENA_MAX_OBJ_SIZE && (at = get_arena()) != NULL && at->suspended == 0) {
+		size_t sclass = size == 0 ? 0 : (size - 1) / ARENA_ALIGN;
+		size_t osize = (sclass + 1) * ARENA_ALIGN;
+		void *obj;
+
+		at->num_objs++;
+		if (at->free_list[sclass] != NULL) {
+			obj = at->free_list[sclass];
+			at->free_list[sclass] = *static_cast<void **>(obj);
+			memset(obj, 0, osize);
+			return obj;
+		}
+
+		if (at->left < sizeof(arena_hdr) + osize) {
+			char *block;
+
+			block = static_cast<char *>(malloc(ARENA_BLOCK_SIZE));
+			if (block != NULL) {
+				at->blocks.push_back(block);
+				at->cur = block;
+				at->left = ARENA_BLOCK_SIZE;
+			}
+		}
+
+		if (at->left >= sizeof(arena_hdr) + osize) {
+			hdr = reinterpret_cast<arena_hdr *>(at->cur);
+			at->cur += sizeof(arena_hdr) + osize;
+			at->left -= sizeof(arena_hdr) + osize;
+
+			hdr->h.kind = ARENA_KIND_CYCLE;
+			hdr->h.sclass = sclass;
+			obj = hdr + 1;
+			memset(obj, 0, osize);
+			return obj;
+		}
+		/* could not get a new block, fall back to the heap */
+	}
+
+	hdr = static_cast<arena_hdr *>(calloc(1, sizeof(arena_hdr) + size));
+	if (hdr == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	hdr->h.kind = ARENA_KIND_HEAP;
+
+	return hdr + 1;
+}
+
+/**
+ * @brief	free an object allocated by arena_alloc().  Arena objects are
+ *		kept for reuse by the calling thread until the end of the cycle.
+ *
+ * @param[in]	ptr - the object
+ *
+ * @return	void
+ */
+void
+arena_free(void *ptr)
+{
+	arena_hdr *hdr;
+	arena_thread *at;
+
+	if (ptr == NULL)
+		return;
+
+	hdr = static_cast<arena_hdr *>(ptr) - 1;
+	if (hdr->h.kind == ARENA_KIND_CYCLE) {
+		if ((at = get_arena()) != NULL) {
+			*static_cast<void **>(ptr) = at->free_list[hdr->h.sclass];
+			at->free_list[hdr->h.sclass] = ptr;
+		}
+		return;
+	}
+
+	free(hdr);
+}
+
+/**
+ * @brief	start allocating small objects from the arena
+ *
+ * @return	void
+ */
+void
+arena_cycle_start(void)
+{
+	arena_active = true;
+}
+
+/**
+ * @brief	release every thread's arena.  All objects allocated from the
+ *		arena this cycle must be gone by now.
+ *
+ * @note	must be called while no worker threads are running
+ *
+ * @return	void
+ */
+void
+arena_cycle_end(void)
+{
+	arena_active = false;
+
+	pthread_mutex_lock(&arena_lock);
+	for (auto at : arenas) {
+		for (auto block : at->blocks)
+			free(block);
+		at->blocks.clear();
+		at->cur = NULL;
+		at->left = 0;
+		memset(at->free_list, 0, sizeof(at->free_list));
+		at->num_objs = 0;
+	}
+	pthread_mutex_unlock(&arena_lock);
+}
+
+/**
+ * @brief	count the objects and blocks every thread's arena handed out
+ *		this cycle
+ *
+ * @param[out]	num_objs - number of objects allocated from the arena
+ * @param[out]	num_blocks - number of arena blocks
+ *
+ * @note	must be called while no worker threads are running
+ *
+ * @return	void
+ */
+void
+arena_stats(size_t *num_objs, size_t *num_blocks)
+{
+	*num_objs = 0;
+	*num_blocks = 0;
+
+	pthread_mutex_lock(&arena_lock);
+	for (auto at : arenas) {
+		*num_objs += at->num_objs;
+		*num_blocks += at->blocks.size();
+	}
+	pthread_mutex_unlock(&arena_lock);
+}
+
+/**
+ * @brief	allocate from the heap on the calling thread until arena_resume().
+ *		Used when creating objects which outlive the cycle.
+ *
+ * @return	void
+ */
+void
+arena_suspend(void)
+{
+	arena_thread *at;
+
+	if ((at = get_arena()) != NULL)
+		at->suspended++;
+}
+
+/**
+ * @brief	undo arena_suspend()
+ *
+ * @return	void
+ */
+void
+arena_resume(void)
+{
+	arena_thread *at;
+
+	if ((at = get_arena()) != NULL && at->suspended > 0)
+		at->suspended--;
+}
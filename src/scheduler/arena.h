@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+#ifndef SRC_SCHEDULER_ARENA_H_
+#define SRC_SCHEDULER_ARENA_H_
+
+#include <stddef.h>
+
+/*
+ * Per-cycle arena for the small fixed size objects the scheduler creates by
+ * the million each cycle (resource_req, nspec, chunk).  While a cycle is
+ * running, these are carved out of large per-thread blocks and freed objects
+ * are kept on per-thread free lists for reuse.  All blocks are released at
+ * once at the end of the cycle.  Outside of a cycle, or while the arena is
+ * suspended on the calling thread, objects come from the heap.
+ */
+
+#define ARENA_BLOCK_SIZE (256 * 1024)	/* size of one arena block */
+#define ARENA_MAX_OBJ_SIZE 512		/* larger objects always come from the heap */
+
+void *arena_alloc(size_t size);
+void arena_free(void *ptr);
+
+void arena_cycle_start(void);
+void arena_cycle_end(void);
+
+void arena_stats(size_t *num_objs, size_t *num_blocks);
+
+void arena_suspend(void);
+void arena_resume(void);
+
+#endif /* SRC_SCHEDULER_ARENA_H_ */
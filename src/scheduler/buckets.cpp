@@ -55,6 +55,8 @@
 #include "sort.h"
 #include "node_partition.h"
 #include "check.h"
+#include "multi_threading.h"
+#include "queue.h"
 #include <log.h>
 #include "pbs_internal.h"
 
@@ -380,6 +382,150 @@ char *create_node_bucket_name(status *policy, node_bucket *nb) {
 
 }
 
+/**
+ * @brief compute a digest of what a node is bucketed on: the resources in
+ *	  resdef_to_check_no_hostvnode, its booleans, its queue and its priority.
+ *	  Nodes which belong in the same bucket have the same digest.
+ *
+ * @param[in] policy - policy info
+ * @param[in] node - the node
+ * @param[in] qinfo - the queue the node is associated with or NULL
+ *
+ * @return unsigned long long - the digest
+ */
+static unsigned long long
+node_bucket_digest(status *policy, node_info *node, queue_info *qinfo)
+{
+	unsigned long long digest = 0;
+	unsigned long long h;
+	schd_resource *res;
+
+	/* per resource digests are summed, so the order of the resource list does not matter */
+	for (res = node->res; res != NULL; res = res->next) {
+		if (res->type.is_boolean) {
+			/* unset booleans are false, so false ones are left out too */
+			if (res->avail == 0)
+				continue;
+		} else if (policy->resdef_to_check_no_hostvnode.find(res->def) == policy->resdef_to_check_no_hostvnode.end())
+			continue;
+
+		h = digest_str(14695981039346656037ULL, res->name);
+		if (res->def->type.is_string) {
+			int i;
+
+			if (res->str_avail != NULL) {
+				for (i = 0; res->str_avail[i] != NULL; i++)
+					h += digest_str(14695981039346656037ULL, res->str_avail[i]);
+			}
+		} else {
+			unsigned long long bits;
+			sch_resource_t avail = res->avail + 0.0; /* fold -0 into 0 */
+
+			memcpy(&bits, &avail, sizeof(bits));
+			h = (h ^ bits) * 1099511628211ULL;
+		}
+		digest += h * 1099511628211ULL;
+	}
+
+	digest = digest_str(digest, qinfo == NULL ? NULL : qinfo->name.c_str());
+	digest = (digest ^ static_cast<unsigned int>(node->priority)) * 1099511628211ULL;
+
+	return digest;
+}
+
+/* the pools of a node_bucket a node can be in */
+enum node_bucket_pool_type {
+	BKT_POOL_FREE,
+	BKT_POOL_BUSY_LATER,
+	BKT_POOL_BUSY
+};
+
+/**
+ * @brief which pool of its bucket a node belongs in
+ *
+ * @param[in] node - the node
+ *
+ * @return the pool
+ */
+static enum node_bucket_pool_type
+node_bucket_pool(node_info *node)
+{
+	if (node->is_free && node->num_jobs == 0 && node->num_run_resv == 0) {
+		if (node->node_events != NULL)
+			return BKT_POOL_BUSY_LATER;
+		return BKT_POOL_FREE;
+	}
+	return BKT_POOL_BUSY;
+}
+
+/**
+ * @brief find a pool of a bucket
+ *
+ * @param[in] nb - the bucket
+ * @param[in] pool - which pool
+ *
+ * @return the pool
+ */
+static bucket_bitpool *
+bucket_pool(node_bucket *nb, enum node_bucket_pool_type pool)
+{
+	switch (pool) {
+		case BKT_POOL_FREE:
+			return nb->free_pool;
+		case BKT_POOL_BUSY_LATER:
+			return nb->busy_later_pool;
+		default:
+			return nb->busy_pool;
+	}
+}
+
+/**
+ * @brief create an empty node bucket for the kind of node a node is
+ *
+ * @param[in] policy - policy info
+ * @param[in] node - the node
+ * @param[in] qinfo - the queue the node is associated with or NULL
+ * @param[in] flags - NO_PRINT_BUCKETS - do not print that a bucket has been created
+ *
+ * @return node_bucket *
+ * @retval the new bucket
+ * @retval NULL on error
+ */
+static node_bucket *
+new_bucket_for_node(status *policy, node_info *node, queue_info *qinfo, unsigned int flags)
+{
+	node_bucket *nb;
+	schd_resource *cur_res;
+
+	nb = new_node_bucket(1);
+	if (nb == NULL)
+		return NULL;
+
+	nb->res_spec = dup_selective_resource_list(node->res, policy->resdef_to_check_no_hostvnode,
+						   (ADD_UNSET_BOOLS_FALSE | ADD_ALL_BOOL));
+	if (nb->res_spec == NULL) {
+		free_node_bucket(nb);
+		return NULL;
+	}
+
+	nb->queue = qinfo;
+	nb->priority = node->priority;
+
+	for (cur_res = nb->res_spec; cur_res != NULL; cur_res = cur_res->next)
+		if (cur_res->type.is_consumable)
+			cur_res->assigned = 0;
+
+	nb->name = create_node_bucket_name(policy, nb);
+	if (nb->name == NULL) {
+		free_node_bucket(nb);
+		return NULL;
+	}
+	if (!(flags & NO_PRINT_BUCKETS))
+		log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_NODE, LOG_DEBUG, "create_node_buckets", "Created node bucket %s", nb->name);
+
+	return nb;
+}
+
 /**
  * @brief create node buckets from an array of nodes
  * @param[in] policy - policy info
@@ -399,6 +545,8 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 	node_bucket **buckets = NULL;
 	node_bucket **tmp;
 	int node_ct;
+	/* node_bucket_digest() -> indices of buckets with that digest */
+	std::unordered_multimap<unsigned long long, int> bkt_digests;
 
 	if (policy == NULL || nodes == NULL)
 		return NULL;
@@ -414,9 +562,11 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 
 	for (i = 0; i < node_ct; i++) {
 		node_bucket *nb = NULL;
+		bucket_bitpool *bp;
 		int bkt_ind;
 		queue_info *qinfo = NULL;
 		int node_ind = nodes[i]->node_ind;
+		unsigned long long digest;
 
 		if (nodes[i]->is_down || nodes[i]->is_offline || node_ind == -1 || nodes[i]->lic_lock == 0)
 			continue;
@@ -424,7 +574,17 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 		if (queues != NULL && !nodes[i]->queue_name.empty())
 			qinfo = find_queue_info(queues, nodes[i]->queue_name);
 
-		bkt_ind = find_node_bucket_ind(buckets, nodes[i]->res, qinfo, nodes[i]->priority);
+		digest = node_bucket_digest(policy, nodes[i], qinfo);
+		bkt_ind = -1;
+		auto range = bkt_digests.equal_range(digest);
+		for (auto it = range.first; it != range.second; ++it) {
+			node_bucket *b = buckets[it->second];
+			if (b->queue == qinfo && b->priority == nodes[i]->priority &&
+			    compare_resource_avail_list(b->res_spec, nodes[i]->res)) {
+				bkt_ind = it->second;
+				break;
+			}
+		}
 		if (flags & UPDATE_BUCKET_IND) {
 			if (bkt_ind == -1)
 				nodes[i]->bucket_ind = j;
@@ -436,64 +596,21 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 
 
 		if (nb == NULL) { /* no bucket found, need to add one*/
-			schd_resource *cur_res;
-			buckets[j] = new_node_bucket(1);
-
+			buckets[j] = new_bucket_for_node(policy, nodes[i], qinfo, flags);
 			if (buckets[j] == NULL) {
 				free_node_bucket_array(buckets);
 				return NULL;
 			}
 
-			buckets[j]->res_spec = dup_selective_resource_list(nodes[i]->res, policy->resdef_to_check_no_hostvnode,
-									   (ADD_UNSET_BOOLS_FALSE | ADD_ALL_BOOL));
-
-			if (buckets[j]->res_spec == NULL) {
-				free_node_bucket_array(buckets);
-				return NULL;
-			}
-
-			if (qinfo != NULL)
-				buckets[j]->queue = qinfo;
-
-			buckets[j]->priority = nodes[i]->priority;
-
-			for (cur_res = buckets[j]->res_spec; cur_res != NULL; cur_res = cur_res->next)
-				if (cur_res->type.is_consumable)
-					cur_res->assigned = 0;
-
-
-			buckets[j]->busy_later_pool->truth_ct = 0;
-			buckets[j]->free_pool->truth_ct = 0;
-			buckets[j]->busy_pool->truth_ct = 0;
-
-			buckets[j]->total = 0;
-
-			buckets[j]->name = create_node_bucket_name(policy, buckets[j]);
-			if (buckets[j]->name == NULL) {
-				free_node_bucket_array(buckets);
-				return NULL;
-			}
-			if (!(flags & NO_PRINT_BUCKETS))
-				log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_NODE, LOG_DEBUG, __func__, "Created node bucket %s", buckets[j]->name);
-
 			nb = buckets[j];
+			bkt_digests.emplace(digest, j);
 			j++;
 		}
 		pbs_bitmap_bit_on(nb->bkt_nodes, node_ind);
 		nb->total++;
-		if (nodes[i]->is_free && nodes[i]->num_jobs == 0 && nodes[i]->num_run_resv == 0) {
-			if (nodes[i]->node_events != NULL) {
-				pbs_bitmap_bit_on(nb->busy_later_pool->truth, node_ind);
-				nb->busy_later_pool->truth_ct++;
-			}
-			else {
-				pbs_bitmap_bit_on(nb->free_pool->truth, node_ind);
-				nb->free_pool->truth_ct++;
-			}
-		} else {
-			pbs_bitmap_bit_on(nb->busy_pool->truth, node_ind);
-			nb->busy_pool->truth_ct++;
-		}
+		bp = bucket_pool(nb, node_bucket_pool(nodes[i]));
+		pbs_bitmap_bit_on(bp->truth, node_ind);
+		bp->truth_ct++;
 	}
 
 	if (j == 0) {
@@ -513,6 +630,265 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 	return buckets;
 }
 
+/* where a node was put by update_node_buckets() */
+struct bucket_cache_node {
+	unsigned long long digest;	/* node_bucket_digest() of the node */
+	int node_ind;			/* the node's node_ind */
+	int bkt;			/* index into bucket_cache.buckets */
+	enum node_bucket_pool_type pool;	/* the pool of the bucket the node is in */
+	unsigned int gen;		/* the last update the node was seen in */
+};
+
+/* The server's node buckets, kept across cycles.  The buckets here are
+ * masters: each cycle gets copies, because the simulation changes the
+ * pools of its buckets as it runs jobs.
+ */
+static struct {
+	std::vector<node_bucket *> buckets;
+	std::vector<std::string> queues;	/* name of each bucket's queue or "" */
+	std::unordered_multimap<unsigned long long, int> digests; /* digest -> index in buckets */
+	std::unordered_map<std::string, bucket_cache_node> nodes; /* node name -> where it is */
+	unsigned int gen;
+} bucket_cache;
+
+/**
+ * @brief forget the node buckets kept across cycles.  Needs to be called
+ *	  when the resource definitions or the policy the buckets were
+ *	  created with change.
+ *
+ * @return void
+ */
+void
+free_node_bucket_cache(void)
+{
+	for (auto nb : bucket_cache.buckets)
+		free_node_bucket(nb);
+	bucket_cache.buckets.clear();
+	bucket_cache.queues.clear();
+	bucket_cache.digests.clear();
+	bucket_cache.nodes.clear();
+}
+
+/**
+ * @brief take a node out of the bucket it was put in by an earlier update
+ *
+ * @param[in] cn - where the node is
+ *
+ * @return void
+ */
+static void
+bucket_cache_remove_node(const bucket_cache_node &cn)
+{
+	node_bucket *nb = bucket_cache.buckets[cn.bkt];
+	bucket_bitpool *bp = bucket_pool(nb, cn.pool);
+
+	pbs_bitmap_bit_off(nb->bkt_nodes, cn.node_ind);
+	nb->total--;
+	pbs_bitmap_bit_off(bp->truth, cn.node_ind);
+	bp->truth_ct--;
+}
+
+/**
+ * @brief drop the buckets which no longer hold any nodes
+ *
+ * @return void
+ */
+static void
+bucket_cache_compact(void)
+{
+	std::vector<int> new_ind(bucket_cache.buckets.size(), -1);
+	std::size_t j = 0;
+
+	for (std::size_t i = 0; i < bucket_cache.buckets.size(); i++) {
+		if (bucket_cache.buckets[i]->total == 0) {
+			free_node_bucket(bucket_cache.buckets[i]);
+			continue;
+		}
+		bucket_cache.buckets[j] = bucket_cache.buckets[i];
+		bucket_cache.queues[j] = bucket_cache.queues[i];
+		new_ind[i] = j++;
+	}
+	if (j == bucket_cache.buckets.size())
+		return;
+
+	bucket_cache.buckets.resize(j);
+	bucket_cache.queues.resize(j);
+
+	for (auto it = bucket_cache.digests.begin(); it != bucket_cache.digests.end();) {
+		if (new_ind[it->second] == -1)
+			it = bucket_cache.digests.erase(it);
+		else {
+			it->second = new_ind[it->second];
+			++it;
+		}
+	}
+	for (auto &n : bucket_cache.nodes)
+		n.second.bkt = new_ind[n.second.bkt];
+}
+
+/**
+ * @brief create the server's node buckets for this cycle.  The buckets are
+ *	  kept across cycles and only the nodes whose resources, queue,
+ *	  priority or state changed are moved.  The bucket_ind member of
+ *	  each node is set.
+ *
+ * @param[in] policy - policy info
+ * @param[in] nodes - the server's nodes
+ * @param[in] queues - the server's queues
+ *
+ * @return node_bucket **
+ * @retval this cycle's copy of the buckets, sorted by the node_sort_key
+ * @retval NULL on error or if there are no buckets
+ */
+node_bucket **
+update_node_buckets(status *policy, node_info **nodes, queue_info **queues)
+{
+	node_bucket **buckets;
+	int i;
+
+	if (policy == NULL || nodes == NULL)
+		return NULL;
+
+	bucket_cache.gen++;
+
+	/* queue_info is queried anew every cycle */
+	for (std::size_t b = 0; b < bucket_cache.buckets.size(); b++) {
+		if (bucket_cache.queues[b].empty() || queues == NULL)
+			bucket_cache.buckets[b]->queue = NULL;
+		else
+			bucket_cache.buckets[b]->queue = find_queue_info(queues, bucket_cache.queues[b]);
+	}
+
+	for (i = 0; nodes[i] != NULL; i++) {
+		node_info *node = nodes[i];
+		queue_info *qinfo = NULL;
+		int node_ind = node->node_ind;
+		unsigned long long digest;
+		int bkt_ind = -1;
+
+		if (node->is_down || node->is_offline || node_ind == -1 || node->lic_lock == 0)
+			continue;
+
+		if (queues != NULL && !node->queue_name.empty())
+			qinfo = find_queue_info(queues, node->queue_name);
+
+		digest = node_bucket_digest(policy, node, qinfo);
+		auto pool = node_bucket_pool(node);
+		auto cit = bucket_cache.nodes.find(node->name);
+
+		if (cit != bucket_cache.nodes.end()) {
+			bucket_cache_node &cn = cit->second;
+
+			cn.gen = bucket_cache.gen;
+			/* the digest covers everything the node is bucketed on */
+			if (cn.digest == digest && cn.node_ind == node_ind) {
+				if (cn.pool != pool) {
+					bucket_bitpool *bp = bucket_pool(bucket_cache.buckets[cn.bkt], cn.pool);
+
+					pbs_bitmap_bit_off(bp->truth, node_ind);
+					bp->truth_ct--;
+					bp = bucket_pool(bucket_cache.buckets[cn.bkt], pool);
+					pbs_bitmap_bit_on(bp->truth, node_ind);
+					bp->truth_ct++;
+					cn.pool = pool;
+				}
+				continue;
+			}
+			bucket_cache_remove_node(cn);
+		}
+
+		auto range = bucket_cache.digests.equal_range(digest);
+		for (auto it = range.first; it != range.second; ++it) {
+			node_bucket *b = bucket_cache.buckets[it->second];
+			if (b->queue == qinfo && b->priority == node->priority &&
+			    compare_resource_avail_list(b->res_spec, node->res)) {
+				bkt_ind = it->second;
+				break;
+			}
+		}
+		if (bkt_ind == -1) {
+			node_bucket *nb = new_bucket_for_node(policy, node, qinfo, NO_FLAGS);
+			if (nb == NULL) {
+				free_node_bucket_cache();
+				return NULL;
+			}
+			bkt_ind = bucket_cache.buckets.size();
+			bucket_cache.buckets.push_back(nb);
+			bucket_cache.queues.push_back(qinfo != NULL ? qinfo->name : "");
+			bucket_cache.digests.emplace(digest, bkt_ind);
+		}
+
+		node_bucket *nb = bucket_cache.buckets[bkt_ind];
+		bucket_bitpool *bp = bucket_pool(nb, pool);
+		pbs_bitmap_bit_on(nb->bkt_nodes, node_ind);
+		nb->total++;
+		pbs_bitmap_bit_on(bp->truth, node_ind);
+		bp->truth_ct++;
+
+		bucket_cache.nodes[node->name] = {digest, node_ind, bkt_ind, pool, bucket_cache.gen};
+	}
+
+	/* nodes which are gone, down or offline */
+	for (auto it = bucket_cache.nodes.begin(); it != bucket_cache.nodes.end();) {
+		if (it->second.gen != bucket_cache.gen) {
+			bucket_cache_remove_node(it->second);
+			it = bucket_cache.nodes.erase(it);
+		} else
+			++it;
+	}
+	bucket_cache_compact();
+
+	if (bucket_cache.buckets.empty())
+		return NULL;
+
+	buckets = static_cast<node_bucket **>(malloc((bucket_cache.buckets.size() + 1) * sizeof(node_bucket *)));
+	if (buckets == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	std::unordered_map<node_bucket *, int> master_ind;
+	for (std::size_t b = 0; b < bucket_cache.buckets.size(); b++) {
+		node_bucket *onb = bucket_cache.buckets[b];
+		node_bucket *nnb = new_node_bucket(0);
+
+		/* dup_node_bucket() needs a server to find the queue in */
+		if (nnb != NULL) {
+			nnb->busy_pool = dup_bucket_bitpool(onb->busy_pool);
+			nnb->busy_later_pool = dup_bucket_bitpool(onb->busy_later_pool);
+			nnb->free_pool = dup_bucket_bitpool(onb->free_pool);
+			nnb->res_spec = dup_resource_list(onb->res_spec);
+			nnb->name = string_dup(onb->name);
+		}
+		if (nnb == NULL || nnb->busy_pool == NULL || nnb->busy_later_pool == NULL ||
+		    nnb->free_pool == NULL || nnb->res_spec == NULL || nnb->name == NULL ||
+		    pbs_bitmap_assign(nnb->bkt_nodes, onb->bkt_nodes) == 0) {
+			free_node_bucket(nnb);
+			buckets[b] = NULL;
+			free_node_bucket_array(buckets);
+			return NULL;
+		}
+		nnb->queue = onb->queue;
+		nnb->priority = onb->priority;
+		nnb->total = onb->total;
+		buckets[b] = nnb;
+		master_ind[nnb] = b;
+	}
+	buckets[bucket_cache.buckets.size()] = NULL;
+
+	qsort(buckets, bucket_cache.buckets.size(), sizeof(node_bucket *), multi_bkt_sort);
+
+	std::vector<int> sorted_ind(bucket_cache.buckets.size());
+	for (std::size_t b = 0; buckets[b] != NULL; b++)
+		sorted_ind[master_ind[buckets[b]]] = b;
+	for (i = 0; nodes[i] != NULL; i++) {
+		auto cit = bucket_cache.nodes.find(nodes[i]->name);
+		if (cit != bucket_cache.nodes.end() && cit->second.gen == bucket_cache.gen)
+			nodes[i]->bucket_ind = sorted_ind[cit->second.bkt];
+	}
+
+	return buckets;
+}
+
 /* chunk_map constructor */
 chunk_map *
 new_chunk_map() {
@@ -628,29 +1004,26 @@ bucket_match(chunk_map **cmap, resource_resv *resresv, schd_error *err)
 	int i;
 	int j;
 	int k;
-	static pbs_bitmap *zeromap = NULL;
 	server_info *sinfo;
+	pbs_bitmap *taken;	/* nodes taken from a free pool at once */
 
 	if (cmap == NULL || resresv == NULL || resresv->select == NULL)
 		return 0;
 
-	if (zeromap == NULL) {
-		zeromap = pbs_bitmap_alloc(NULL, 1);
-		if (zeromap == NULL)
-			return 0;
-	}
-
 	sinfo = resresv->server;
 
 	for (i = 0; cmap[i] != NULL; i++) {
 		if (cmap[i]->bkt_cnts != NULL) {
-			for (j = 0; cmap[i]->bkt_cnts[j] != NULL; j++) {
+			for (j = 0; cmap[i]->bkt_cnts[j] != NULL; j++)
 				set_working_bucket_to_truth(cmap[i]->bkt_cnts[j]->bkt);
-				pbs_bitmap_assign(cmap[i]->node_bits, zeromap);
-			}
+			pbs_bitmap_clear(cmap[i]->node_bits);
 		}
 	}
 
+	taken = pbs_bitmap_alloc(NULL, 1);
+	if (taken == NULL)
+		return 0;
+
 	for (i = 0; cmap[i] != NULL; i++) {
 		int num_chunks_needed = cmap[i]->chk->num_chunks;
 
@@ -684,8 +1057,30 @@ bucket_match(chunk_map **cmap, resource_resv *resresv, schd_error *err)
 
 			}
 
+			/* Without provisioning, every free node will do.  Take as many as
+			 * are needed a word at a time.
+			 */
+			if (resresv->aoename == NULL && num_chunks_needed > chunks_added) {
+				int cc = cmap[i]->bkt_cnts[j]->chunk_count;
+				unsigned long nodes_needed;
+				unsigned long ct;
+
+				if (cc <= 0)
+					cc = 1;
+				nodes_needed = (num_chunks_needed - chunks_added + cc - 1) / cc;
+				ct = pbs_bitmap_first_n_on_bits(taken, bkt->free_pool->working, nodes_needed);
+				if (ct > 0) {
+					pbs_bitmap_andnot(bkt->free_pool->working, taken);
+					bkt->free_pool->working_ct -= ct;
+					pbs_bitmap_or(bkt->busy_pool->working, taken);
+					bkt->busy_pool->working_ct += ct;
+					pbs_bitmap_or(cmap[i]->node_bits, taken);
+					chunks_added += ct * cmap[i]->bkt_cnts[j]->chunk_count;
+				}
+			}
+
 			for (k = pbs_bitmap_first_on_bit(bkt->free_pool->working);
-			     num_chunks_needed > chunks_added && k >= 0;
+			     resresv->aoename != NULL && num_chunks_needed > chunks_added && k >= 0;
 			     k = pbs_bitmap_next_on_bit(bkt->free_pool->working, k)) {
 				clear_schd_error(err);
 				if (resresv->aoename != NULL) {
@@ -707,10 +1102,13 @@ bucket_match(chunk_map **cmap, resource_resv *resresv, schd_error *err)
 				num_chunks_needed -= chunks_added;
 		}
 		/* Couldn't find buckets to satisfy all the chunks */
-		if (num_chunks_needed > 0)
+		if (num_chunks_needed > 0) {
+			pbs_bitmap_free(taken);
 			return 0;
+		}
 	}
 
+	pbs_bitmap_free(taken);
 	return 1;
 }
 
@@ -833,29 +1231,44 @@ bucket_to_nspecs(status *policy, chunk_map **cb_map, resource_resv *resresv)
 
 	for (i = 0; cb_map[i] != NULL; i++) {
 		int chunks_needed = cb_map[i]->chk->num_chunks;
-		for (j = pbs_bitmap_first_on_bit(cb_map[i]->node_bits); j >= 0;
-		     j = pbs_bitmap_next_on_bit(cb_map[i]->node_bits, j)) {
-			/* Find the bucket the node is in */
-			if (cb_map[i]->bkt_cnts != NULL) {
-				for (k = 0; cb_map[i]->bkt_cnts[k] != NULL; k++)
-					if (pbs_bitmap_get_bit(cb_map[i]->bkt_cnts[k]->bkt->bkt_nodes, j)) {
-						cnt = cb_map[i]->bkt_cnts[k]->chunk_count;
-						break;
+		node_bucket_count *nbc = NULL;
+		unsigned long run_len;
+		long run;
+
+		/* Walk the nodes a run of on bits at a time.  Nodes next to each other
+		 * are usually in the same bucket, so the bucket of the previous node is
+		 * tried before all of them are searched.
+		 */
+		for (run = pbs_bitmap_next_on_run(cb_map[i]->node_bits, 0, &run_len); run >= 0;
+		     run = pbs_bitmap_next_on_run(cb_map[i]->node_bits, run + run_len, &run_len)) {
+			for (j = run; j < run + static_cast<long>(run_len); j++) {
+				/* Find the bucket the node is in */
+				if (cb_map[i]->bkt_cnts != NULL) {
+					if (nbc == NULL || !pbs_bitmap_get_bit(nbc->bkt->bkt_nodes, j)) {
+						nbc = NULL;
+						for (k = 0; cb_map[i]->bkt_cnts[k] != NULL; k++)
+							if (pbs_bitmap_get_bit(cb_map[i]->bkt_cnts[k]->bkt->bkt_nodes, j)) {
+								nbc = cb_map[i]->bkt_cnts[k];
+								break;
+							}
 					}
-			} else {
-				/* Error case(shouldn't happen): the bkt_cnts is NULL.  Only assign one chunk.
-				 * This could cause us not to allocate enough chunks in free placement
+					if (nbc != NULL)
+						cnt = nbc->chunk_count;
+				} else {
+					/* Error case(shouldn't happen): the bkt_cnts is NULL.  Only assign one chunk.
+					 * This could cause us not to allocate enough chunks in free placement
+					 */
+					cnt = 1;
+				}
+				/* Allocate the chunks.  For all but the final chunk, we need to allocate cnt chunks,
+				 * For the final chunk, we might allocate less.
 				 */
-				cnt = 1;
-			}
-			/* Allocate the chunks.  For all but the final chunk, we need to allocate cnt chunks,
-			 * For the final chunk, we might allocate less.
-			 */
-			for( ; cnt > 0 && chunks_needed > 0; cnt--, chunks_needed--, n++) {
-				ns_arr[n] = chunk_to_nspec(policy, cb_map[i]->chk, sinfo->unordered_nodes[j], resresv->aoename);
-				if (ns_arr[n] == NULL) {
-					free_nspecs(ns_arr);
-					return NULL;
+				for( ; cnt > 0 && chunks_needed > 0; cnt--, chunks_needed--, n++) {
+					ns_arr[n] = chunk_to_nspec(policy, cb_map[i]->chk, sinfo->unordered_nodes[j], resresv->aoename);
+					if (ns_arr[n] == NULL) {
+						free_nspecs(ns_arr);
+						return NULL;
+					}
 				}
 			}
 		}
@@ -949,19 +1362,17 @@ find_correct_buckets(status *policy, node_bucket **buckets, resource_resv *resre
 	int i, j;
 	int can_run = 1;
 	chunk_map **cb_map;
-	static struct schd_error *failerr = NULL;
+	struct schd_error *failerr;
 
 	if (policy == NULL || buckets == NULL || resresv == NULL || resresv->select == NULL || resresv->select->chunks == NULL || err == NULL)
 		return NULL;
 
+	/* not static: placement sets may be searched by several threads at once */
+	failerr = new_schd_error();
 	if (failerr == NULL) {
-		failerr = new_schd_error();
-		if (failerr == NULL) {
-			set_schd_error_codes(err, NOT_RUN, SCHD_ERROR);
-			return 0;
-		}
-	} else
-		clear_schd_error(failerr);
+		set_schd_error_codes(err, NOT_RUN, SCHD_ERROR);
+		return NULL;
+	}
 
 	bucket_ct = count_array(buckets);
 	chunk_ct = count_array(resresv->select->chunks);
@@ -969,6 +1380,7 @@ find_correct_buckets(status *policy, node_bucket **buckets, resource_resv *resre
 	cb_map = static_cast<chunk_map **>(calloc((chunk_ct + 1), sizeof(chunk_map *)));
 	if (cb_map == NULL) {
 		log_err(errno, __func__, MEM_ERR_MSG);
+		free_schd_error(failerr);
 		return NULL;
 	}
 
@@ -978,6 +1390,7 @@ find_correct_buckets(status *policy, node_bucket **buckets, resource_resv *resre
 		cb_map[i] = new_chunk_map();
 		if (cb_map[i] == NULL) {
 			free_chunk_map_array(cb_map);
+			free_schd_error(failerr);
 			return NULL;
 		}
 		cb_map[i]->chk = resresv->select->chunks[i];
@@ -986,6 +1399,7 @@ find_correct_buckets(status *policy, node_bucket **buckets, resource_resv *resre
 			log_err(errno, __func__, MEM_ERR_MSG);
 			free_chunk_map_array(cb_map);
 			set_schd_error_codes(err, NOT_RUN, SCHD_ERROR);
+			free_schd_error(failerr);
 			return NULL;
 		}
 		for (j = 0; buckets[j] != NULL && can_run; j++) {
@@ -1008,6 +1422,7 @@ find_correct_buckets(status *policy, node_bucket **buckets, resource_resv *resre
 					if(cb_map[i]->bkt_cnts[b] == NULL) {
 						free_chunk_map_array(cb_map);
 						set_schd_error_codes(err, NOT_RUN, SCHD_ERROR);
+						free_schd_error(failerr);
 						return NULL;
 					}
 					cb_map[i]->bkt_cnts[b]->bkt = buckets[j];
@@ -1034,13 +1449,224 @@ find_correct_buckets(status *policy, node_bucket **buckets, resource_resv *resre
 			move_schd_error(err, failerr);
 		err->status_code = NEVER_RUN;
 		free_chunk_map_array(cb_map);
+		free_schd_error(failerr);
 		return NULL;
 	}
 
-
+	free_schd_error(failerr);
 	return cb_map;
 }
 
+/**
+ * @brief	pthread routine for searching placement sets for a job with the
+ *		node bucket algorithm.  Placement sets sidx, sidx + stride, ... are
+ *		searched in order until the job fits in one, or until a lower
+ *		placement set is known to fit the job.
+ *
+ * @param[in,out]	data - th_data_map_buckets object for the search
+ *
+ * @return void
+ */
+void
+map_buckets_chunk(th_data_map_buckets *data)
+{
+	schd_error *err;
+	int fit_ind;
+
+	err = new_schd_error();
+	if (err == NULL) {
+		data->error = 1;
+		return;
+	}
+
+	for (int i = data->sidx; i < data->num_nodepart; i += data->stride) {
+		chunk_map **cmap;
+
+		pthread_mutex_lock(&general_lock);
+		fit_ind = *data->fit_ind;
+		pthread_mutex_unlock(&general_lock);
+		/* a lower placement set already fits, the rest can't be chosen */
+		if (fit_ind < i)
+			break;
+
+		log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_JOB, LOG_DEBUG, data->resresv->name,
+			"Evaluating placement set: %s", data->nodepart[i]->name);
+
+		clear_schd_error(err);
+		cmap = find_correct_buckets(data->policy, data->nodepart[i]->bkts, data->resresv, err);
+		if (cmap != NULL) {
+			clear_schd_error(err);
+			if (bucket_match(cmap, data->resresv, err)) {
+				data->match_ind = i;
+				data->cmap = cmap;
+				pthread_mutex_lock(&general_lock);
+				if (i < *data->fit_ind)
+					*data->fit_ind = i;
+				pthread_mutex_unlock(&general_lock);
+				break;
+			}
+			if (err->status_code == SCHD_UNKWN)
+				set_schd_error_codes(err, NOT_RUN, NO_NODE_RESOURCES);
+			free_chunk_map_array(cmap);
+		}
+		if (err->status_code == NOT_RUN && data->fail_ind == -1) {
+			data->fail_ind = i;
+			copy_schd_error(data->err, err);
+		}
+	}
+
+	free_schd_error(err);
+}
+
+/**
+ * @brief	allocate and initialize a th_data_map_buckets object
+ *
+ * @return	th_data_map_buckets *
+ * @retval	the object
+ * @retval	NULL	: malloc failure
+ */
+static th_data_map_buckets *
+alloc_tdata_map_buckets(status *policy, node_partition **nodepart, int num_nodepart,
+	resource_resv *resresv, int sidx, int stride, int *fit_ind)
+{
+	th_data_map_buckets *tdata;
+
+	tdata = static_cast<th_data_map_buckets *>(malloc(sizeof(th_data_map_buckets)));
+	if (tdata == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	tdata->err = new_schd_error();
+	if (tdata->err == NULL) {
+		free(tdata);
+		return NULL;
+	}
+
+	tdata->policy = policy;
+	tdata->nodepart = nodepart;
+	tdata->num_nodepart = num_nodepart;
+	tdata->resresv = resresv;
+	tdata->sidx = sidx;
+	tdata->stride = stride;
+	tdata->fit_ind = fit_ind;
+	tdata->match_ind = -1;
+	tdata->cmap = NULL;
+	tdata->fail_ind = -1;
+	tdata->error = 0;
+
+	return tdata;
+}
+
+/**
+ * @brief	search placement sets for a job in parallel with the worker threads.
+ *		The result is the same as searching them in order: the job is placed
+ *		in the lowest placement set it fits in.
+ *
+ * @param[in]	policy - policy info
+ * @param[in]	nodepart - placement sets to search
+ * @param[in]	num_np - number of placement sets
+ * @param[in]	resresv - the job
+ * @param[out]	nspecs - where the job can run or NULL if it can't
+ * @param[out]	failerr - why the job can't run in the first placement set
+ *			it can fit in later (set if 1 is returned)
+ *
+ * @return	int
+ * @retval	1	: job may fit in a placement set later
+ * @retval	0	: job does not fit in any placement set
+ * @retval	-1	: error, search the placement sets serially instead.
+ *			  A task which could not search its placement sets is
+ *			  an error too, since the lowest fit may be among them.
+ */
+static int
+map_buckets_psets_mt(status *policy, node_partition **nodepart, int num_np,
+	resource_resv *resresv, nspec ***nspecs, schd_error *failerr)
+{
+	th_data_map_buckets **tdata;
+	th_task_info *task;
+	int num_tasks;
+	int num_queued = 0;
+	int fit_ind = num_np;
+	int best = -1;
+	int fail = -1;
+	int rc = -1;
+	int i;
+
+	*nspecs = NULL;
+	num_tasks = (num_np < num_threads) ? num_np : num_threads;
+
+	tdata = static_cast<th_data_map_buckets **>(calloc(num_tasks, sizeof(th_data_map_buckets *)));
+	if (tdata == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return -1;
+	}
+	for (i = 0; i < num_tasks; i++) {
+		tdata[i] = alloc_tdata_map_buckets(policy, nodepart, num_np, resresv, i, num_tasks, &fit_ind);
+		if (tdata[i] == NULL) {
+			for (int j = 0; j < i; j++) {
+				free_schd_error(tdata[j]->err);
+				free(tdata[j]);
+			}
+			free(tdata);
+			return -1;
+		}
+	}
+
+	for (i = 0; i < num_tasks; i++) {
+		task = static_cast<th_task_info *>(malloc(sizeof(th_task_info)));
+		if (task == NULL) {
+			/* do the search ourselves */
+			log_err(errno, __func__, MEM_ERR_MSG);
+			map_buckets_chunk(tdata[i]);
+			continue;
+		}
+		task->task_id = i;
+		task->task_type = TS_MAP_BUCKETS;
+		task->thread_data = (void *) tdata[i];
+
+		queue_work_for_threads(task);
+		num_queued++;
+	}
+
+	/* Get results from worker threads */
+	for (i = 0; i < num_queued;) {
+		pthread_mutex_lock(&result_lock);
+		while (ds_queue_is_empty(result_queue))
+			pthread_cond_wait(&result_cond, &result_lock);
+		while (!ds_queue_is_empty(result_queue)) {
+			task = static_cast<th_task_info *>(ds_dequeue(result_queue));
+			free(task);
+			i++;
+		}
+		pthread_mutex_unlock(&result_lock);
+	}
+
+	for (i = 0; i < num_tasks; i++) {
+		if (tdata[i]->error)
+			break;
+		if (tdata[i]->match_ind != -1 && (best == -1 || tdata[i]->match_ind < tdata[best]->match_ind))
+			best = i;
+		if (tdata[i]->fail_ind != -1 && (fail == -1 || tdata[i]->fail_ind < tdata[fail]->fail_ind))
+			fail = i;
+	}
+
+	if (i == num_tasks) {
+		if (best != -1)
+			*nspecs = bucket_to_nspecs(policy, tdata[best]->cmap, resresv);
+		if (fail != -1 && failerr->status_code == SCHD_UNKWN)
+			copy_schd_error(failerr, tdata[fail]->err);
+		rc = fail != -1 ? 1 : 0;
+	}
+
+	for (i = 0; i < num_tasks; i++) {
+		free_chunk_map_array(tdata[i]->cmap);
+		free_schd_error(tdata[i]->err);
+		free(tdata[i]);
+	}
+	free(tdata);
+
+	return rc;
+}
+
 /**
  * @brief entry point into the node bucket algorithm.  If placement sets are
  * 	in use, choose the right pool and call map_buckets() on each.  If placement
@@ -1103,7 +1729,22 @@ check_node_buckets(status *policy, server_info *sinfo, queue_info *qinfo, resour
 		} else
 			clear_schd_error(failerr);
 
-		for (i = 0; nodepart[i] != NULL; i++) {
+		int num_np = count_array(nodepart);
+		int tid = *((int *) pthread_getspecific(th_id_key));
+		int rc = -1;
+
+		/* Search the placement sets in parallel if we can */
+		if (tid == 0 && num_threads > 1 && num_np > 1) {
+			nspec **nspecs = NULL;
+
+			rc = map_buckets_psets_mt(policy, nodepart, num_np, resresv, &nspecs, failerr);
+			if (nspecs != NULL)
+				return nspecs;
+			if (rc == 1)
+				can_run = 1;
+		}
+
+		for (i = 0; rc == -1 && nodepart[i] != NULL; i++) {
 			nspec **nspecs;
 			log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_JOB, LOG_DEBUG, resresv->name,
 				"Evaluating placement set: %s", nodepart[i]->name);
@@ -61,6 +61,12 @@ int find_node_bucket_ind(node_bucket **buckets, schd_resource *rl, queue_info *q
 /* create node_buckets an array of nodes */
 node_bucket **create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsigned int flags);
 
+/* create the server's node buckets from the ones kept across cycles */
+node_bucket **update_node_buckets(status *policy, node_info **nodes, queue_info **queues);
+
+/* forget the node buckets kept across cycles */
+void free_node_bucket_cache(void);
+
 /* Create a name for the node bucket based on resources, queue, and priority */
 char *create_node_bucket_name(status *policy, node_bucket *nb);
 
@@ -99,5 +105,6 @@ nspec **map_buckets(status *policy, node_bucket **bkts, resource_resv *resresv,
 
 /* map job to buckets that can satisfy */
 chunk_map **find_correct_buckets(status *policy, node_bucket **buckets, resource_resv *resresv, schd_error *err);
+void map_buckets_chunk(th_data_map_buckets *data);
 
 #endif	/* _BUCKETS_H */
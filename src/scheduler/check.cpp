@@ -1148,7 +1148,7 @@ match_resource(schd_resource *res, resource_req *resreq, unsigned int flags, enu
 			if (err != NULL) {
 				const char *requested;
 				set_schd_error_codes(err, NOT_RUN, fail_code);
-				err->rdef = res->def;
+				err->rdef = resreq->def;
 				requested = res_to_str_r(resreq, RF_REQUEST, resbuf1, sizeof(resbuf1));
 				snprintf(buf, sizeof(buf), "(%s != %s)",
 					 requested,
@@ -1157,7 +1157,7 @@ match_resource(schd_resource *res, resource_req *resreq, unsigned int flags, enu
 				/* Set arg2 for vnode/host resource. In case of preemption, arg2 is used to cull
 				 * the list of running jobs
 				 */
-				if (res->def == allres["host"] || (res->def == allres["vnode"]))
+				if (resreq->def == allres["host"] || (resreq->def == allres["vnode"]))
 					set_schd_error_arg(err, ARG2, requested);
 			}
 		}
@@ -1180,12 +1180,12 @@ match_resource(schd_resource *res, resource_req *resreq, unsigned int flags, enu
 				num_chunk = 0;
 				if (err != NULL) {
 					set_schd_error_codes(err, NOT_RUN, fail_code);
-					err->rdef = res->def;
+					err->rdef = resreq->def;
 
 					res_to_str_r(resreq, RF_REQUEST, resbuf1, sizeof(resbuf1));
-					res_to_str_c(avail, res->def, RF_AVAIL, resbuf2, sizeof(resbuf2));
+					res_to_str_c(avail, resreq->def, RF_AVAIL, resbuf2, sizeof(resbuf2));
 					if ((flags & UNSET_RES_ZERO) && res->avail == SCHD_INFINITY_RES)
-						res_to_str_c(0, res->def, RF_AVAIL, resbuf3, sizeof(resbuf3));
+						res_to_str_c(0, resreq->def, RF_AVAIL, resbuf3, sizeof(resbuf3));
 					else
 						res_to_str_r(res, RF_AVAIL, resbuf3, sizeof(resbuf3));
 					snprintf(buf, sizeof(buf), "(R: %s A: %s T: %s)", resbuf1, resbuf2, resbuf3);
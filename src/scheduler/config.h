@@ -58,12 +58,19 @@
 #define HOLIDAYS_FILE "holidays"
 #define RESGROUP_FILE "resource_group"
 #define DEDTIME_FILE "dedicated_time"
+#define CYCLE_STATS_FILE "cycle_stats.json"
+#define SNAPSHOT_FILE "snapshot"
 
 /* usage file "magic number" - needs to be 8 chars */
 #define USAGE_MAGIC "PBS_MAG!"
 #define USAGE_VERSION 2
 #define USAGE_NAME_MAX 50
 
+/* usage journal - appended to between full writes of the usage file */
+#define USAGE_JOURNAL_EXT ".journal"
+#define USAGE_JOURNAL_MAGIC "PBS_JNL!"
+#define USAGE_JOURNAL_VERSION 1
+
 #define UNKNOWN_GROUP_NAME "unknown"
 
 /* preempt priority values */
@@ -141,6 +148,10 @@
 #define PARSE_STRICT_ORDERING "strict_ordering"
 #define PARSE_RES_UNSET_INFINITE "resource_unset_infinite"
 #define PARSE_SELECT_PROVISION "provision_policy"
+#define PARSE_INCREMENTAL_QUERY "incremental_query"
+#define PARSE_RUN_JOB_WINDOW "run_job_window"
+#define PARSE_CYCLE_STATS "cycle_stats"
+#define PARSE_CAPTURE_SNAPSHOT "capture_snapshot"
 
 #ifdef NAS
 /* localmod 034 */
@@ -93,6 +93,9 @@ enum select_job_status
 
 #define INIT_ARR_SIZE 2048
 
+/* counts lists this long get a hash index (see find_counts()) */
+#define COUNTS_INDEX_MIN 16
+
 /* We need two sets of UNSPECIFIED/SCHD_INFINITY constants.  One for resources
  * which can be negative, and one for positive integer values.  While we could
  * use some numbers near -LONG_MAX, that would mean every integer used in the
@@ -176,7 +179,8 @@ enum thread_task_type
 	TS_FREE_ND_INFO,
 	TS_DUP_RESRESV,
 	TS_QUERY_JOB_INFO,
-	TS_FREE_RESRESV
+	TS_FREE_RESRESV,
+	TS_MAP_BUCKETS
 };
 
 /* return codes for is_ok_to_run_* functions
@@ -334,7 +338,7 @@ enum resv_conf {
 enum { FALSE, TRUE, TRUE_FALSE };
 
 enum { RUN_JOBS_SORTED = 1, SIM_RUN_JOB = 2 };
-enum { SIMULATE_SD = -1 };
+enum { SIMULATE_SD = -1, REPLAY_SD = -2 };
 
 enum fairshare_flags
 {
@@ -637,4 +641,48 @@ enum nscr_vals {
 	NSCR_CYCLE_INELIGIBLE = 8
 };
 
+/* node_table flags */
+enum node_table_flags {
+	NT_FREE = 1,
+	NT_RESV_ENABLE = 2,
+	NT_NO_MULTINODE = 4,
+	NT_USER_GROUP_LIMIT = 8	/* max_user_run or max_group_run is set */
+};
+
+/* phases of a scheduling cycle timed by the cycle profiler */
+enum prof_phase {
+	PROF_QUERY,
+	PROF_INIT,
+	PROF_SORT,
+	PROF_BUCKETS,
+	PROF_NODE_SEARCH,
+	PROF_RUN,
+	PROF_PREEMPT,
+	PROF_CALENDAR,
+	PROF_UPDATES,
+	PROF_END_CYCLE,
+	PROF_NUM_PHASES
+};
+
+/* server requests recorded in a universe snapshot */
+enum snapshot_req {
+	SNAP_SERVER,
+	SNAP_SCHED,
+	SNAP_QUEUE,
+	SNAP_NODE,
+	SNAP_JOB,
+	SNAP_RESV,
+	SNAP_RSC,
+	SNAP_NUM_REQS
+};
+
+/* events counted by the cycle profiler */
+enum prof_counter {
+	PROF_JOBS_CONSIDERED,
+	PROF_JOBS_RUN,
+	PROF_JOBS_PREEMPTED,
+	PROF_TOPJOBS,
+	PROF_NUM_COUNTERS
+};
+
 #endif	/* _CONSTANT_H */
@@ -52,12 +52,14 @@
 #ifndef	_DATA_TYPES_H
 #define	_DATA_TYPES_H
 
+#include <map>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include <time.h>
+#include <sys/types.h>
 #include <pbs_ifl.h>
 #include <libutil.h>
 #include "constant.h"
@@ -72,6 +74,7 @@
 struct server_info;
 struct job_info;
 struct schd_resource;
+struct res_index;
 struct resource_req;
 struct resource_count;
 struct holiday;
@@ -93,6 +96,8 @@ struct status;
 class fairshare_head;
 struct node_scratch;
 struct te_list;
+struct resource_timeline;
+struct node_table;
 struct node_bucket;
 struct bucket_bitpool;
 struct chunk_map;
@@ -109,6 +114,7 @@ typedef struct state_count state_count;
 typedef struct server_info server_info;
 typedef struct job_info job_info;
 typedef struct schd_resource schd_resource;
+typedef struct res_index res_index;
 typedef struct resource_req resource_req;
 typedef struct resource_count resource_count;
 typedef struct usage_info usage_info;
@@ -125,6 +131,8 @@ typedef struct event_list event_list;
 typedef struct node_scratch node_scratch;
 typedef struct resresv_set resresv_set;
 typedef struct te_list te_list;
+typedef struct resource_timeline resource_timeline;
+typedef struct node_table node_table;
 typedef struct node_bucket node_bucket;
 typedef struct bucket_bitpool bucket_bitpool;
 typedef struct chunk_map chunk_map;
@@ -138,6 +146,8 @@ typedef struct th_data_free_ninfo th_data_free_ninfo;
 typedef struct th_data_dup_resresv th_data_dup_resresv;
 typedef struct th_data_query_jinfo th_data_query_jinfo;
 typedef struct th_data_free_resresv th_data_free_resresv;
+typedef struct th_data_map_buckets th_data_map_buckets;
+typedef struct query_cache_ent query_cache_ent;
 
 
 #ifdef NAS
@@ -236,6 +246,8 @@ struct th_data_query_jinfo
 	int pbs_sd;
 	int sidx;
 	int eidx;
+	query_cache_ent *new_ents;	/* query cache entries created by this chunk */
+	int num_new_ents;
 };
 
 struct th_data_free_resresv
@@ -245,6 +257,30 @@ struct th_data_free_resresv
 	int eidx;
 };
 
+struct th_data_map_buckets
+{
+	status *policy;
+	node_partition **nodepart;
+	int num_nodepart;
+	resource_resv *resresv;
+	int sidx;			/* first placement set to search */
+	int stride;			/* search every stride'th placement set */
+	int *fit_ind;			/* lowest placement set the job fits in, shared by all tasks */
+	int match_ind;			/* placement set the job fits in (-1 if none) */
+	chunk_map **cmap;		/* nodes allocated in match_ind */
+	int fail_ind;			/* first placement set which can fit the job later (-1 if none) */
+	schd_error *err;		/* why the job could not run in fail_ind */
+	bool error:1;			/* the search could not be done */
+};
+
+/* an object queried in a previous cycle which can be reused if it has not changed */
+struct query_cache_ent
+{
+	bool seen:1;			/* object was seen in the current cycle */
+	unsigned long long digest;	/* digest of the object's batch_status */
+	resource_resv *resresv;		/* pristine copy of the object as it was queried */
+};
+
 struct schd_error
 {
 	enum sched_error_code error_code;	/* scheduler error code (see constant.h) */
@@ -403,6 +439,7 @@ struct server_info
 	bool has_nonCPU_licenses:1;	/* server has non-CPU (e.g. socket-based) licenses */
 	bool use_hard_duration:1;	/* use hard duration when creating the calendar */
 	bool pset_metadata_stale:1;	/* The placement set meta data is stale and needs to be regenerated before the next use */
+	bool fstree_shared:1;		/* fstree is borrowed from the universe this one was duplicated from */
 	char *name;			/* name of server */
 	struct schd_resource *res;	/* list of resources */
 	void *liminfo;			/* limit storage information */
@@ -470,6 +507,7 @@ struct server_info
 	resresv_set **equiv_classes;
 	node_bucket **buckets;		/* node bucket array */
 	node_info **unordered_nodes;
+	node_table *ntable;		/* columns of node fields indexed by node_ind */
 	std::unordered_map<std::string, node_partition *> svr_to_psets;
 #ifdef NAS
 	/* localmod 034 */
@@ -856,6 +894,17 @@ struct schd_resource
 	resdef *def;			/* resource definition */
 
 	struct schd_resource *next;	/* next resource in list */
+
+	res_index *index;		/* lookup index - only set on the head of a list */
+};
+
+/* direct lookup index of a schd_resource list by resdef::idx */
+struct res_index
+{
+	schd_resource **res;		/* resources in the list indexed by resdef::idx */
+	int size;			/* number of slots in res */
+	schd_resource *tail;		/* last resource indexed.  Resources appended
+					 * after it are found by walking the list */
 };
 
 struct resource_req
@@ -875,7 +924,8 @@ class resdef
 	const std::string name;	/* name of resource */
 	resource_type type;	/* resource type */
 	unsigned int flags;	/* resource flags (see pbs_ifl.h) */
-	resdef(char *rname, unsigned int rflags, resource_type rtype) : name(rname), type(rtype), flags(rflags) {}
+	int idx;		/* dense index of the definition (0 .. num_resdefs - 1) */
+	resdef(char *rname, unsigned int rflags, resource_type rtype, int ridx) : name(rname), type(rtype), flags(rflags), idx(ridx) {}
 };
 
 class prev_job_info
@@ -898,6 +948,8 @@ struct counts
 	int soft_limit_preempt_bit;	/* Place to store preempt bit if entity is over limits */
 	resource_count *rescts;		/* resources used */
 	counts *next;
+	/* on the head of a long list: the list's elements by name */
+	std::unordered_map<std::string, counts *> *index;
 };
 
 struct resource_count
@@ -917,6 +969,9 @@ class fairshare_head
 	public:
 	group_info *root;			/* root of fairshare tree */
 	time_t last_decay;			/* last time tree was decayed */
+	std::vector<group_info *> nodes;	/* every group in the tree, parents before children */
+	std::unordered_map<std::string, group_info *> index;	/* group name -> group */
+	int journal_records;			/* records appended to the usage journal since the last full write */
 	fairshare_head();
 	fairshare_head(fairshare_head&);
 	fairshare_head& operator=(fairshare_head&);
@@ -930,6 +985,7 @@ class group_info
 	int resgroup;				/* resgroup the group is in */
 	int cresgroup;				/* resgroup of the children of group */
 	int shares;				/* number of shares this group has */
+	int child_shares;			/* sum of the shares of the group's children */
 	float tree_percentage;			/* overall percentage the group has */
 	float group_percentage;			/* percentage within fairshare group (i.e., shares/group_shares) */
 
@@ -940,6 +996,7 @@ class group_info
 	 */
 	usage_t usage;				/* calculated usage info */
 	usage_t temp_usage;			/* usage plus any temporary usage */
+	usage_t saved_usage;			/* usage last written to the usage file or journal */
 	float usage_factor;			/* usage calculation taking parent's usage into account: number between 0 and 1 */
 
 	std::vector<group_info *> gpath;	/* path from the root of the tree */
@@ -960,6 +1017,7 @@ class group_info
 struct resresv_set
 {
 	bool can_not_run:1;		/* set can not run */
+	bool verdict_restored:1;	/* can_not_run was kept from the previous cycle */
 	schd_error *err;		/* reason why set can not run*/
 	char *user;			/* user of set, can be NULL */
 	char *group;			/* group of set, can be NULL */
@@ -1004,6 +1062,18 @@ struct group_node_header
 	usage_t version;	/* usage file version number */
 };
 
+/* header to the usage journal.  The journal is a run of group_node_usage_v2
+ * records appended after this header.  usage_ino is the inode of the usage
+ * file the journal was started on, so a journal left behind by an older
+ * usage file is never replayed on top of a newer one.
+ */
+struct usage_journal_header
+{
+	char tag[9];		/* journal "magic number" */
+	usage_t version;	/* journal version number */
+	ino_t usage_ino;	/* inode of the usage file the journal applies to */
+};
+
 /* This structure is used to write out the usage to disk
  * Version 1 was just successive group_node_usage structures written to disk
  * with not header or anything.
@@ -1076,7 +1146,8 @@ struct dyn_res
 	std::string res;
 	std::string command_line;
 	std::string script_name;
-	dyn_res(const char *resource, const char *cmdline, const char *fname): res(resource), command_line(cmdline), script_name(fname) {}
+	long cache_time;	/* seconds a value is reused before rerunning the script */
+	dyn_res(const char *resource, const char *cmdline, const char *fname, long ctime = 0): res(resource), command_line(cmdline), script_name(fname), cache_time(ctime) {}
 };
 
 struct peer_queue
@@ -1136,6 +1207,9 @@ struct config
 	bool node_sort_unused:1;	/* node sorting by unused/assigned is used */
 	bool resv_conf_ignore:1;	/* if we want to ignore dedicated time when confirming reservations.  Move to enum if ever expanded */
 	bool allow_aoe_calendar:1;	/* allow jobs requesting aoe in calendar*/
+	bool incremental_query:1;	/* reuse unchanged jobs queried in previous cycles */
+	bool cycle_stats:1;		/* collect and write per-cycle statistics */
+	bool capture_snapshot:1;	/* write the universe of each cycle to SNAPSHOT_FILE */
 #ifdef NAS /* localmod 034 */
 	bool prime_sto:1;	/* shares_track_only--no enforce shares */
 	bool non_prime_sto:1;
@@ -1158,6 +1232,7 @@ struct config
 	int unknown_shares;			/* unknown group shares */
 	int max_preempt_attempts;		/* max num of preempt attempts per cyc*/
 	int max_jobs_to_check;			/* max number of jobs to check in cyc*/
+	int run_job_window;			/* max run requests awaiting a reply */
 	std::string ded_prefix;			/* prefix to dedicated queues */
 	std::string pt_prefix;			/* prefix to primetime queues */
 	std::string npt_prefix;			/* prefix to non primetime queues */
@@ -1202,6 +1277,9 @@ struct event_list
 	timed_event *next_event;	/* the next event to be performed */
 	timed_event *first_run_event;	/* The first run event in the calendar */
 	time_t *current_time;		/* [reference] current time in the calendar */
+	/* first and last event of each event_time in the calendar.  Used to
+	 * find an event's place in the calendar without walking the list */
+	std::map<time_t, std::pair<timed_event *, timed_event *>> *time_index;
 };
 
 struct timed_event
@@ -1222,6 +1300,34 @@ struct te_list {
 	timed_event *event;
 };
 
+/* A step function of the free node resources a job requests, taken over
+ * the calendar.  The amounts are upper bounds, so a step which does not fit
+ * is a time at which the job can not be placed.
+ */
+struct resource_timeline
+{
+	std::vector<resdef *> defs;		/* consumable resources tracked */
+	std::vector<sch_resource_t> need_total;	/* amount of each def over all chunks */
+	std::vector<sch_resource_t> need_chunk;	/* largest amount of each def in one chunk */
+	std::vector<time_t> step_time;		/* time of each step */
+	std::vector<bool> step_fits;		/* can the request fit at each step */
+	std::size_t cur;			/* the step the calendar is at */
+};
+
+/* The node fields the node eligibility scan reads, kept in columns
+ * indexed by node_info::node_ind so the scan reads contiguous memory
+ * instead of one node_info per node.
+ */
+struct node_table
+{
+	std::vector<node_info *> node;		/* the node each row describes */
+	std::vector<unsigned char> flags;	/* NT_* flags */
+	std::vector<unsigned char> sharing;	/* enum vnode_sharing */
+	std::vector<int> num_jobs;
+	std::vector<int> num_run_resv;
+	std::vector<int> max_running;
+};
+
 struct bucket_bitpool {
 	pbs_bitmap *truth;		/* The actual bits.  This only changes if the bitmaps are changing */
 	int truth_ct;			/* number of 1 bits in truth bitmap*/
@@ -1256,4 +1362,15 @@ struct resresv_filter {
 	resource_resv *job;
 	schd_error *err;		/* reason why set can not run*/
 };
+
+/* Preemption candidates of one high priority job.  The checks cached here
+ * only depend on the jobs and on node totals, so they hold both in the real
+ * universe and in the duplicate find_jobs_to_preempt() simulates in.
+ */
+struct preempt_cand_cache {
+	bool have_fail_ranks = false;
+	std::unordered_set<int> fail_ranks;		/* ranks of jobs which failed to be preempted */
+	std::unordered_map<int, bool> job_ok;		/* job rank -> job passes the static checks */
+	std::unordered_map<int, bool> node_ok;		/* node rank -> node can hold a chunk of the job */
+};
 #endif	/* _DATA_TYPES_H */
@@ -45,6 +45,7 @@
  * 		fairshare.c - This file contains functions related to fareshare scheduling.
  *
  * Functions included are:
+ * 	lookup_group_info()
  * 	add_child()
  * 	add_unknown()
  * 	find_group_info()
@@ -53,22 +54,31 @@
  * 	parse_group()
  * 	preload_tree()
  * 	count_shares()
+ * 	set_fair_share_perc()
  * 	calc_fair_share_perc()
  * 	test_perc()
  * 	update_usage_on_run()
+ * 	update_usage_on_end()
  * 	decay_fairshare_tree()
  * 	compare_path()
  * 	print_fairshare()
  * 	write_usage()
- * 	rec_write_usage()
+ * 	sync_usage()
  * 	read_usage()
  * 	read_usage_v1()
  * 	read_usage_v2()
+ * 	read_usage_journal()
  * 	over_fs_usage()
  * 	dup_fairshare_tree()
+ * 	unshare_fairshare_tree()
  * 	free_fairshare_tree()
  * 	reset_temp_usage()
  *
+ * The tree is linked through parent/sibling/child pointers, but every
+ * group is also kept in fairshare_head::nodes with parents before their
+ * children, and in fairshare_head::index by name.  Lookups go through the
+ * index and whole-tree computations are single passes over the nodes.
+ *
  */
 #include <pbs_config.h>
 
@@ -76,6 +86,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <log.h>
 
@@ -98,18 +111,43 @@
 
 extern time_t last_decay;
 
+/* query_jobs() workers look up and add unknown entities concurrently */
+static pthread_mutex_t fstree_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief
+ *		lookup_group_info - look a group_info up in the tree's index.
+ *		The caller holds fstree_lock or is the only thread using the tree.
+ *
+ * @param[in]	name	-	name of the ginfo to find
+ * @param[in]	fhead	-	the fairshare tree
+ *
+ * @return	the found group_info or NULL
+ *
+ */
+static group_info *
+lookup_group_info(const std::string& name, fairshare_head *fhead)
+{
+	auto it = fhead->index.find(name);
+	if (it == fhead->index.end())
+		return NULL;
+
+	return it->second;
+}
+
 /**
  * @brief
  *		add_child - add a group_info to the resource group tree
  *
  * @param[out]	ginfo	-	ginfo to add to the tree
- * @param[in,out]	parent	-	parent ginfo
+ * @param[in,out]	parent	-	parent ginfo (NULL for the root)
+ * @param[in,out]	fhead	-	the tree
  *
  * @return	nothing
  *
  */
 void
-add_child(group_info *ginfo, group_info *parent)
+add_child(group_info *ginfo, group_info *parent, fairshare_head *fhead)
 {
 	if (parent != NULL) {
 		ginfo->sibling = parent->child;
@@ -117,6 +155,12 @@ add_child(group_info *ginfo, group_info *parent)
 		ginfo->parent = parent;
 		ginfo->resgroup = parent->cresgroup;
 		ginfo->gpath = create_group_path(ginfo);
+		parent->child_shares += ginfo->shares;
+	}
+
+	if (fhead != NULL) {
+		fhead->nodes.push_back(ginfo);
+		fhead->index[ginfo->name] = ginfo;
 	}
 }
 
@@ -125,42 +169,46 @@ add_child(group_info *ginfo, group_info *parent)
  * 		add a ginfo to the "unknown" group
  *
  * @param[in]	ginfo	-	ginfo to add
- * @param[in]	root	-	root of fairshare tree
+ * @param[in]	fhead	-	the fairshare tree
  *
  * @return	nothing
  *
  */
 void
-add_unknown(group_info *ginfo, group_info *root)
+add_unknown(group_info *ginfo, fairshare_head *fhead)
 {
 	group_info *unknown;		/* ptr to the "unknown" group */
 
-	unknown = find_group_info("unknown", root);
-	add_child(ginfo, unknown);
-	calc_fair_share_perc(unknown->child, UNSPECIFIED);
+	unknown = lookup_group_info(UNKNOWN_GROUP_NAME, fhead);
+	add_child(ginfo, unknown, fhead);
+
+	/* the new entity changes the share of everyone else in the group */
+	for (auto g = unknown->child; g != NULL; g = g->sibling)
+		set_fair_share_perc(g, unknown->child_shares);
 }
 
 /**
  * @brief
- *		find_group_info - recursive function to find a group_info in the
- *			  resgroup tree
+ *		find_group_info - find a group_info in the fairshare tree
  *
  * @param[in]	name	-	name of the ginfo to find
- * @param[in]	root	-	the root of the current sub-tree
+ * @param[in]	fhead	-	the fairshare tree
  *
  * @return	the found group_info or NULL
  *
  */
 group_info *
-find_group_info(const std::string& name, group_info *root)
+find_group_info(const std::string& name, fairshare_head *fhead)
 {
-	group_info *ginfo;		/* the found group */
-	if (root == NULL || name == root->name)
-		return root;
+	group_info *ginfo;
 
-	ginfo = find_group_info(name, root->sibling);
-	if (ginfo == NULL)
-		ginfo = find_group_info(name, root->child);
+	if (fhead == NULL)
+		return NULL;
+
+	/* job duplication in the query_jobs() workers races find_alloc_ginfo() */
+	pthread_mutex_lock(&fstree_lock);
+	ginfo = lookup_group_info(name, fhead);
+	pthread_mutex_unlock(&fstree_lock);
 
 	return ginfo;
 }
@@ -172,28 +220,29 @@ find_group_info(const std::string& name, group_info *root)
  *			  add it to the "unknown" group
  *
  * @param[in]	name	-	name of the ginfo to find
- * @param[in]	root	-	root of the fairshare tree
+ * @param[in]	fhead	-	the fairshare tree
  *
  * @return	the found ginfo or the newly allocated ginfo
  *
  */
 group_info *
-find_alloc_ginfo(const std::string& name, group_info *root)
+find_alloc_ginfo(const std::string& name, fairshare_head *fhead)
 {
 	group_info *ginfo;		/* the found group or allocated group */
 
-	if (root == NULL)
+	if (fhead == NULL || fhead->root == NULL)
 		return NULL;
 
-	ginfo = find_group_info(name, root);
+	pthread_mutex_lock(&fstree_lock);
+	ginfo = lookup_group_info(name, fhead);
 
 	if (ginfo == NULL) {
-		if ((ginfo = new group_info(name)) == NULL)
-			return NULL;
-
+		ginfo = new group_info(name);
 		ginfo->shares = 1;
-		add_unknown(ginfo, root);
+		add_unknown(ginfo, fhead);
 	}
+	pthread_mutex_unlock(&fstree_lock);
+
 	return ginfo;
 }
 
@@ -209,10 +258,12 @@ group_info::group_info(const std::string& gname) : name(gname)
 	resgroup = UNSPECIFIED;
 	cresgroup = UNSPECIFIED;
 	shares = UNSPECIFIED;
+	child_shares = 0;
 	tree_percentage = 0.0;
 	group_percentage = 0.0;
 	usage = FAIRSHARE_MIN_USAGE;
 	temp_usage = FAIRSHARE_MIN_USAGE;
+	saved_usage = FAIRSHARE_MIN_USAGE;
 	usage_factor = 0.0;
 	parent = NULL;
 	sibling = NULL;
@@ -223,7 +274,7 @@ group_info::group_info(const std::string& gname) : name(gname)
  * 		parse the resource group file
  *
  * @param[in]	fname	-	name of the file
- * @param[in]	root	-	root of fairshare tree
+ * @param[in]	fhead	-	the fairshare tree
  *
  * @return	success/failure
  *
@@ -236,7 +287,7 @@ group_info::group_info(const std::string& gname) : name(gname)
  *
  */
 int
-parse_group(const char *fname, group_info *root)
+parse_group(const char *fname, fairshare_head *fhead)
 {
 	group_info *ginfo;		/* ptr to parent group */
 	group_info *new_ginfo;	/* used to add each new group */
@@ -273,7 +324,7 @@ parse_group(const char *fname, group_info *root)
 				grouptok == NULL || sharestok == NULL) {
 				error = 1;
 			}
-			else if (find_group_info(nametok, root) != NULL) {
+			else if (find_group_info(nametok, fhead) != NULL) {
 				error = 1;
 				sprintf(log_buffer, "entity %s is not unique", nametok);
 				fprintf(stderr, "%s\n", log_buffer);
@@ -282,9 +333,9 @@ parse_group(const char *fname, group_info *root)
 			}
 			else {
 				if (!strcmp(grouptok, "root"))
-					ginfo = find_group_info(FAIRSHARE_ROOT_NAME, root);
+					ginfo = find_group_info(FAIRSHARE_ROOT_NAME, fhead);
 				else
-					ginfo = find_group_info(grouptok, root);
+					ginfo = find_group_info(grouptok, fhead);
 
 				if (ginfo != NULL) {
 					shares = strtol(sharestok, &endp, 10);
@@ -296,7 +347,7 @@ parse_group(const char *fname, group_info *root)
 							new_ginfo->resgroup = ginfo->cresgroup;
 							new_ginfo->cresgroup = cgroup;
 							new_ginfo->shares = shares;
-							add_child(new_ginfo, ginfo);
+							add_child(new_ginfo, ginfo, fhead);
 						}
 						else
 							error = 1;
@@ -355,6 +406,7 @@ preload_tree()
 	root->resgroup = -1;
 	root->cresgroup = 0;
 	root->tree_percentage = 1.0;
+	add_child(root, NULL, head);
 
 	if ((unknown = new group_info(UNKNOWN_GROUP_NAME)) == NULL) {
 		delete head;
@@ -365,7 +417,7 @@ preload_tree()
 	unknown->resgroup = 0;
 	unknown->cresgroup = 1;
 	unknown->parent = root;
-	add_child(unknown, root);
+	add_child(unknown, root, head);
 	return head;
 }
 
@@ -396,42 +448,53 @@ count_shares(group_info *grp)
 	return shares;
 }
 
+/**
+ * @brief
+ *		set_fair_share_perc - calculate the percentage of its group and of
+ *			      the machine a user/group gets.  The parent's
+ *			      percentage must already be calculated.
+ *
+ * @param[in,out]	ginfo	-	the user/group
+ * @param[in]	shares	-	the number of total shares in the group
+ *
+ * @return	nothing
+ *
+ */
+void
+set_fair_share_perc(group_info *ginfo, int shares)
+{
+	if (shares * ginfo->parent->tree_percentage == 0) {
+		ginfo->group_percentage = 0;
+		ginfo->tree_percentage = 0;
+	}
+	else {
+		ginfo->group_percentage = (float) ginfo->shares / shares;
+		ginfo->tree_percentage = ginfo->group_percentage * ginfo->parent->tree_percentage;
+	}
+}
+
 /**
  * @brief
  *		calc_fair_share_perc - walk the fair share group tree and calculate
  *			       the overall percentage of the machine a user/
  *			       group gets if all usage is equal
  *
- * @param[in,out]	root	-	the root of the current subtree
- * @param[in]	shares	-	the number of total shares in the group
+ * @param[in,out]	fhead	-	the fairshare tree
  *
  * @return	success/failure
  *
  */
 int
-calc_fair_share_perc(group_info *root, int shares)
+calc_fair_share_perc(fairshare_head *fhead)
 {
-	int cur_shares;		/* total number of shares in the resgrp */
-
-	if (root == NULL)
+	if (fhead == NULL || fhead->root == NULL)
 		return 0;
 
-	if (shares == UNSPECIFIED)
-		cur_shares = count_shares(root);
-	else
-		cur_shares = shares;
-
-	if (cur_shares * root->parent->tree_percentage == 0) {
-		root->group_percentage = 0;
-		root->tree_percentage = 0;
-	}
-	else {
-		root->group_percentage = (float) root->shares / cur_shares;
-		root->tree_percentage = root->group_percentage  * root->parent->tree_percentage;
-	}
+	/* parents come before their children, so their percentage is always known */
+	for (auto g : fhead->nodes)
+		if (g->parent != NULL)
+			set_fair_share_perc(g, g->parent->child_shares);
 
-	calc_fair_share_perc(root->sibling, cur_shares);
-	calc_fair_share_perc(root->child, UNSPECIFIED);
 	return 1;
 }
 
@@ -458,6 +521,12 @@ update_usage_on_run(resource_resv *resresv)
 	if (!resresv->is_job || resresv->job == NULL)
 		return;
 
+	/* a duplicated universe borrows its fairshare tree until it first changes it */
+	if (resresv->server != NULL && resresv->server->fstree_shared) {
+		if (unshare_fairshare_tree(resresv->server) == 0)
+			return;
+	}
+
 	u = formula_evaluate(conf.fairshare_res.c_str(), resresv, resresv->resreq);
 	if (resresv->job->ginfo !=NULL) {
 		for (auto& g : resresv->job->ginfo->gpath)
@@ -468,28 +537,58 @@ update_usage_on_run(resource_resv *resresv)
 			"Job doesn't have a group_info ptr set, usage not updated.");
 }
 
+/**
+ * @brief
+ *		update_usage_on_end - take back the usage update_usage_on_run()
+ *			      charged for a job which did not run after all
+ *
+ * @param[in]	resresv	-	the job
+ *
+ * @return	void
+ *
+ */
+void
+update_usage_on_end(resource_resv *resresv)
+{
+	usage_t u;
+
+	if (resresv == NULL)
+		return;
+
+	if (!resresv->is_job || resresv->job == NULL || resresv->job->ginfo == NULL)
+		return;
+
+	if (resresv->server != NULL && resresv->server->fstree_shared) {
+		if (unshare_fairshare_tree(resresv->server) == 0)
+			return;
+	}
+
+	u = formula_evaluate(conf.fairshare_res.c_str(), resresv, resresv->resreq);
+	for (auto& g : resresv->job->ginfo->gpath)
+		g->temp_usage -= u;
+}
+
 /**
  * @brief
  *		decay_fairshare_tree - decay the usage information kept in the fair
  *			       share tree
  *
- * @param[in,out]	root	-	the root of the fairshare tree
+ * @param[in,out]	fhead	-	the fairshare tree
  *
  * @return nothing
  *
  */
 void
-decay_fairshare_tree(group_info *root)
+decay_fairshare_tree(fairshare_head *fhead)
 {
-	if (root == NULL)
+	if (fhead == NULL)
 		return;
 
-	decay_fairshare_tree(root->sibling);
-	decay_fairshare_tree(root->child);
-
-	root->usage *= conf.fairshare_decay_factor;
-	if (root->usage < FAIRSHARE_MIN_USAGE)
-		root->usage = FAIRSHARE_MIN_USAGE;
+	for (auto g : fhead->nodes) {
+		g->usage *= conf.fairshare_decay_factor;
+		if (g->usage < FAIRSHARE_MIN_USAGE)
+			g->usage = FAIRSHARE_MIN_USAGE;
+	}
 }
 
 /**
@@ -542,10 +641,35 @@ compare_path(std::vector<group_info *>& gp1, std::vector<group_info *>& gp2)
 	return rc;
 }
 
+/**
+ * @brief
+ *		is_usage_entity - is a group written out to the usage file
+ *
+ * @param[in]	ginfo	-	the group
+ *
+ * @return	bool
+ */
+static bool
+is_usage_entity(group_info *ginfo)
+{
+	/* only write out leaves of the tree (fairshare entities)
+	 * It is possible that the unknown group is empty.  Don't want to write it out
+	 */
+#ifdef NAS /* localmod 043 */
+	return ginfo->child == NULL;
+#else
+	return ginfo->child == NULL && ginfo->name != UNKNOWN_GROUP_NAME;
+#endif /* localmod 043 */
+}
+
 /**
  * @brief
  *		write_usage - write the usage information to the usage file
- *		      This function uses a recursive helper function
+ *
+ *		The whole tree is written to a temporary file which replaces the
+ *		usage file once it is on disk, so a crash leaves either the old or
+ *		the new usage file.  The usage journal is folded into the new file
+ *		and removed.
  *
  * @param[in]	filename	-	usage file
  * @param[in]	fhead	-	Pointer to fairshare_head structure.
@@ -558,6 +682,7 @@ write_usage(const char *filename, fairshare_head *fhead)
 {
 	FILE *fp;		/* file pointer to usage file */
 	struct group_node_header head;
+	int error = 0;
 
 	if (fhead == NULL)
 		return 0;
@@ -565,8 +690,9 @@ write_usage(const char *filename, fairshare_head *fhead)
 	if (filename == NULL)
 		filename = USAGE_FILE;
 
-	if ((fp = fopen(filename, "wb")) == NULL) {
-		sprintf(log_buffer, "Error opening file %s", filename);
+	std::string tmpname = std::string(filename) + ".new";
+	if ((fp = fopen(tmpname.c_str(), "wb")) == NULL) {
+		sprintf(log_buffer, "Error opening file %s", tmpname.c_str());
 		log_err(errno, "write_usage", log_buffer);
 		return 0;
 	}
@@ -583,57 +709,160 @@ write_usage(const char *filename, fairshare_head *fhead)
 
 	pbs_strncpy(head.tag, USAGE_MAGIC, sizeof(head.tag));
 	head.version = USAGE_VERSION;
-	fwrite(&head, sizeof(struct group_node_header), 1, fp);
-	fwrite(&fhead->last_decay, sizeof(time_t), 1, fp);
+	if (fwrite(&head, sizeof(struct group_node_header), 1, fp) != 1 ||
+		fwrite(&fhead->last_decay, sizeof(time_t), 1, fp) != 1)
+		error = 1;
+
+	for (auto g : fhead->nodes) {
+		struct group_node_usage_v2 grp;	/* used to write out usage info */
+
+		/* usage defaults to 1 so don't bother writing those out */
+#ifdef NAS /* localmod 043 */
+		if (error || !is_usage_entity(g))
+#else
+		if (error || !is_usage_entity(g) || g->usage == 1)
+#endif /* localmod 043 */
+			continue;
+
+		memset(&grp, 0, sizeof(struct group_node_usage_v2));
+		snprintf(grp.name, sizeof(grp.name), "%s", g->name.c_str());
+		grp.usage = g->usage;
+
+		if (fwrite(&grp, sizeof(struct group_node_usage_v2), 1, fp) != 1)
+			error = 1;
+	}
+
+	if (error || fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+		error = 1;
+	if (fclose(fp) != 0)
+		error = 1;
+	if (!error && rename(tmpname.c_str(), filename) != 0)
+		error = 1;
+
+	if (error) {
+		sprintf(log_buffer, "Error writing file %s", filename);
+		log_err(errno, "write_usage", log_buffer);
+		unlink(tmpname.c_str());
+		return 0;
+	}
+
+	/* everything in the journal is now in the usage file */
+	unlink((std::string(filename) + USAGE_JOURNAL_EXT).c_str());
+	fhead->journal_records = 0;
+	for (auto g : fhead->nodes)
+		g->saved_usage = g->usage;
 
-	rec_write_usage(fhead->root, fp);
-	fclose(fp);
 	return 1;
 }
 
 /**
  * @brief
- *		rec_write_usage - recursive helper function which will write out all
- *			  the group_info structs of the resgroup tree
+ *		sync_usage - save the usage which changed since it was last written.
  *
- * @param[in]	root	-	the root of the current subtree
- * @param[in]	fp	-	the file to write the ginfo out to
+ *		Entities whose usage changed are appended to the usage journal.
+ *		Once the journal holds more records than there are groups in the
+ *		tree, no longer belongs to the usage file or ends in a torn record,
+ *		the whole tree is written out with write_usage() instead.
  *
- * @return nothing
+ * @param[in]	filename	-	usage file
+ * @param[in]	fhead	-	Pointer to fairshare_head structure.
+ *
+ * @return	success/failure
  *
  */
-void
-rec_write_usage(group_info *root, FILE *fp)
+int
+sync_usage(const char *filename, fairshare_head *fhead)
 {
-	struct group_node_usage_v2 grp;	/* used to write out usage info */
+	FILE *fp;
+	struct stat sb;
+	struct stat jsb;
+	struct usage_journal_header jhead;
+	int error = 0;
+	int records = 0;
 
-	if (root == NULL)
-		return;
+	if (fhead == NULL)
+		return 0;
+
+	if (filename == NULL)
+		filename = USAGE_FILE;
+
+	/* a journal only makes sense on top of an existing usage file */
+	if (stat(filename, &sb) != 0 || fhead->journal_records >= (int) fhead->nodes.size())
+		return write_usage(filename, fhead);
+
+	std::string jname = std::string(filename) + USAGE_JOURNAL_EXT;
+	if ((fp = fopen(jname.c_str(), "a+b")) == NULL) {
+		sprintf(log_buffer, "Error opening file %s", jname.c_str());
+		log_err(errno, __func__, log_buffer);
+		return write_usage(filename, fhead);
+	}
+
+	rewind(fp);
+	memset(&jhead, 0, sizeof(struct usage_journal_header));
+	if (fread(&jhead, sizeof(struct usage_journal_header), 1, fp) == 1) {
+		if (strcmp(jhead.tag, USAGE_JOURNAL_MAGIC) != 0 ||
+			jhead.version != USAGE_JOURNAL_VERSION || jhead.usage_ino != sb.st_ino) {
+			fclose(fp);
+			return write_usage(filename, fhead);
+		}
+		/* a record torn by a crash would misalign everything appended after it */
+		if (fstat(fileno(fp), &jsb) != 0 ||
+			(jsb.st_size - sizeof(struct usage_journal_header)) % sizeof(struct group_node_usage_v2) != 0) {
+			fclose(fp);
+			return write_usage(filename, fhead);
+		}
+		/* switching from reading to writing needs a seek */
+		fseek(fp, 0, SEEK_END);
+	} else {
+		fseek(fp, 0, SEEK_END);
+		memset(&jhead, 0, sizeof(struct usage_journal_header));
+		pbs_strncpy(jhead.tag, USAGE_JOURNAL_MAGIC, sizeof(jhead.tag));
+		jhead.version = USAGE_JOURNAL_VERSION;
+		jhead.usage_ino = sb.st_ino;
+		if (ftruncate(fileno(fp), 0) != 0 ||
+			fwrite(&jhead, sizeof(struct usage_journal_header), 1, fp) != 1)
+			error = 1;
+	}
+
+	for (auto g : fhead->nodes) {
+		struct group_node_usage_v2 grp;
+
+		if (error || !is_usage_entity(g) || g->usage == g->saved_usage)
+			continue;
 
-	/* only write out leaves of the tree (fairshare entities)
-	 * usage defaults to 1 so don't bother writing those out either
-	 * It is possible that the unknown group is empty.  Don't want to write it out
-	 */
-#ifdef NAS /* localmod 043 */
-	if (root->child == NULL) {
-#else
-	if (root->usage != 1 && root->child == NULL && root->name != UNKNOWN_GROUP_NAME) {
-#endif /* localmod 043 */
 		memset(&grp, 0, sizeof(struct group_node_usage_v2));
-		snprintf(grp.name, sizeof(grp.name), "%s", root->name.c_str());
-		grp.usage = root->usage;
+		snprintf(grp.name, sizeof(grp.name), "%s", g->name.c_str());
+		grp.usage = g->usage;
+
+		if (fwrite(&grp, sizeof(struct group_node_usage_v2), 1, fp) != 1)
+			error = 1;
+		records++;
+	}
+
+	if (error || fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+		error = 1;
+	if (fclose(fp) != 0)
+		error = 1;
 
-		fwrite(&grp, sizeof(struct group_node_usage_v2), 1, fp);
+	/* a partly written record is left behind; write_usage() removes the journal */
+	if (error) {
+		sprintf(log_buffer, "Error writing file %s", jname.c_str());
+		log_err(errno, __func__, log_buffer);
+		return write_usage(filename, fhead);
 	}
 
-	rec_write_usage(root->sibling, fp);
-	rec_write_usage(root->child, fp);
+	fhead->journal_records += records;
+	for (auto g : fhead->nodes)
+		g->saved_usage = g->usage;
+
+	return 1;
 }
 
 /**
  * @brief
  *		read_usage - read the usage information and load it into the
- *		     resgroup tree.
+ *		     resgroup tree.  The usage journal is replayed on top of
+ *		     the usage file.
  *
  * @param[in]	filename	-	The file which stores the usage information.
  * @param[in]	flags	-	flags to check whether to trim or not.
@@ -647,6 +876,8 @@ read_usage(const char *filename, int flags, fairshare_head *fhead)
 {
 	FILE *fp;				/* file pointer to usage file */
 	struct group_node_header head;		/* usage file header */
+	struct usage_journal_header jhead;	/* usage journal header */
+	struct stat sb;
 	time_t last;				/* read the last sync from the file */
 
 	if (fhead == NULL || fhead->root == NULL)
@@ -676,7 +907,7 @@ read_usage(const char *filename, int flags, fairshare_head *fhead)
 						error = 1;
 				}
 				if (!error)
-					read_usage_v2(fp, flags, fhead->root);
+					read_usage_v2(fp, flags, fhead);
 			} else
 				error = 1;
 
@@ -686,11 +917,35 @@ read_usage(const char *filename, int flags, fairshare_head *fhead)
 
 		} else { /* original headerless usage file */
 			rewind(fp);
-			read_usage_v1(fp, fhead->root);
+			read_usage_v1(fp, fhead);
+		}
+	}
+
+	fhead->journal_records = 0;
+	std::string jname = std::string(filename) + USAGE_JOURNAL_EXT;
+	if (fstat(fileno(fp), &sb) == 0) {
+		FILE *jfp;
+
+		if ((jfp = fopen(jname.c_str(), "rb")) != NULL) {
+			memset(&jhead, 0, sizeof(struct usage_journal_header));
+			if (fread(&jhead, sizeof(struct usage_journal_header), 1, jfp) == 1 &&
+				!strcmp(jhead.tag, USAGE_JOURNAL_MAGIC) &&
+				jhead.version == USAGE_JOURNAL_VERSION) {
+				/* a journal started on a since replaced usage file is already in it */
+				if (jhead.usage_ino == sb.st_ino)
+					fhead->journal_records = read_usage_journal(jfp, flags, fhead);
+				else
+					log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_FILE, LOG_DEBUG,
+						  "fairshare usage", "Ignoring stale usage journal");
+			}
+			fclose(jfp);
 		}
 	}
 
 	fclose(fp);
+
+	for (auto g : fhead->nodes)
+		g->saved_usage = g->usage;
 }
 
 /**
@@ -698,7 +953,7 @@ read_usage(const char *filename, int flags, fairshare_head *fhead)
  * 		read version 1 usage file
  *
  * @param[in]	fp	-	the file pointer to the open file
- * @param[in]	root	-	root of the fairshare tree
+ * @param[in]	fhead	-	the fairshare tree
  *
  * @return	int
  *	@retval	1	: success
@@ -706,7 +961,7 @@ read_usage(const char *filename, int flags, fairshare_head *fhead)
  *
  */
 int
-read_usage_v1(FILE *fp, group_info *root)
+read_usage_v1(FILE *fp, fairshare_head *fhead)
 {
 	struct group_node_usage_v1 grp;
 	group_info *ginfo;
@@ -716,7 +971,7 @@ read_usage_v1(FILE *fp, group_info *root)
 	memset(&grp, 0, sizeof(struct group_node_usage_v1));
 	while (fread(&grp, sizeof(struct group_node_usage_v1), 1, fp)) {
 		if (grp.usage >= 0 && is_valid_pbs_name(grp.name, USAGE_NAME_MAX)) {
-			ginfo = find_alloc_ginfo(grp.name, root);
+			ginfo = find_alloc_ginfo(grp.name, fhead);
 			if (ginfo != NULL) {
 				ginfo->usage = grp.usage;
 				ginfo->temp_usage = grp.usage;
@@ -745,14 +1000,14 @@ read_usage_v1(FILE *fp, group_info *root)
  *
  * @param[in]	fp	- the file pointer to the open file
  * @param[in]	flags	- flags to check whether to trim or not.
- * @param[in]	root	- root of the fairshare tree
+ * @param[in]	fhead	- the fairshare tree
  *
  *	@retval 1 success
  *	@retval 0 failure
  *
  */
 int
-read_usage_v2(FILE *fp, int flags, group_info *root)
+read_usage_v2(FILE *fp, int flags, fairshare_head *fhead)
 {
 	struct group_node_usage_v2 grp;
 	group_info *ginfo;
@@ -767,9 +1022,9 @@ read_usage_v2(FILE *fp, int flags, group_info *root)
 			 * already in the resource_group file
 			 */
 			if (flags & FS_TRIM)
-				ginfo = find_group_info(grp.name, root);
+				ginfo = find_group_info(grp.name, fhead);
 			else
-				ginfo = find_alloc_ginfo(grp.name, root);
+				ginfo = find_alloc_ginfo(grp.name, fhead);
 
 			if (ginfo != NULL) {
 				ginfo->usage = grp.usage;
@@ -793,6 +1048,56 @@ read_usage_v2(FILE *fp, int flags, group_info *root)
 	return 1;
 }
 
+/**
+ * @brief
+ * 		replay the usage journal.  Each record holds the current usage of
+ * 		an entity, so the difference to the usage already loaded is
+ * 		applied down the path from the root.
+ *
+ * @param[in]	fp	- the journal, positioned after its header
+ * @param[in]	flags	- flags to check whether to trim or not.
+ * @param[in]	fhead	- the fairshare tree
+ *
+ * @return	the number of records in the journal
+ *
+ */
+int
+read_usage_journal(FILE *fp, int flags, fairshare_head *fhead)
+{
+	struct group_node_usage_v2 grp;
+	group_info *ginfo;
+	int records = 0;
+
+	if (fp == NULL)
+		return 0;
+
+	memset(&grp, 0, sizeof(struct group_node_usage_v2));
+	/* fread() will not return a record torn by a crash during its write */
+	while (fread(&grp, sizeof(struct group_node_usage_v2), 1, fp)) {
+		records++;
+		if (grp.usage >= 0 && is_valid_pbs_name(grp.name, USAGE_NAME_MAX)) {
+			if (flags & FS_TRIM)
+				ginfo = find_group_info(grp.name, fhead);
+			else
+				ginfo = find_alloc_ginfo(grp.name, fhead);
+
+			if (ginfo != NULL && ginfo->child == NULL) {
+				usage_t delta = grp.usage - ginfo->usage;
+
+				for (auto& g : ginfo->gpath) {
+					g->usage += delta;
+					g->temp_usage += delta;
+				}
+			}
+		}
+		else
+			log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_FILE, LOG_WARNING,
+				  "fairshare usage", "Invalid entity");
+	}
+
+	return records;
+}
+
 /**
  * @brief
  *		create_group_path - create a path from the root to the leaf of the tree
@@ -841,11 +1146,13 @@ group_info::group_info(group_info& root) : name(root.name)
 	resgroup = root.resgroup;
 	cresgroup = root.cresgroup;
 	shares = root.shares;
+	child_shares = root.child_shares;
 	tree_percentage = root.tree_percentage;
 	group_percentage = root.group_percentage;
 	usage = root.usage;
 	usage_factor = root.usage_factor;
 	temp_usage = root.temp_usage;
+	saved_usage = root.saved_usage;
 	sibling = NULL;
 	child = NULL;
 	parent = NULL;
@@ -853,49 +1160,128 @@ group_info::group_info(group_info& root) : name(root.name)
 
 /**
  * @brief
- * 		copy constructor for the fairshare tree
+ * 		copy the groups of a fairshare tree into an empty tree
  *
- * @param[in]	root	-	root of the tree
- * @param[in] nparent	-	the parent of the root in the new dup'd tree
+ * @param[in]	ofhead	-	the tree to copy
+ * @param[out]	nfhead	-	the empty tree to copy into
+ * @param[out]	gmap	-	if not NULL, filled with old group_info -> new group_info
  *
- * @return	duplicated fairshare tree
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
  */
-group_info *
-dup_fairshare_tree(group_info *root, group_info *nparent)
+int
+dup_fairshare_tree(fairshare_head *ofhead, fairshare_head *nfhead,
+	std::unordered_map<group_info *, group_info *> *gmap)
 {
-	group_info *nroot;
-	if (root == NULL)
-		return NULL;
+	std::unordered_map<group_info *, group_info *> lmap;
 
-	nroot = new group_info(*root);
+	if (ofhead == NULL || nfhead == NULL)
+		return 0;
 
-	if (nroot == NULL)
-		return NULL;
+	if (gmap == NULL)
+		gmap = &lmap;
 
-	add_child(nroot, nparent);
+	gmap->reserve(ofhead->nodes.size());
+	nfhead->nodes.reserve(ofhead->nodes.size());
+	nfhead->index.reserve(ofhead->index.size());
+	for (auto og : ofhead->nodes) {
+		auto ng = new group_info(*og);
 
+		(*gmap)[og] = ng;
+		nfhead->nodes.push_back(ng);
+		nfhead->index[ng->name] = ng;
+	}
 
-	nroot->sibling = dup_fairshare_tree(root->sibling, nparent);
-	nroot->child = dup_fairshare_tree(root->child, nroot);
+	auto new_ginfo = [gmap](group_info *og) -> group_info * {
+		return og == NULL ? NULL : (*gmap)[og];
+	};
 
-	return nroot;
+	/* parents come first, so a group's path to the root is linked before its own */
+	for (auto og : ofhead->nodes) {
+		auto ng = (*gmap)[og];
+
+		ng->parent = new_ginfo(og->parent);
+		ng->sibling = new_ginfo(og->sibling);
+		ng->child = new_ginfo(og->child);
+		if (ng->parent != NULL)
+			ng->gpath = create_group_path(ng);
+	}
+	nfhead->root = new_ginfo(ofhead->root);
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		give a server its own copy of a fairshare tree it borrowed from the
+ *		server it was duplicated from.  The jobs' group_info pointers are
+ *		moved over to the new tree.
+ *
+ * @param[in,out]	sinfo	-	the server
+ *
+ * @return	int
+ * @retval	1	: success or the tree was not shared
+ * @retval	0	: failure
+ */
+int
+unshare_fairshare_tree(server_info *sinfo)
+{
+	fairshare_head *nfstree;
+	std::unordered_map<group_info *, group_info *> gmap;
+	int i;
+
+	if (sinfo == NULL)
+		return 0;
+
+	if (!sinfo->fstree_shared || sinfo->fstree == NULL) {
+		sinfo->fstree_shared = 0;
+		return 1;
+	}
+
+	nfstree = new fairshare_head();
+	nfstree->last_decay = sinfo->fstree->last_decay;
+	if (!dup_fairshare_tree(sinfo->fstree, nfstree, &gmap) || nfstree->root == NULL) {
+		delete nfstree;
+		log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG, __func__,
+			"Unable to duplicate the fairshare tree");
+		return 0;
+	}
+
+	if (sinfo->jobs != NULL) {
+		for (i = 0; sinfo->jobs[i] != NULL; i++) {
+			job_info *job = sinfo->jobs[i]->job;
+
+			if (job != NULL && job->ginfo != NULL) {
+				auto it = gmap.find(job->ginfo);
+				job->ginfo = (it != gmap.end()) ? it->second : NULL;
+			}
+		}
+	}
+
+	sinfo->fstree = nfstree;
+	sinfo->fstree_shared = 0;
+
+	return 1;
 }
 
 /**
  *	@brief
- *		free the entire fairshare tree
+ *		free every group of a fairshare tree
  *
- * @param[in]	root	-	root of the tree
+ * @param[in,out]	fhead	-	the tree
  */
 void
-free_fairshare_tree(group_info *root)
+free_fairshare_tree(fairshare_head *fhead)
 {
-	if (root == NULL)
+	if (fhead == NULL)
 		return;
 
-	free_fairshare_tree(root->sibling);
-	free_fairshare_tree(root->child);
-	delete root;
+	for (auto g : fhead->nodes)
+		delete g;
+	fhead->nodes.clear();
+	fhead->index.clear();
+	fhead->root = NULL;
 }
 
 /**
@@ -907,6 +1293,7 @@ fairshare_head::fairshare_head()
 {
 	root = NULL;
 	last_decay = 0;
+	journal_records = 0;
 }
 
 /**
@@ -920,8 +1307,10 @@ fairshare_head::fairshare_head()
  */
 fairshare_head::fairshare_head(fairshare_head& ofhead)
 {
+	root = NULL;
 	last_decay = ofhead.last_decay;
-	root = dup_fairshare_tree(ofhead.root, NULL);
+	journal_records = ofhead.journal_records;
+	dup_fairshare_tree(&ofhead, this);
 }
 
 /**
@@ -929,9 +1318,10 @@ fairshare_head::fairshare_head(fairshare_head& ofhead)
  */
 fairshare_head& fairshare_head::operator=(fairshare_head& ofhead)
 {
-	free_fairshare_tree(root);
+	free_fairshare_tree(this);
 	last_decay = ofhead.last_decay;
-	root = dup_fairshare_tree(ofhead.root, NULL);
+	journal_records = ofhead.journal_records;
+	dup_fairshare_tree(&ofhead, this);
 	return *this;
 }
 
@@ -943,49 +1333,25 @@ fairshare_head& fairshare_head::operator=(fairshare_head& ofhead)
  */
 fairshare_head::~fairshare_head()
 {
-	free_fairshare_tree(root);
+	free_fairshare_tree(this);
 }
 
 /**
  * @brief
- * 		recursively walk the fairshare tree resetting temp_usage = usage
+ * 		walk the fairshare tree resetting temp_usage = usage
  *
- * @param[in]	head	-	fairshare node to reset
+ * @param[in]	fhead	-	the fairshare tree
  *
  * @return	void
  */
 void
-reset_temp_usage(group_info *head)
+reset_temp_usage(fairshare_head *fhead)
 {
-	if (head == NULL)
-		return;
-
-	head->temp_usage = head->usage;
-	reset_temp_usage(head->sibling);
-	reset_temp_usage(head->child);
-}
-
-/**
- * @brief
- *		recursive helper function to calc_usage_factor()
- * @param root	- parent fairshare tree node
- * @param ginfo	- child fairshare tree node
- *
- * @return void
- */
-static void
-calc_usage_factor_rec(group_info *root, group_info *ginfo)
-{
-	float usage;
-
-	if (root == NULL || ginfo == NULL)
+	if (fhead == NULL)
 		return;
 
-	usage = ginfo->usage / root->usage;
-	ginfo->usage_factor = usage + ((ginfo->parent->usage_factor - usage) * ginfo->group_percentage);
-
-	calc_usage_factor_rec(root, ginfo->sibling);
-	calc_usage_factor_rec(root, ginfo->child);
+	for (auto g : fhead->nodes)
+		g->temp_usage = g->usage;
 }
 
 /**
@@ -1002,32 +1368,40 @@ calc_usage_factor_rec(group_info *root, group_info *ginfo)
 void
 calc_usage_factor(fairshare_head *tree)
 {
-	group_info *ginfo;
 	group_info *root;
 
-	if (tree == NULL)
+	if (tree == NULL || tree->root == NULL)
 		return;
 
 	root = tree->root;
-	/* Root's children use their real usage as their arbitrary usage */
-	for (ginfo = root->child; ginfo != NULL; ginfo = ginfo->sibling) {
-		ginfo->usage_factor = ginfo->usage / root->usage;
-		calc_usage_factor_rec(root, ginfo->child);
-	}
+	/* parents come before their children, so their usage_factor is always known */
+	for (auto ginfo : tree->nodes) {
+		float usage;
 
+		if (ginfo->parent == NULL)
+			continue;
+
+		usage = ginfo->usage / root->usage;
+		/* Root's children use their real usage as their arbitrary usage */
+		if (ginfo->parent == root)
+			ginfo->usage_factor = usage;
+		else
+			ginfo->usage_factor = usage + ((ginfo->parent->usage_factor - usage) * ginfo->group_percentage);
+	}
 }
 
 /**
  * @brief reset the usage of the fairshare tree so the usage can be reread.
  *	If the usage is not reset first, any entity that is no longer in the
  *	fairshare usage file will retain their original usage.
- * @param node - the fairshare node
+ * @param fhead - the fairshare tree
  */
-void reset_usage(group_info *node) {
-	if(node == NULL)
+void reset_usage(fairshare_head *fhead) {
+	if (fhead == NULL)
 		return;
-	reset_usage(node->sibling);
-	reset_usage(node->child);
-	node->usage = 1;
-	node->temp_usage = 1;
+	for (auto g : fhead->nodes) {
+		g->usage = 1;
+		g->temp_usage = 1;
+		g->saved_usage = 1;
+	}
 }
@@ -44,20 +44,19 @@
 /*
  *      add_child - add a ginfo to the resource group tree
  */
-void add_child(group_info *ginfo, group_info *parent);
+void add_child(group_info *ginfo, group_info *parent, fairshare_head *fhead);
 
 /*
- *      find_group_info - recursive function to find a ginfo in the
- resgroup tree
+ *      find_group_info - find a ginfo in the resgroup tree
  */
-group_info *find_group_info(const std::string& name, group_info *root);
+group_info *find_group_info(const std::string& name, fairshare_head *fhead);
 
 /*
  *      find_alloc_ginfo - trys to find a ginfo in the fair share tree.  If it
  *                        can not find the ginfo, then allocate a new one and
  *                        add it to the "unknown" group
  */
-group_info *find_alloc_ginfo(const std::string& name, group_info *root);
+group_info *find_alloc_ginfo(const std::string& name, fairshare_head *fhead);
 
 
 /*
@@ -65,7 +64,7 @@ group_info *find_alloc_ginfo(const std::string& name, group_info *root);
  *	parse_group - parse the resource group file
  *
  *	  fname - name of the file
- *	  root  - root of fairshare tree
+ *	  fhead - the fairshare tree
  *
  *	return success/failure
  *
@@ -78,7 +77,7 @@ group_info *find_alloc_ginfo(const std::string& name, group_info *root);
  *	  shares  - the amount of shares the user/group has in its resgroup
  *
  */
-int parse_group(const char *fname, group_info *root);
+int parse_group(const char *fname, fairshare_head *fhead);
 
 /*
  *
@@ -97,12 +96,18 @@ fairshare_head *preload_tree(void);
  */
 int count_shares(group_info *grp);
 
+/*
+ *      set_fair_share_perc - calculate the percentage of a user/group
+ *                            from the total shares of its group
+ */
+void set_fair_share_perc(group_info *ginfo, int shares);
+
 /*
  *      calc_fair_share_perc - walk the fair share group tree and calculate
  *                             the overall percentage of the machine a user/
  *                             group gets if all usage is equal
  */
-int calc_fair_share_perc(group_info *root, int shares);
+int calc_fair_share_perc(fairshare_head *fhead);
 
 /*
  *      update_usage_on_run - update a users usage information when a
@@ -110,23 +115,28 @@ int calc_fair_share_perc(group_info *root, int shares);
  */
 void update_usage_on_run(resource_resv *resresv);
 
+/*
+ *      update_usage_on_end - take back the usage charged for a job which
+ *                            did not run after all
+ */
+void update_usage_on_end(resource_resv *resresv);
+
 /*
  *      decay_fairshare_tree - decay the usage information kept in the fair
  *                             share tree
  */
-void decay_fairshare_tree(group_info *root);
+void decay_fairshare_tree(fairshare_head *fhead);
 
 /*
  *      write_usage - write the usage information to the usage file
- *                    This fuction uses a recursive helper function
  */
 int write_usage(const char *filename, fairshare_head *fhead);
 
 /*
- *      rec_write_usage - recursive helper function which will write out all
- *                        the group_info structs of the resgroup tree
+ *      sync_usage - append the usage which changed since it was last written
+ *                   to the usage journal
  */
-void rec_write_usage(group_info *root, FILE *fp);
+int sync_usage(const char *filename, fairshare_head *fhead);
 
 /*
  *      read_usage - read the usage information and load it into the
@@ -137,12 +147,17 @@ void read_usage(const char *filename, int flags, fairshare_head *fhead);
 /*
  *      read_usage_v1 - read version 1 usage file
  */
-int read_usage_v1(FILE *fp, group_info *root);
+int read_usage_v1(FILE *fp, fairshare_head *fhead);
 
 /*
  *      read_usage_v2 - read version 2 usage file
  */
-int read_usage_v2(FILE *fp, int flags, group_info *root);
+int read_usage_v2(FILE *fp, int flags, fairshare_head *fhead);
+
+/*
+ *      read_usage_journal - replay the usage journal
+ */
+int read_usage_journal(FILE *fp, int flags, fairshare_head *fhead);
 
 /*
  *      create_group_path - create a path from the root to the leaf of the tree
@@ -166,41 +181,49 @@ int over_fs_usage(group_info *ginfo);
 /*
  *	dup_fairshare_tree
  *
- *	  root - root of the tree
- *	  nparent - the parent of the root in the "new" duplicated tree
+ *	  ofhead - the tree to copy
+ *	  nfhead - the empty tree to copy into
+ *	  gmap - if not NULL, filled with a map of old -> new group_info
  *
- *	return duplicated fairshare tree
+ *	return 1 on success, 0 on failure
+ */
+int dup_fairshare_tree(fairshare_head *ofhead, fairshare_head *nfhead,
+	std::unordered_map<group_info *, group_info *> *gmap = NULL);
+
+/*
+ *	unshare_fairshare_tree - give a duplicated server its own copy of
+ *				 the fairshare tree it borrowed
  */
-group_info *dup_fairshare_tree(group_info *root, group_info *nparent);
+int unshare_fairshare_tree(server_info *sinfo);
 
 /*
- *	free_fairshare_tree - free the entire fairshare tree
+ *	free_fairshare_tree - free every group of a fairshare tree
  */
-void free_fairshare_tree(group_info *root);
+void free_fairshare_tree(fairshare_head *fhead);
 
 /*
  *
  *	add_unknown - add a ginfo to the "unknown" group
  *
  *	  ginfo - ginfo to add
- *	  root  - root of fairshare tre
+ *	  fhead - the fairshare tree
  *
  *	return nothing
  *
  */
-void add_unknown(group_info *ginfo, group_info *root);
+void add_unknown(group_info *ginfo, fairshare_head *fhead);
 
 /*
  * 	reset_temp_usage - walk the fairshare tree resetting temp_usage = usage
  *
- * 	  head - fairshare node to reset
+ * 	  fhead - fairshare tree to reset
  *
  * 	return nothing
  */
-void reset_temp_usage(group_info *head);
+void reset_temp_usage(fairshare_head *fhead);
 
 /* reset the tree to 1 usage */
-void reset_usage(group_info *node);
+void reset_usage(fairshare_head *fhead);
 
 /* Calculate the arbitrary usage of the tree */
 void calc_usage_factor(fairshare_head *tree);
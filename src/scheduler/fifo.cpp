@@ -93,6 +93,9 @@
 #include "limits_if.h"
 #include "pbs_version.h"
 #include "buckets.h"
+#include "arena.h"
+#include "profile.h"
+#include "snapshot.h"
 #include "multi_threading.h"
 #include "pbs_python.h"
 #include "libpbs.h"
@@ -142,13 +145,18 @@ schedinit(int nthreads)
 
 	parse_ded_file(DEDTIME_FILE);
 
+	/* cached jobs point into the old fairshare tree */
+	free_query_cache();
+	/* the resources nodes are bucketed on may have changed */
+	free_node_bucket_cache();
+
 	if (fstree != NULL)
 		delete fstree;
 	/* preload the static members to the fairshare tree */
 	fstree = preload_tree();
 	if (fstree != NULL) {
-		parse_group(RESGROUP_FILE, fstree->root);
-		calc_fair_share_perc(fstree->root->child, UNSPECIFIED);
+		parse_group(RESGROUP_FILE, fstree);
+		calc_fair_share_perc(fstree);
 		read_usage(USAGE_FILE, 0, fstree);
 
 		if (fstree->last_decay == 0)
@@ -325,7 +333,7 @@ init_scheduling_cycle(status *policy, int pbs_sd, server_info *sinfo)
 		bool resort = false;
 		if ((fp = fopen(USAGE_TOUCH, "r")) != NULL) {
 			fclose(fp);
-			reset_usage(fstree->root);
+			reset_usage(fstree);
 			read_usage(USAGE_FILE, NO_FLAGS, fstree);
 			if (fstree->last_decay == 0)
 				fstree->last_decay = policy->current_time;
@@ -338,7 +346,7 @@ init_scheduling_cycle(status *policy, int pbs_sd, server_info *sinfo)
 			 */
 
 			for (const auto& lj : last_running) {
-				user = find_alloc_ginfo(lj.entity_name.c_str(), sinfo->fstree->root);
+				user = find_alloc_ginfo(lj.entity_name.c_str(), sinfo->fstree);
 
 				if (user != NULL) {
 					auto rj = find_resource_resv(sinfo->running_jobs, lj.name);
@@ -371,7 +379,7 @@ init_scheduling_cycle(status *policy, int pbs_sd, server_info *sinfo)
 			log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG,
 				  "Fairshare", "Decaying Fairshare Tree");
 			if (fstree != NULL)
-				decay_fairshare_tree(sinfo->fstree->root);
+				decay_fairshare_tree(sinfo->fstree);
 			t -= conf.decay_time;
 			decayed = true;
 			resort = true;
@@ -385,12 +393,17 @@ init_scheduling_cycle(status *policy, int pbs_sd, server_info *sinfo)
 					sinfo->fstree->last_decay) % conf.decay_time;
 		}
 
-		if (decayed || !last_running.empty()) {
-			write_usage(USAGE_FILE, sinfo->fstree);
+		/* a replay must not change the usage file it was given */
+		if ((decayed || !last_running.empty()) && pbs_sd != REPLAY_SD) {
+			/* a decay changes every entity, so rewrite the whole file */
+			if (decayed)
+				write_usage(USAGE_FILE, sinfo->fstree);
+			else
+				sync_usage(USAGE_FILE, sinfo->fstree);
 			log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG,
 				  "Fairshare", "Usage Sync");
 		}
-		reset_temp_usage(sinfo->fstree->root);
+		reset_temp_usage(sinfo->fstree);
 		calc_usage_factor(sinfo->fstree);
 		if (resort)
 			sort_jobs(policy, sinfo);
@@ -587,6 +600,7 @@ scheduling_cycle(int sd, const sched_cmd *cmd)
 	int rc = SUCCESS;		/* return code from main_sched_loop() */
 	char log_msg[MAX_LOG_SIZE];	/* used to log the message why a job can't run*/
 	int error = 0;			/* error happened, don't run main loop */
+	int init_ok;			/* return code from init_scheduling_cycle() */
 	status *policy;			/* policy structure used for cycle */
 	schd_error *err = NULL;
 
@@ -599,14 +613,24 @@ scheduling_cycle(int sd, const sched_cmd *cmd)
 	else
 		send_job_attr_updates = 0;
 
-	update_cycle_status(cstat, 0);
+	/* a replayed cycle runs at the time its snapshot was taken */
+	update_cycle_status(cstat, snapshot_time());
+
+	snapshot_capture_start(cstat.current_time);
+	prof_cycle_start();
+
+	/* small per-cycle objects are released wholesale in end_cycle_tasks() */
+	arena_cycle_start();
 
 #ifdef NAS /* localmod 030 */
 	do_soft_cycle_interrupt = 0;
 	do_hard_cycle_interrupt = 0;
 #endif /* localmod 030 */
 	/* create the server / queue / job / node structures */
-	if ((sinfo = query_server(&cstat, sd)) == NULL) {
+	prof_phase_start(PROF_QUERY);
+	sinfo = query_server(&cstat, sd);
+	prof_phase_end(PROF_QUERY);
+	if (sinfo == NULL) {
 		log_event(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_NOTICE,
 			  "", "Problem with creating server data structure");
 		end_cycle_tasks(sinfo);
@@ -650,7 +674,10 @@ scheduling_cycle(int sd, const sched_cmd *cmd)
 	}
 
 
-	if (init_scheduling_cycle(policy, sd, sinfo) == 0) {
+	prof_phase_start(PROF_INIT);
+	init_ok = init_scheduling_cycle(policy, sd, sinfo);
+	prof_phase_end(PROF_INIT);
+	if (init_ok == 0) {
 		log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG, sinfo->name, "init_scheduling_cycle failed.");
 		end_cycle_tasks(sinfo);
 		return 0;
@@ -825,11 +852,18 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 	int sort_again = DONT_SORT_JOBS;
 	schd_error *err;
 	schd_error *chk_lim_err;
+	int universe_changed = 0;	/* a job has run or been preempted this cycle */
+	int verdicts_dropped = 0;	/* restored equiv class verdicts were dropped */
+	int num_preempted;
 
 
 	if (policy == NULL || sinfo == NULL || rerr == NULL)
 		return -1;
 
+	num_preempted = sinfo->num_preempted;
+	if (sinfo->qrun_job == NULL)
+		restore_equiv_class_verdicts(policy, sinfo);
+
 	time(&cycle_start_time);
 	/* calculate the time which we've been in the cycle too long */
 	cycle_end_time = cycle_start_time + sc_attrs.sched_cycle_length;
@@ -864,6 +898,12 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 		}
 #endif /* localmod 030 */
 
+		/* verdicts kept from the previous cycle are stale once anything ran */
+		if (universe_changed && !verdicts_dropped) {
+			drop_restored_equiv_class_verdicts(sinfo);
+			verdicts_dropped = 1;
+		}
+
 		rc = 0;
 		comment[0] = '\0';
 		log_msg[0] = '\0';
@@ -878,11 +918,14 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 		if(should_use_buckets)
 			flags = USE_BUCKETS;
 
+		prof_count(PROF_JOBS_CONSIDERED, 1);
+		prof_phase_start(PROF_NODE_SEARCH);
 		if (njob->is_shrink_to_fit) {
 			/* Pass the suitable heuristic for shrinking */
 			ns_arr = is_ok_to_run_STF(policy, sinfo, qinfo, njob, flags, err, shrink_job_algorithm);
 		} else
 			ns_arr = is_ok_to_run(policy, sinfo, qinfo, njob, flags, err);
+		prof_phase_end(PROF_NODE_SEARCH);
 
 		if (err->status_code == NEVER_RUN)
 			njob->can_never_run = 1;
@@ -899,7 +942,13 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				tj = njob;
 
 			if (rc != SCHD_ERROR) {
-				if(run_update_resresv(policy, sd, sinfo, qinfo, tj, ns_arr, RURR_ADD_END_EVENT, err) > 0 ) {
+				int run_rc;
+
+				prof_phase_start(PROF_RUN);
+				run_rc = run_update_resresv(policy, sd, sinfo, qinfo, tj, ns_arr, RURR_ADD_END_EVENT, err);
+				prof_phase_end(PROF_RUN);
+				if (run_rc > 0) {
+					prof_count(PROF_JOBS_RUN, 1);
 					rc = SUCCESS;
 					if (sinfo->has_soft_limit || qinfo->has_soft_limit)
 						sort_again = MUST_RESORT_JOBS;
@@ -916,7 +965,15 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				free_nspecs(ns_arr);
 		}
 		else if (policy->preempting && in_runnable_state(njob) && (!njob -> can_never_run)) {
-			if (find_and_preempt_jobs(policy, sd, njob, sinfo, err) > 0) {
+			int preempt_rc;
+
+			prof_phase_start(PROF_PREEMPT);
+			/* a job the server rejected must not be picked as a preemption victim */
+			finish_run_jobs();
+			preempt_rc = find_and_preempt_jobs(policy, sd, njob, sinfo, err);
+			prof_phase_end(PROF_PREEMPT);
+			if (preempt_rc > 0) {
+				prof_count(PROF_JOBS_RUN, 1);
 				rc = SUCCESS;
 				sort_again = MUST_RESORT_JOBS;
 			}
@@ -924,6 +981,9 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				sort_again = SORTED;
 		}
 
+		if (rc == SUCCESS)
+			universe_changed = 1;
+
 #ifdef NAS /* localmod 034 */
 		if (rc == SUCCESS && !site_is_queue_topjob_set_aside(njob)) {
 			site_bump_topjobs(njob);
@@ -947,9 +1007,12 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 #else
 			if (should_backfill_with_job(policy, sinfo, njob, num_topjobs) != 0) {
 #endif
+				prof_phase_start(PROF_CALENDAR);
 				auto cal_rc = add_job_to_calendar(sd, policy, sinfo, njob, should_use_buckets);
+				prof_phase_end(PROF_CALENDAR);
 
 				if (cal_rc > 0) { /* Success! */
+					prof_count(PROF_TOPJOBS, 1);
 #ifdef NAS /* localmod 034 */
 					switch(bf_rc)
 					{
@@ -1033,6 +1096,9 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				if (rc != RUN_FAILURE &&  !ec->can_not_run) {
 					ec->can_not_run = 1;
 					ec->err = dup_schd_error(err);
+					if (sinfo->num_preempted != num_preempted)
+						universe_changed = 1;
+					save_equiv_class_verdict(sinfo, ec, !universe_changed);
 				}
 			}
 		}
@@ -1098,9 +1164,17 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 #endif /* localmod 030 */
 
 		/* send any attribute updates to server that we've collected */
+		prof_phase_start(PROF_UPDATES);
 		send_job_updates(sd, njob);
+		prof_phase_end(PROF_UPDATES);
 	}
 
+	/* find out how the pipelined run requests went */
+	prof_phase_start(PROF_UPDATES);
+	finish_run_jobs();
+	prof_phase_end(PROF_UPDATES);
+	prof_count(PROF_JOBS_PREEMPTED, sinfo->num_preempted - num_preempted);
+
 	*rerr = err;
 
 	free_schd_error(chk_lim_err);
@@ -1119,6 +1193,12 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 void
 end_cycle_tasks(server_info *sinfo)
 {
+	prof_record_universe(sinfo);
+	prof_phase_start(PROF_END_CYCLE);
+
+	/* settle pipelined run requests while their jobs still exist */
+	finish_run_jobs();
+
 	/* keep track of update used resources for fairshare */
 	if (sinfo != NULL && sinfo->policy->fair_share)
 		create_prev_job_info(sinfo->running_jobs);
@@ -1130,6 +1210,7 @@ end_cycle_tasks(server_info *sinfo)
 		sinfo->fstree = NULL;
 		free_server(sinfo);	/* free server and queues and jobs */
 	}
+	arena_cycle_end();
 
 	/* close any open connections to peers */
 	for (auto& pq : conf.peer_queues) {
@@ -1147,6 +1228,10 @@ end_cycle_tasks(server_info *sinfo)
 		cmp_aoename = NULL;
 	}
 
+	prof_phase_end(PROF_END_CYCLE);
+	prof_cycle_end();
+	snapshot_capture_end();
+
 	log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_REQUEST, LOG_DEBUG,
 		"", "Leaving Scheduling Cycle");
 }
@@ -1206,6 +1291,97 @@ update_job_can_not_run(int pbs_sd, resource_resv *job, schd_error *err)
 	return ret;
 }
 
+/**
+ * @brief
+ * 		send a run request for a job.  If the server acks run requests
+ *		after its runjob hooks and run_job_window is set, the request
+ *		is pipelined: it is sent without waiting for the reply.
+ *
+ * @param[in]	pbs_sd	-	connection descriptor to pbs_server
+ * @param[in]	rjob	-	the job to run
+ * @param[in]	execvnode	-	the execvnode to run the job on
+ * @param[in]	has_runjob_hook	-	does server have a runjob hook?
+ *
+ * @return	int
+ * @retval	0	: success (or sent, if pipelined)
+ * @retval	!0	: failure
+ */
+static int
+dispatch_run_job(int pbs_sd, resource_resv *rjob, char *execvnode, int has_runjob_hook)
+{
+	/* replies to RJ_EXECJOB_HOOK requests can come back out of order, a
+	 * qrun needs the outcome before the cycle ends, and the nodes a
+	 * provisioning run brings down can not be brought back if it is rejected
+	 */
+	if (conf.run_job_window > 1 && sc_attrs.runjob_mode == RJ_RUNJOB_HOOK &&
+	    has_runjob_hook && rjob->server->qrun_job == NULL && rjob->aoename == NULL)
+		return send_run_job_pipelined(pbs_sd, rjob, execvnode);
+
+	return send_run_job(pbs_sd, has_runjob_hook, rjob->name, execvnode, rjob->svr_inst_id);
+}
+
+/**
+ * @brief
+ * 		the server rejected a pipelined run request.  Undo the run in
+ *		our view of the universe and tell the user why it did not run.
+ *
+ * @param[in]	pbs_sd	-	connection descriptor to pbs_server
+ * @param[in]	rjob	-	the job which did not run
+ * @param[in]	pbsrc	-	the server's error code
+ * @param[in]	errmsg	-	the server's error message
+ *
+ * @return	void
+ */
+void
+run_job_rejected(int pbs_sd, resource_resv *rjob, int pbsrc, const char *errmsg)
+{
+	schd_error *err;
+	char buf[MAX_LOG_SIZE];
+	char comment[MAX_LOG_SIZE] = {0};
+	char log_msg[MAX_LOG_SIZE] = {0};
+
+	if (rjob == NULL || rjob->job == NULL)
+		return;
+
+	if (rjob->job->is_running) {
+		server_info *sinfo = rjob->server;
+		resource_resv *array = rjob->job->parent_job;
+
+		/* take back everything run_update_resresv() did for the run */
+		if (sinfo->calendar != NULL)
+			delete_event(sinfo, find_timed_event(sinfo->calendar->events, rjob->name, TIMED_END_EVENT, 0));
+		update_universe_on_end(sinfo->policy, rjob, "Q", NO_FLAGS);
+		if (sinfo->policy->fair_share)
+			update_usage_on_end(rjob);
+		if (array != NULL && array->job != NULL) {
+			range_add_value(&array->job->queued_subjobs, rjob->job->array_index, 1);
+			update_accruetype(pbs_sd, sinfo, ACCRUE_MAKE_ELIGIBLE, SUCCESS, array);
+		}
+	}
+	/* don't try it again this cycle */
+	rjob->can_not_run = 1;
+
+	err = new_schd_error();
+	if (err == NULL)
+		return;
+
+	set_schd_error_codes(err, NOT_RUN, RUN_FAILURE);
+	set_schd_error_arg(err, ARG1, errmsg != NULL ? errmsg : "");
+	snprintf(buf, sizeof(buf), "%d", pbsrc);
+	set_schd_error_arg(err, ARG2, buf);
+#ifdef NAS /* localmod 031 */
+	set_schd_error_arg(err, ARG3, rjob->name);
+#endif /* localmod 031 */
+
+	translate_fail_code(err, comment, log_msg);
+	if (comment[0] != '\0')
+		update_job_comment(pbs_sd, rjob, comment);
+	if (log_msg[0] != '\0')
+		log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO, rjob->name, log_msg);
+
+	free_schd_error(err);
+}
+
 /**
  * @brief
  * 		run_job - handle the running of a pbs job.  If it's a peer job
@@ -1277,10 +1453,10 @@ run_job(int pbs_sd, resource_resv *rjob, char *execvnode, int has_runjob_hook, s
 				if (strlen(timebuf) > 0)
 					log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_NOTICE, rjob->name,
 						"Job will run for duration=%s", timebuf);
-				rc = send_run_job(pbs_sd, has_runjob_hook, rjob->name, execvnode, rjob->svr_inst_id);
+				rc = dispatch_run_job(pbs_sd, rjob, execvnode, has_runjob_hook);
 			}
 		} else
-			rc = send_run_job(pbs_sd, has_runjob_hook, rjob->name, execvnode, rjob->svr_inst_id);
+			rc = dispatch_run_job(pbs_sd, rjob, execvnode, has_runjob_hook);
 	}
 
 	if (rc) {
@@ -1576,7 +1752,8 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 
 		rr->nspec_arr = ns;
 
-		if (rr->is_job && !(flags & RURR_NOPRINT)) {
+		/* a pipelined run is logged once the server has accepted it */
+		if (rr->is_job && !(flags & RURR_NOPRINT) && !run_job_pending(rr)) {
 				log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB,
 					LOG_INFO, rr->name, "Job run");
 		}
@@ -2184,7 +2361,9 @@ next_job(status *policy, server_info *sinfo, int flag)
 		else if (policy->by_queue)
 			last_queue = 0;
 		skip = SKIP_NOTHING;
+		prof_phase_start(PROF_SORT);
 		sort_jobs(policy, sinfo);
+		prof_phase_end(PROF_SORT);
 		sort_status = SORTED;
 		last_job_index = 0;
 		return NULL;
@@ -2206,11 +2385,19 @@ next_job(status *policy, server_info *sinfo, int flag)
 			skip |= SKIP_RESERVATIONS;
 	}
 
-	if ((sort_status != SORTED) || ((flag == MAY_RESORT_JOBS) && policy->fair_share)
-		|| (flag == MUST_RESORT_JOBS)) {
+	if ((sort_status != SORTED) || (flag == MUST_RESORT_JOBS)) {
+		prof_phase_start(PROF_SORT);
 		sort_jobs(policy, sinfo);
+		prof_phase_end(PROF_SORT);
 		sort_status = SORTED;
 		last_job_index = 0;
+	} else if ((flag == MAY_RESORT_JOBS) && policy->fair_share) {
+		prof_phase_start(PROF_SORT);
+		/* only fairshare usage changed, move just the affected jobs */
+		if (!resort_jobs(policy, sinfo))
+			sort_jobs(policy, sinfo);
+		prof_phase_end(PROF_SORT);
+		last_job_index = 0;
 	}
 	if (policy->round_robin) {
 		/* Below is a pictorial representation of how queue_list
@@ -2561,7 +2748,8 @@ parse_sched_obj(int connector, struct batch_status *status)
 		attrp = attrp->next;
 	}
 
-	if (!dflt_sched) {
+	/* a replay keeps the directories it was started in */
+	if (!dflt_sched && connector != REPLAY_SD) {
 		int err;
 		int priv_dir_update_fail = 0;
 		int validate_log_dir = 0;
@@ -2759,7 +2947,7 @@ set_validate_sched_attrs(int connector)
 	struct batch_status *ss = NULL;
 	struct batch_status *all_ss = NULL;
 
-	if (connector < 0)
+	if (connector < 0 && connector != REPLAY_SD)
 		return 0;
 
 	/* Stat the scheduler to get details of sched */
@@ -248,6 +248,18 @@ int validate_running_user(char *exename);
 
 int send_run_job(int virtual_sd, int has_runjob_hook, const std::string& jobid, char *execvnode, char *svr_id_job);
 
+/* send a run request without waiting for the reply */
+int send_run_job_pipelined(int virtual_sd, resource_resv *rjob, char *execvnode);
+
+/* is the reply to a pipelined run request for a job still unread? */
+bool run_job_pending(const resource_resv *rjob);
+
+/* read the replies to all pipelined run requests and undo rejected runs */
+void finish_run_jobs(void);
+
+/* undo a job run which the server rejected */
+void run_job_rejected(int pbs_sd, resource_resv *rjob, int pbsrc, const char *errmsg);
+
 struct batch_status *send_statsched(int virtual_fd, struct attrl *attrib, char *extend);
 
 #endif	/* _FIFO_H */
@@ -0,0 +1,926 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file    formula.cpp
+ *
+ * @brief
+ * 		formula.cpp - native evaluation of job_sort_formula style formulas.
+ *
+ *	Formulas are python expressions.  The subset made up of numbers,
+ *	consumable resources, the fairshare/priority key words, + - * / // % **,
+ *	parentheses and a few functions (abs, min, max and the common math
+ *	functions) is compiled into a postfix program and evaluated natively.
+ *	Anything else, and any evaluation which would raise an exception in
+ *	python, is left to python so the answer (and error) stay the same.
+ *
+ * Functions included are:
+ * 	find_formula_prog()
+ * 	formula_prog_evaluate()
+ * 	clear_formula_cache()
+ */
+
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <log.h>
+#include <libutil.h>
+#include <pbs_share.h>
+#include "data_types.h"
+#include "constant.h"
+#include "globals.h"
+#include "resource_resv.h"
+#include "formula.h"
+
+enum formula_op {
+	FOP_CONST,	/* push val */
+	FOP_RES,	/* push the job's amount of def */
+	FOP_VAR,	/* push key word var */
+	FOP_ADD,
+	FOP_SUB,
+	FOP_MUL,
+	FOP_DIV,
+	FOP_FLOORDIV,
+	FOP_MOD,
+	FOP_POW,
+	FOP_NEG,
+	FOP_CALL	/* call func with nargs arguments */
+};
+
+/* formula key words */
+enum formula_var {
+	FVAR_ELIGIBLE_TIME,
+	FVAR_QUEUE_PRIO,
+	FVAR_JOB_PRIO,
+	FVAR_FSPERC,
+	FVAR_TREE_USAGE,
+	FVAR_FSFACTOR,
+	FVAR_ACCRUE_TYPE
+};
+
+enum formula_func {
+	FFUNC_ABS,
+	FFUNC_MIN,
+	FFUNC_MAX,
+	FFUNC_CEIL,
+	FFUNC_FLOOR,
+	FFUNC_SQRT,
+	FFUNC_EXP,
+	FFUNC_LOG,
+	FFUNC_LOG10,
+	FFUNC_FABS,
+	FFUNC_POW
+};
+
+struct formula_insn {
+	enum formula_op op;
+	double val;		/* FOP_CONST */
+	resdef *def;		/* FOP_RES */
+	int arg;		/* FOP_VAR: formula_var, FOP_CALL: formula_func */
+	int nargs;		/* FOP_CALL */
+};
+
+struct formula_prog {
+	std::vector<formula_insn> insns;
+	bool is_native;		/* false if the formula has to be evaluated by python */
+};
+
+/* compiled formulas by formula text */
+static std::unordered_map<std::string, formula_prog *> formula_cache;
+
+/*
+ * Names the scheduler's python __main__ dictionary defines (everything from
+ * 'from math import *' plus the formula evaluation variables).  They shadow
+ * resources of the same name when python evaluates a formula.
+ */
+static const char *python_local_names[] = {
+	"acos", "acosh", "asin", "asinh", "atan", "atan2", "atanh", "cbrt",
+	"ceil", "comb", "copysign", "cos", "cosh", "degrees", "dist", "e",
+	"erf", "erfc", "exp", "exp2", "expm1", "fabs", "factorial", "floor",
+	"fma", "fmod", "frexp", "fsum", "gamma", "gcd", "hypot", "inf",
+	"isclose", "isfinite", "isinf", "isnan", "isqrt", "lcm", "ldexp",
+	"lgamma", "log", "log10", "log1p", "log2", "modf", "nan", "nextafter",
+	"perm", "pi", "pow", "prod", "radians", "remainder", "sin", "sinh",
+	"sqrt", "sumprod", "tan", "tanh", "tau", "trunc", "ulp",
+	"ex", "globals_dict", "_err", "_FORMANS_", "_PBS_PYTHON_EXCEPTIONSTR_",
+	NULL
+};
+
+/* functions which can be evaluated natively */
+static const struct {
+	const char *name;
+	enum formula_func func;
+	int min_args;
+	int max_args;	/* -1 for any number */
+	bool builtin;	/* python builtin, shadowed by resources of the same name */
+} formula_funcs[] = {
+	{"abs", FFUNC_ABS, 1, 1, true},
+	{"min", FFUNC_MIN, 2, -1, true},
+	{"max", FFUNC_MAX, 2, -1, true},
+	{"ceil", FFUNC_CEIL, 1, 1, false},
+	{"floor", FFUNC_FLOOR, 1, 1, false},
+	{"sqrt", FFUNC_SQRT, 1, 1, false},
+	{"exp", FFUNC_EXP, 1, 1, false},
+	{"log", FFUNC_LOG, 1, 2, false},
+	{"log10", FFUNC_LOG10, 1, 1, false},
+	{"fabs", FFUNC_FABS, 1, 1, false},
+	{"pow", FFUNC_POW, 2, 2, false},
+	{NULL, FFUNC_ABS, 0, 0, false}
+};
+
+/* state of the formula parser */
+struct formula_parser {
+	const char *p;		/* current position in the formula */
+	formula_prog *prog;	/* program being built */
+	int depth;		/* current depth of the evaluation stack */
+	bool failed;		/* formula can't be compiled */
+};
+
+static void parse_formula_expr(formula_parser *fp);
+static void parse_formula_factor(formula_parser *fp);
+
+/**
+ * @brief
+ * 		is a name defined in python's __main__ dictionary?
+ *
+ * @param[in]	name	-	name to check
+ *
+ * @return	bool
+ */
+static bool
+is_python_local(const std::string& name)
+{
+	for (int i = 0; python_local_names[i] != NULL; i++)
+		if (name == python_local_names[i])
+			return true;
+
+	return false;
+}
+
+/**
+ * @brief
+ * 		is a name a consumable resource?
+ *
+ * @param[in]	name	-	name to check
+ *
+ * @return	resdef *
+ * @retval	the resource definition
+ * @retval	NULL if name is not a consumable resource
+ */
+static resdef *
+find_formula_resdef(const std::string& name)
+{
+	for (const auto& cr : consres)
+		if (cr->name == name)
+			return cr;
+
+	return NULL;
+}
+
+/**
+ * @brief
+ * 		skip white space in the formula
+ *
+ * @param[in,out]	fp	-	parser
+ *
+ * @return	void
+ */
+static void
+skip_formula_space(formula_parser *fp)
+{
+	while (*fp->p == ' ' || *fp->p == '\t')
+		fp->p++;
+}
+
+/**
+ * @brief
+ * 		add an instruction to the program being built
+ *
+ * @param[in,out]	fp	-	parser
+ * @param[in]	insn	-	instruction to add
+ * @param[in]	pushed	-	change to the stack depth done by the instruction
+ *
+ * @return	void
+ */
+static void
+emit_formula_insn(formula_parser *fp, const formula_insn& insn, int pushed)
+{
+	fp->prog->insns.push_back(insn);
+	fp->depth += pushed;
+	if (fp->depth > FORMULA_MAX_DEPTH)
+		fp->failed = true;
+}
+
+/**
+ * @brief
+ * 		emit a simple operator
+ *
+ * @param[in,out]	fp	-	parser
+ * @param[in]	op	-	operator
+ * @param[in]	pushed	-	change to the stack depth done by the operator
+ *
+ * @return	void
+ */
+static void
+emit_formula_op(formula_parser *fp, enum formula_op op, int pushed)
+{
+	formula_insn insn = {op, 0, NULL, 0, 0};
+
+	emit_formula_insn(fp, insn, pushed);
+}
+
+/**
+ * @brief
+ * 		parse a python numeric literal
+ *
+ * @param[in,out]	fp	-	parser
+ *
+ * @return	void
+ */
+static void
+parse_formula_number(formula_parser *fp)
+{
+	const char *start = fp->p;
+	const char *q = fp->p;
+	bool is_int = true;
+	formula_insn insn = {FOP_CONST, 0, NULL, 0, 0};
+
+	while (isdigit((unsigned char) *q))
+		q++;
+	if (*q == '.') {
+		is_int = false;
+		q++;
+		while (isdigit((unsigned char) *q))
+			q++;
+	}
+	if (q == start + 1 && *start == '.') {
+		fp->failed = true;
+		return;
+	}
+	if (*q == 'e' || *q == 'E') {
+		const char *e = q + 1;
+
+		if (*e == '+' || *e == '-')
+			e++;
+		if (!isdigit((unsigned char) *e)) {
+			fp->failed = true;
+			return;
+		}
+		while (isdigit((unsigned char) *e))
+			e++;
+		is_int = false;
+		q = e;
+	}
+	/* hex/octal/binary/complex literals, 1_000, 1.real etc are left to python */
+	if (isalnum((unsigned char) *q) || *q == '_' || *q == '.') {
+		fp->failed = true;
+		return;
+	}
+	/* python does not allow leading zeros on non-zero integers */
+	if (is_int && *start == '0') {
+		for (const char *z = start; z < q; z++) {
+			if (*z != '0') {
+				fp->failed = true;
+				return;
+			}
+		}
+	}
+
+	insn.val = strtod(std::string(start, q - start).c_str(), NULL);
+	fp->p = q;
+	emit_formula_insn(fp, insn, 1);
+}
+
+/**
+ * @brief
+ * 		parse a function call's arguments and emit the call
+ *
+ * @param[in,out]	fp	-	parser (positioned after the '(')
+ * @param[in]	fi	-	index into formula_funcs[]
+ *
+ * @return	void
+ */
+static void
+parse_formula_call(formula_parser *fp, int fi)
+{
+	formula_insn insn = {FOP_CALL, 0, NULL, formula_funcs[fi].func, 0};
+
+	skip_formula_space(fp);
+	if (*fp->p != ')') {
+		while (!fp->failed) {
+			parse_formula_expr(fp);
+			insn.nargs++;
+			skip_formula_space(fp);
+			if (*fp->p != ',')
+				break;
+			fp->p++;
+		}
+	}
+	if (fp->failed)
+		return;
+	if (*fp->p != ')' || insn.nargs < formula_funcs[fi].min_args ||
+	    (formula_funcs[fi].max_args != -1 && insn.nargs > formula_funcs[fi].max_args)) {
+		fp->failed = true;
+		return;
+	}
+	fp->p++;
+	emit_formula_insn(fp, insn, 1 - insn.nargs);
+}
+
+/**
+ * @brief
+ * 		parse a name: a key word, resource, constant or function call
+ *
+ * @param[in,out]	fp	-	parser
+ *
+ * @return	void
+ */
+static void
+parse_formula_name(formula_parser *fp)
+{
+	const char *start = fp->p;
+	formula_insn insn = {FOP_CONST, 0, NULL, 0, 0};
+	resdef *def;
+
+	while (isalnum((unsigned char) *fp->p) || *fp->p == '_')
+		fp->p++;
+	std::string name(start, fp->p - start);
+
+	skip_formula_space(fp);
+	if (*fp->p == '(') {
+		fp->p++;
+		/* a resource of the same name shadows a python builtin */
+		for (int i = 0; formula_funcs[i].name != NULL; i++) {
+			if (name == formula_funcs[i].name) {
+				if (formula_funcs[i].builtin && find_formula_resdef(name) != NULL)
+					break;
+				parse_formula_call(fp, i);
+				return;
+			}
+		}
+		fp->failed = true;
+		return;
+	}
+
+	/* python looks in __main__ first, then the formula's own variables */
+	if (is_python_local(name)) {
+		if (name == "pi")
+			insn.val = M_PI;
+		else if (name == "e")
+			insn.val = M_E;
+		else {
+			fp->failed = true;
+			return;
+		}
+		emit_formula_insn(fp, insn, 1);
+		return;
+	}
+
+	insn.op = FOP_VAR;
+	if (name == FORMULA_ELIGIBLE_TIME)
+		insn.arg = FVAR_ELIGIBLE_TIME;
+	else if (name == FORMULA_QUEUE_PRIO)
+		insn.arg = FVAR_QUEUE_PRIO;
+	else if (name == FORMULA_JOB_PRIO)
+		insn.arg = FVAR_JOB_PRIO;
+	else if (name == FORMULA_FSPERC || name == FORMULA_FSPERC_DEP)
+		insn.arg = FVAR_FSPERC;
+	else if (name == FORMULA_TREE_USAGE)
+		insn.arg = FVAR_TREE_USAGE;
+	else if (name == FORMULA_FSFACTOR)
+		insn.arg = FVAR_FSFACTOR;
+	else if (name == FORMULA_ACCRUE_TYPE)
+		insn.arg = FVAR_ACCRUE_TYPE;
+	else if ((def = find_formula_resdef(name)) != NULL) {
+		insn.op = FOP_RES;
+		insn.def = def;
+	} else {
+		/* python builtins, undefined names, key words like 'if' */
+		fp->failed = true;
+		return;
+	}
+	emit_formula_insn(fp, insn, 1);
+}
+
+/**
+ * @brief
+ * 		parse a primary: number, name, call or parenthesized expression
+ *
+ * @param[in,out]	fp	-	parser
+ *
+ * @return	void
+ */
+static void
+parse_formula_primary(formula_parser *fp)
+{
+	skip_formula_space(fp);
+	if (isdigit((unsigned char) *fp->p) || *fp->p == '.')
+		parse_formula_number(fp);
+	else if (isalpha((unsigned char) *fp->p) || *fp->p == '_')
+		parse_formula_name(fp);
+	else if (*fp->p == '(') {
+		fp->p++;
+		parse_formula_expr(fp);
+		skip_formula_space(fp);
+		if (*fp->p != ')')
+			fp->failed = true;
+		else
+			fp->p++;
+	} else
+		fp->failed = true;
+}
+
+/**
+ * @brief
+ * 		parse a power: primary ['**' factor] (right associative, and
+ *		binds tighter than a unary minus on its left like in python)
+ *
+ * @param[in,out]	fp	-	parser
+ *
+ * @return	void
+ */
+static void
+parse_formula_power(formula_parser *fp)
+{
+	parse_formula_primary(fp);
+	if (fp->failed)
+		return;
+
+	skip_formula_space(fp);
+	if (fp->p[0] == '*' && fp->p[1] == '*') {
+		fp->p += 2;
+		parse_formula_factor(fp);
+		emit_formula_op(fp, FOP_POW, -1);
+	}
+}
+
+/**
+ * @brief
+ * 		parse a factor: ('+'|'-') factor | power
+ *
+ * @param[in,out]	fp	-	parser
+ *
+ * @return	void
+ */
+static void
+parse_formula_factor(formula_parser *fp)
+{
+	skip_formula_space(fp);
+	if (*fp->p == '-') {
+		fp->p++;
+		parse_formula_factor(fp);
+		emit_formula_op(fp, FOP_NEG, 0);
+	} else if (*fp->p == '+') {
+		fp->p++;
+		parse_formula_factor(fp);
+	} else
+		parse_formula_power(fp);
+}
+
+/**
+ * @brief
+ * 		parse a term: factor (('*'|'/'|'//'|'%') factor)*
+ *
+ * @param[in,out]	fp	-	parser
+ *
+ * @return	void
+ */
+static void
+parse_formula_term(formula_parser *fp)
+{
+	parse_formula_factor(fp);
+	while (!fp->failed) {
+		enum formula_op op;
+
+		skip_formula_space(fp);
+		if (fp->p[0] == '*' && fp->p[1] != '*') {
+			op = FOP_MUL;
+			fp->p++;
+		} else if (fp->p[0] == '/' && fp->p[1] == '/') {
+			op = FOP_FLOORDIV;
+			fp->p += 2;
+		} else if (fp->p[0] == '/') {
+			op = FOP_DIV;
+			fp->p++;
+		} else if (fp->p[0] == '%') {
+			op = FOP_MOD;
+			fp->p++;
+		} else
+			break;
+
+		/* augmented assignment (e.g. *=) is not an expression */
+		if (*fp->p == '=') {
+			fp->failed = true;
+			break;
+		}
+		parse_formula_factor(fp);
+		emit_formula_op(fp, op, -1);
+	}
+}
+
+/**
+ * @brief
+ * 		parse an expression: term (('+'|'-') term)*
+ *
+ * @param[in,out]	fp	-	parser
+ *
+ * @return	void
+ */
+static void
+parse_formula_expr(formula_parser *fp)
+{
+	parse_formula_term(fp);
+	while (!fp->failed) {
+		enum formula_op op;
+
+		skip_formula_space(fp);
+		if (*fp->p == '+')
+			op = FOP_ADD;
+		else if (*fp->p == '-')
+			op = FOP_SUB;
+		else
+			break;
+		fp->p++;
+		if (*fp->p == '=') {
+			fp->failed = true;
+			break;
+		}
+		parse_formula_term(fp);
+		emit_formula_op(fp, op, -1);
+	}
+}
+
+/**
+ * @brief
+ * 		compile a formula into a native program
+ *
+ * @param[in]	formula	-	formula to compile
+ *
+ * @return	formula_prog *
+ * @retval	compiled formula (is_native is false if python has to evaluate it)
+ * @retval	NULL	: on error
+ */
+static formula_prog *
+compile_formula(const char *formula)
+{
+	formula_parser fp;
+	formula_prog *prog;
+
+	prog = new formula_prog();
+	prog->is_native = false;
+
+	fp.p = formula;
+	fp.prog = prog;
+	fp.depth = 0;
+	fp.failed = false;
+
+	parse_formula_expr(&fp);
+	skip_formula_space(&fp);
+	if (fp.failed || *fp.p != '\0' || prog->insns.empty()) {
+		prog->insns.clear();
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"Formula will be evaluated by python: %s", formula);
+	} else
+		prog->is_native = true;
+
+	return prog;
+}
+
+/**
+ * @brief
+ * 		find the native program for a formula, compiling it if this is the
+ *		first time the formula is seen
+ *
+ * @param[in]	formula	-	formula to find
+ *
+ * @return	const formula_prog *
+ * @retval	compiled formula
+ * @retval	NULL	: formula must be evaluated by python
+ */
+const formula_prog *
+find_formula_prog(const char *formula)
+{
+	formula_prog *prog;
+
+	if (formula == NULL)
+		return NULL;
+
+	auto f = formula_cache.find(formula);
+	if (f != formula_cache.end())
+		prog = f->second;
+	else {
+		prog = compile_formula(formula);
+		formula_cache[formula] = prog;
+	}
+
+	if (!prog->is_native)
+		return NULL;
+
+	return prog;
+}
+
+/**
+ * @brief
+ * 		forget all compiled formulas.  Compiled formulas hold resource
+ *		definitions, so this is needed whenever they change.
+ *
+ * @return	void
+ */
+void
+clear_formula_cache(void)
+{
+	for (auto& f : formula_cache)
+		delete f.second;
+	formula_cache.clear();
+}
+
+/**
+ * @brief
+ * 		round a value the way python sees it after it has been printed
+ *		into the formula's variables with a given number of decimals
+ *
+ * @param[in]	val	-	value
+ * @param[in]	digits	-	number of decimals
+ *
+ * @return	double
+ */
+static double
+formula_printed_value(double val, int digits)
+{
+	char buf[512];
+
+	if (val == trunc(val) && fabs(val) < 9007199254740992.0)
+		return val;
+
+	snprintf(buf, sizeof(buf), "%.*f", digits, val);
+	return strtod(buf, NULL);
+}
+
+/**
+ * @brief
+ * 		python's float modulo and floor division
+ *
+ * @param[in]	a	-	dividend
+ * @param[in]	b	-	divisor (non-zero)
+ * @param[out]	floordiv	-	a // b
+ *
+ * @return	double
+ * @retval	a % b
+ */
+static double
+formula_divmod(double a, double b, double *floordiv)
+{
+	double mod = fmod(a, b);
+	double div = (a - mod) / b;
+
+	if (mod != 0) {
+		if ((b < 0) != (mod < 0)) {
+			mod += b;
+			div -= 1.0;
+		}
+	} else
+		mod = copysign(0.0, b);
+
+	if (div != 0) {
+		*floordiv = floor(div);
+		if (div - *floordiv > 0.5)
+			*floordiv += 1.0;
+	} else
+		*floordiv = copysign(0.0, a / b);
+
+	return mod;
+}
+
+/**
+ * @brief
+ * 		evaluate a compiled formula for a job
+ *
+ * @param[in]	prog	-	compiled formula
+ * @param[in]	resresv	-	job for the key words
+ * @param[in]	resreq	-	resources to use when evaluating
+ * @param[out]	ans	-	evaluated formula
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: python would have raised an exception (or produced a
+ *			  value which isn't a finite float), let it evaluate the formula
+ */
+int
+formula_prog_evaluate(const formula_prog *prog, resource_resv *resresv, resource_req *resreq, sch_resource_t *ans)
+{
+	double stack[FORMULA_MAX_DEPTH];
+	int sp = 0;
+	job_info *job;
+
+	if (prog == NULL || resresv == NULL || resresv->job == NULL || ans == NULL)
+		return 0;
+
+	job = resresv->job;
+
+	for (const auto& insn : prog->insns) {
+		double a;
+		double b;
+		double r = 0;
+
+		switch (insn.op) {
+			case FOP_CONST:
+				r = insn.val;
+				break;
+
+			case FOP_RES: {
+				auto req = find_resource_req(resreq, insn.def);
+
+				if (req != NULL)
+					r = formula_printed_value(req->amount, float_digits(req->amount, FLOAT_NUM_DIGITS));
+				break;
+			}
+
+			case FOP_VAR:
+				switch (insn.arg) {
+					case FVAR_ELIGIBLE_TIME:
+						r = job->eligible_time;
+						break;
+					case FVAR_QUEUE_PRIO:
+						if (job->queue == NULL)
+							return 0;
+						r = job->queue->priority;
+						break;
+					case FVAR_JOB_PRIO:
+						r = job->priority;
+						break;
+					case FVAR_ACCRUE_TYPE:
+						r = job->accrue_type;
+						break;
+					default:
+						if (job->ginfo == NULL)
+							return 0;
+						if (insn.arg == FVAR_FSPERC)
+							r = job->ginfo->tree_percentage;
+						else if (insn.arg == FVAR_TREE_USAGE)
+							r = job->ginfo->usage_factor;
+						else if (job->ginfo->tree_percentage != 0)
+							r = pow(2, -(job->ginfo->usage_factor / job->ginfo->tree_percentage));
+						r = formula_printed_value(r, 6);
+						break;
+				}
+				break;
+
+			case FOP_NEG:
+				r = -stack[--sp];
+				break;
+
+			case FOP_CALL: {
+				double *args;
+
+				sp -= insn.nargs;
+				args = &stack[sp];
+				switch (insn.arg) {
+					case FFUNC_ABS:
+					case FFUNC_FABS:
+						r = fabs(args[0]);
+						break;
+					case FFUNC_MIN:
+					case FFUNC_MAX:
+						r = args[0];
+						for (int i = 1; i < insn.nargs; i++) {
+							if (insn.arg == FFUNC_MIN ? args[i] < r : args[i] > r)
+								r = args[i];
+						}
+						break;
+					case FFUNC_CEIL:
+						r = ceil(args[0]);
+						break;
+					case FFUNC_FLOOR:
+						r = floor(args[0]);
+						break;
+					case FFUNC_SQRT:
+						if (args[0] < 0)
+							return 0;
+						r = sqrt(args[0]);
+						break;
+					case FFUNC_EXP:
+						r = exp(args[0]);
+						break;
+					case FFUNC_LOG:
+					case FFUNC_LOG10:
+						if (args[0] <= 0)
+							return 0;
+						if (insn.arg == FFUNC_LOG10)
+							r = log10(args[0]);
+						else if (insn.nargs == 1)
+							r = log(args[0]);
+						else {
+							if (args[1] <= 0 || args[1] == 1)
+								return 0;
+							r = log(args[0]) / log(args[1]);
+						}
+						break;
+					case FFUNC_POW:
+						if ((args[0] == 0 && args[1] < 0) ||
+						    (args[0] < 0 && args[1] != trunc(args[1])))
+							return 0;
+						r = pow(args[0], args[1]);
+						break;
+				}
+				break;
+			}
+
+			default:
+				b = stack[--sp];
+				a = stack[--sp];
+				switch (insn.op) {
+					case FOP_ADD:
+						r = a + b;
+						break;
+					case FOP_SUB:
+						r = a - b;
+						break;
+					case FOP_MUL:
+						r = a * b;
+						break;
+					case FOP_DIV:
+						if (b == 0)
+							return 0;
+						r = a / b;
+						break;
+					case FOP_FLOORDIV:
+						if (b == 0)
+							return 0;
+						formula_divmod(a, b, &r);
+						break;
+					case FOP_MOD: {
+						double fdiv;
+
+						if (b == 0)
+							return 0;
+						r = formula_divmod(a, b, &fdiv);
+						break;
+					}
+					case FOP_POW:
+						/* python raises, or returns a complex number */
+						if ((a == 0 && b < 0) || (a < 0 && b != trunc(b)))
+							return 0;
+						r = pow(a, b);
+						break;
+					default:
+						return 0;
+				}
+				break;
+		}
+
+		if (!isfinite(r))
+			return 0;
+		stack[sp++] = r;
+	}
+
+	if (sp != 1)
+		return 0;
+
+	*ans = stack[0];
+	return 1;
+}
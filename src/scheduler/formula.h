@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+#ifndef SRC_SCHEDULER_FORMULA_H_
+#define SRC_SCHEDULER_FORMULA_H_
+
+#include "data_types.h"
+
+/*
+ * A job_sort_formula (or fairshare_usage_res) compiled into a small stack
+ * program over job resources and fairshare terms.  Formulas are compiled the
+ * first time they are evaluated and kept until the resource definitions
+ * change.  Formulas using anything the compiler does not understand are
+ * evaluated by the embedded python interpreter instead.
+ */
+
+#define FORMULA_MAX_DEPTH 64	/* deepest evaluation stack a compiled formula may use */
+
+struct formula_prog;
+
+/*
+ *	find_formula_prog - find (or compile) the native program for a formula
+ */
+const formula_prog *find_formula_prog(const char *formula);
+
+/*
+ *	formula_prog_evaluate - evaluate a compiled formula for a job
+ */
+int formula_prog_evaluate(const formula_prog *prog, resource_resv *resresv, resource_req *resreq, sch_resource_t *ans);
+
+/*
+ *	clear_formula_cache - forget all compiled formulas
+ */
+void clear_formula_cache(void);
+
+#endif /* SRC_SCHEDULER_FORMULA_H_ */
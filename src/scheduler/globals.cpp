@@ -166,11 +166,16 @@ pthread_once_t key_once = PTHREAD_ONCE_INIT;
 
 /* all resources */
 std::unordered_map<std::string, resdef *> allres;
+/* number of resource definitions in allres (resdef::idx is below this) */
+int num_resdefs = 0;
 /* consumable resources */
 std::unordered_set<resdef *> consres;
 /* boolean resources*/
 std::unordered_set<resdef *> boolres;
 
+/* queued jobs from previous cycles which can be reused (incremental_query) */
+std::unordered_map<std::string, query_cache_ent> job_query_cache;
+
 /* AOE name used to compare nodes, free when exit cycle */
 char *cmp_aoename = NULL;
 
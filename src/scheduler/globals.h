@@ -95,9 +95,12 @@ extern pthread_key_t th_id_key;
 extern pthread_once_t key_once;
 
 extern std::unordered_map<std::string, resdef *> allres;
+extern int num_resdefs;
 extern std::unordered_set<resdef *> consres;
 extern std::unordered_set<resdef *> boolres;
 
+extern std::unordered_map<std::string, query_cache_ent> job_query_cache;
+
 extern const char *sc_name;
 extern char *logfile;
 
@@ -45,6 +45,9 @@
  *
  * Functions included are:
  * 	query_jobs()
+ * 	job_attr_hash()
+ * 	build_job_attr_table()
+ * 	find_job_attr_id()
  * 	query_job()
  * 	new_job_info()
  * 	free_job_info()
@@ -81,6 +84,14 @@
  * 	is_finished_job()
  * 	preemption_similarity()
  * 	geteoename()
+ * 	hash_mix()
+ * 	hash_resource_list()
+ * 	universe_fingerprint()
+ * 	resresv_set_key()
+ * 	restore_equiv_class_verdicts()
+ * 	drop_restored_equiv_class_verdicts()
+ * 	save_equiv_class_verdict()
+ * 	clear_equiv_class_verdicts()
  *
  */
 
@@ -98,6 +109,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <math.h>
+#include <algorithm>
 #include <pbs_ifl.h>
 #include <log.h>
 #include <libutil.h>
@@ -124,6 +136,8 @@
 #include "server_info.h"
 #include "attribute.h"
 #include "multi_threading.h"
+#include "arena.h"
+#include "formula.h"
 #include "libpbs.h"
 
 #ifdef NAS
@@ -501,6 +515,128 @@ static struct fc_translation_table fctt[] = {
 #define	ERR2INFO(code)		(fctt[(code) - RET_BASE].fc_info)
 
 
+/**
+ * @brief	look up a job in the query cache and duplicate its template if
+ *		the job has not changed since it was cached
+ *
+ * @note	called from worker threads.  The cache is only read here, the
+ *		'seen' flag of the found entry belongs to this job alone.
+ *
+ * @param[in]	name - name of the job
+ * @param[in]	digest - digest of the job's current batch_status
+ * @param[in]	sinfo - server the job belongs to in this cycle
+ * @param[in]	qinfo - queue the job belongs to in this cycle
+ *
+ * @return	resource_resv *
+ * @retval	duplicate of the cached job
+ * @retval	NULL	: job not cached or has changed
+ */
+static resource_resv *
+query_cache_find(const char *name, unsigned long long digest, server_info *sinfo, queue_info *qinfo)
+{
+	resource_resv *resresv;
+
+	auto it = job_query_cache.find(name);
+	if (it == job_query_cache.end() || it->second.digest != digest)
+		return NULL;
+
+	resresv = dup_resource_resv(it->second.resresv, sinfo, qinfo);
+	if (resresv == NULL)
+		return NULL;
+
+	resresv->rank = get_sched_rank();
+	it->second.seen = true;
+	log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_JOB, LOG_DEBUG, name, "Reusing job from the query cache");
+
+	return resresv;
+}
+
+/**
+ * @brief	can a freshly queried job be reused in a later cycle?
+ *		Only plain queued jobs are cached.  Anything tied to nodes,
+ *		reservations or a peer server is rebuilt every cycle.
+ *
+ * @param[in]	resresv - the job
+ *
+ * @return	bool
+ */
+static bool
+is_query_cacheable(resource_resv *resresv)
+{
+	job_info *job = resresv->job;
+
+	if (resresv->is_peer_ob || resresv->nspec_arr != NULL || resresv->node_set != NULL)
+		return false;
+	if (!job->is_queued || job->is_subjob || job->resv != NULL || job->resreleased != NULL)
+		return false;
+
+	return true;
+}
+
+/**
+ * @brief	merge the query cache entries created by a chunk of jobs
+ *		into the query cache.  Must be called from the main thread.
+ *
+ * @param[in,out]	data - the chunk.  Its entries are consumed.
+ *
+ * @return void
+ */
+static void
+query_cache_add(th_data_query_jinfo *data)
+{
+	if (data->new_ents == NULL)
+		return;
+
+	for (int i = 0; i < data->num_new_ents; i++) {
+		query_cache_ent *ent = &data->new_ents[i];
+		auto &slot = job_query_cache[ent->resresv->name];
+
+		delete slot.resresv;
+		slot = *ent;
+	}
+	free(data->new_ents);
+	data->new_ents = NULL;
+	data->num_new_ents = 0;
+}
+
+/**
+ * @brief	remove jobs from the query cache which were not seen this cycle
+ *		and get the rest ready for the next cycle
+ *
+ * @return	int
+ * @retval	number of jobs which are cached
+ */
+int
+query_cache_sweep(void)
+{
+	for (auto it = job_query_cache.begin(); it != job_query_cache.end();) {
+		if (!it->second.seen) {
+			delete it->second.resresv;
+			it = job_query_cache.erase(it);
+		} else {
+			it->second.seen = false;
+			++it;
+		}
+	}
+
+	return job_query_cache.size();
+}
+
+/**
+ * @brief	empty the query cache.  Needs to be called when the cached jobs
+ *		can no longer be trusted (e.g., resource definitions or the
+ *		fairshare tree were reloaded).
+ *
+ * @return void
+ */
+void
+free_query_cache(void)
+{
+	for (auto &ent : job_query_cache)
+		delete ent.second.resresv;
+	job_query_cache.clear();
+}
+
 /**
  * @brief	pthread routine for querying a chunk of jobs
  *
@@ -553,10 +689,29 @@ query_jobs_chunk(th_data_query_jinfo *data)
 	for (cur_job = jobs, i = 0; i < sidx && cur_job != NULL; cur_job = cur_job->next, i++)
 		;
 
+	if (conf.incremental_query && !qinfo->is_peer_queue) {
+		data->new_ents = static_cast<query_cache_ent *>(malloc(sizeof(query_cache_ent) * num_jobs_chunk));
+		if (data->new_ents == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			data->error = 1;
+			free_schd_error(err);
+			free(resresv_arr);
+			return;
+		}
+	}
+
 	for (i = sidx, jidx = 0; i <= eidx && cur_job != NULL; cur_job = cur_job->next, i++) {
-		resource_resv *resresv;
+		resource_resv *resresv = NULL;
+		unsigned long long digest = 0;
+		bool cached = false;
+
+		if (data->new_ents != NULL) {
+			digest = batch_status_digest(cur_job, qinfo->name);
+			resresv = query_cache_find(cur_job->name, digest, sinfo, qinfo);
+			cached = resresv != NULL;
+		}
 
-		if ((resresv = query_job(pbs_sd, cur_job, sinfo, qinfo, err)) == NULL) {
+		if (resresv == NULL && (resresv = query_job(pbs_sd, cur_job, sinfo, qinfo, err)) == NULL) {
 			data->error = 1;
 			free_schd_error(err);
 			free_resource_resv_array(resresv_arr);
@@ -587,6 +742,22 @@ query_jobs_chunk(th_data_query_jinfo *data)
 			continue;
 		}
 
+		/* Keep a pristine copy of the job before this cycle starts to modify it */
+		if (data->new_ents != NULL && !cached && is_query_cacheable(resresv)) {
+			query_cache_ent *ent = &data->new_ents[data->num_new_ents];
+			/* the cache outlives the cycle's arena */
+			arena_suspend();
+			ent->resresv = dup_resource_resv(resresv, sinfo, qinfo);
+			arena_resume();
+			if (ent->resresv != NULL) {
+				/* the queue does not outlive this cycle */
+				ent->resresv->job->queue = NULL;
+				ent->digest = digest;
+				ent->seen = true;
+				data->num_new_ents++;
+			}
+		}
+
 		/* if the job's fairshare entity has no percentage of the machine,
 		 * the job can not run if enforce_no_shares is set
 		 */
@@ -658,6 +829,8 @@ alloc_tdata_jquery(status *policy, int pbs_sd, struct batch_status *jobs, queue_
 	tdata->policy = policy;
 	tdata->sidx = sidx;
 	tdata->eidx = eidx;
+	tdata->new_ents = NULL;
+	tdata->num_new_ents = 0;
 
 	return tdata;
 }
@@ -712,6 +885,7 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 	th_data_query_jinfo *tdata = NULL;
 	th_task_info *task = NULL;
 	resource_resv ***jinfo_arrs_tasks;
+	th_data_query_jinfo **tdata_tasks;
 	int tid;
 
 	if (policy == NULL || qinfo == NULL || queue_name.empty())
@@ -818,6 +992,7 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 			return NULL;
 		}
 		query_jobs_chunk(tdata);
+		query_cache_add(tdata);
 
 		if (tdata->error || tdata->oarr == NULL) {
 			free_resource_resv_array(resresv_arr);
@@ -865,8 +1040,14 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 			pthread_mutex_unlock(&work_lock);
 		}
 		jinfo_arrs_tasks = static_cast<resource_resv ***>(malloc(num_tasks * sizeof(resource_resv**)));
-		if (jinfo_arrs_tasks == NULL) {
+		/* the query cache is only merged once no worker can be reading it */
+		tdata_tasks = static_cast<th_data_query_jinfo **>(calloc(num_tasks, sizeof(th_data_query_jinfo *)));
+		if (jinfo_arrs_tasks == NULL || tdata_tasks == NULL) {
 			log_err(errno, __func__, MEM_ERR_MSG);
+			free(jinfo_arrs_tasks);
+			free(tdata_tasks);
+			jinfo_arrs_tasks = NULL;
+			tdata_tasks = NULL;
 			th_err = 1;
 		}
 		/* Get results from worker threads */
@@ -879,13 +1060,28 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 				tdata = static_cast<th_data_query_jinfo *>(task->thread_data);
 				if (tdata->error)
 					th_err = 1;
-				jinfo_arrs_tasks[task->task_id] = tdata->oarr;
-				free(tdata);
+				if (tdata_tasks != NULL) {
+					jinfo_arrs_tasks[task->task_id] = tdata->oarr;
+					tdata_tasks[task->task_id] = tdata;
+				} else {
+					for (int k = 0; k < tdata->num_new_ents; k++)
+						delete tdata->new_ents[k].resresv;
+					free(tdata->new_ents);
+					free(tdata->oarr);
+					free(tdata);
+				}
 				free(task);
 				i++;
 			}
 			pthread_mutex_unlock(&result_lock);
 		}
+		if (tdata_tasks != NULL) {
+			for (int i = 0; i < num_tasks; i++) {
+				query_cache_add(tdata_tasks[i]);
+				free(tdata_tasks[i]);
+			}
+			free(tdata_tasks);
+		}
 		if (th_err) {
 			pbs_statfree(jobs);
 			free_resource_resv_array(resresv_arr);
@@ -911,6 +1107,176 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 	return resresv_arr;
 }
 
+/* job attributes converted by query_job() */
+enum job_attr_id {
+	JATTR_UNKNOWN = 0,
+	JATTR_PRIORITY,
+	JATTR_QTIME,
+	JATTR_QRANK,
+	JATTR_SERVER_INST_ID,
+	JATTR_ETIME,
+	JATTR_STIME,
+	JATTR_JOB_NAME,
+	JATTR_STATE,
+	JATTR_SUBSTATE,
+	JATTR_SCHED_PREEMPTED,
+	JATTR_COMMENT,
+	JATTR_RELEASED,
+	JATTR_EUSER,
+	JATTR_EGROUP,
+	JATTR_PROJECT,
+	JATTR_RESV_ID,
+	JATTR_ALTID,
+	JATTR_SCHEDSELECT,
+	JATTR_ARRAY_ID,
+	JATTR_NODE_SET,
+	JATTR_ARRAY,
+	JATTR_ARRAY_INDEX,
+	JATTR_TOPJOB_INELIGIBLE,
+	JATTR_ARRAY_INDICES_REMAINING,
+	JATTR_MAX_RUN_SUBJOBS,
+	JATTR_EXECVNODE,
+	JATTR_RESOURCE_LIST,
+	JATTR_REL_LIST,
+	JATTR_USED,
+	JATTR_ACCRUE_TYPE,
+	JATTR_ELIGIBLE_TIME,
+	JATTR_ESTIMATED,
+	JATTR_CHECKPOINT,
+	JATTR_RERUNABLE,
+	JATTR_DEPEND
+};
+
+static const struct {
+	const char *name;
+	enum job_attr_id id;
+} job_attr_names[] = {
+	{ATTR_p, JATTR_PRIORITY},
+	{ATTR_qtime, JATTR_QTIME},
+	{ATTR_qrank, JATTR_QRANK},
+	{ATTR_server_inst_id, JATTR_SERVER_INST_ID},
+	{ATTR_etime, JATTR_ETIME},
+	{ATTR_stime, JATTR_STIME},
+	{ATTR_N, JATTR_JOB_NAME},
+	{ATTR_state, JATTR_STATE},
+	{ATTR_substate, JATTR_SUBSTATE},
+	{ATTR_sched_preempted, JATTR_SCHED_PREEMPTED},
+	{ATTR_comment, JATTR_COMMENT},
+	{ATTR_released, JATTR_RELEASED},
+	{ATTR_euser, JATTR_EUSER},
+	{ATTR_egroup, JATTR_EGROUP},
+	{ATTR_project, JATTR_PROJECT},
+	{ATTR_resv_ID, JATTR_RESV_ID},
+	{ATTR_altid, JATTR_ALTID},
+	{ATTR_SchedSelect, JATTR_SCHEDSELECT},
+	{ATTR_array_id, JATTR_ARRAY_ID},
+	{ATTR_node_set, JATTR_NODE_SET},
+	{ATTR_array, JATTR_ARRAY},
+	{ATTR_array_index, JATTR_ARRAY_INDEX},
+	{ATTR_topjob_ineligible, JATTR_TOPJOB_INELIGIBLE},
+	{ATTR_array_indices_remaining, JATTR_ARRAY_INDICES_REMAINING},
+	{ATTR_max_run_subjobs, JATTR_MAX_RUN_SUBJOBS},
+	{ATTR_execvnode, JATTR_EXECVNODE},
+	{ATTR_l, JATTR_RESOURCE_LIST},
+	{ATTR_rel_list, JATTR_REL_LIST},
+	{ATTR_used, JATTR_USED},
+	{ATTR_accrue_type, JATTR_ACCRUE_TYPE},
+	{ATTR_eligible_time, JATTR_ELIGIBLE_TIME},
+	{ATTR_estimated, JATTR_ESTIMATED},
+	{ATTR_c, JATTR_CHECKPOINT},
+	{ATTR_r, JATTR_RERUNABLE},
+	{ATTR_depend, JATTR_DEPEND},
+};
+
+/* collision free hash table of job_attr_names[] */
+struct job_attr_table {
+	unsigned int seed;
+	unsigned int mask;
+	std::vector<int> slots;		/* index into job_attr_names[] or -1 */
+};
+
+/**
+ * @brief
+ *		hash an attribute name (FNV-1a)
+ *
+ * @param[in]	name	-	attribute name
+ * @param[in]	seed	-	seed of the hash
+ *
+ * @return	hash value
+ */
+static unsigned int
+job_attr_hash(const char *name, unsigned int seed)
+{
+	unsigned int h = 2166136261u ^ seed;
+
+	for (; *name != '\0'; name++) {
+		h ^= static_cast<unsigned char>(*name);
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/**
+ * @brief
+ *		build a perfect hash table of job_attr_names[]: look for a seed
+ *		and table size where no two names share a slot
+ *
+ * @return	the table
+ */
+static job_attr_table
+build_job_attr_table()
+{
+	job_attr_table t;
+	const int num_names = sizeof(job_attr_names) / sizeof(job_attr_names[0]);
+	unsigned int size;
+
+	for (size = 64; ; size *= 2) {
+		for (t.seed = 0; t.seed < 256; t.seed++) {
+			bool collision = false;
+			int i;
+
+			t.mask = size - 1;
+			t.slots.assign(size, -1);
+			for (i = 0; i < num_names && !collision; i++) {
+				auto slot = job_attr_hash(job_attr_names[i].name, t.seed) & t.mask;
+				if (t.slots[slot] != -1)
+					collision = true;
+				else
+					t.slots[slot] = i;
+			}
+			if (!collision)
+				return t;
+		}
+	}
+}
+
+/**
+ * @brief
+ *		find what query_job() does with an attribute
+ *
+ * @param[in]	name	-	attribute name
+ *
+ * @return	enum job_attr_id
+ * @retval	JATTR_UNKNOWN	: attribute is not used by the scheduler
+ */
+static enum job_attr_id
+find_job_attr_id(const char *name)
+{
+	/* built once, and safely so, by the first thread to query a job */
+	static const job_attr_table table = build_job_attr_table();
+	int i;
+
+	if (name == NULL)
+		return JATTR_UNKNOWN;
+
+	i = table.slots[job_attr_hash(name, table.seed) & table.mask];
+	if (i == -1 || strcmp(job_attr_names[i].name, name) != 0)
+		return JATTR_UNKNOWN;
+
+	return job_attr_names[i].id;
+}
+
 /**
  * @brief
  *		query_job - takes info from a batch_status about a job and
@@ -973,13 +1339,14 @@ query_job(int pbs_sd, struct batch_status *job, server_info *sinfo, queue_info *
 					resresv->job->sh_info = site_find_alloc_share(sinfo, attrp->value);
 				}
 #else
-				resresv->job->ginfo = find_alloc_ginfo(attrp->value, sinfo->fstree->root);
+				resresv->job->ginfo = find_alloc_ginfo(attrp->value, sinfo->fstree);
 #endif /* localmod 059 */
 			}
 			else
 				resresv->job->ginfo = NULL;
 		}
-		if (!strcmp(attrp->name, ATTR_p)) { /* priority */
+		switch (find_job_attr_id(attrp->name)) {
+		case JATTR_PRIORITY: /* priority */
 			count = strtol(attrp->value, &endp, 10);
 			if (*endp == '\0')
 				resresv->job->priority = count;
@@ -988,100 +1355,107 @@ query_job(int pbs_sd, struct batch_status *job, server_info *sinfo, queue_info *
 #ifdef NAS /* localmod 045 */
 			resresv->job->NAS_pri = resresv->job->priority;
 #endif /* localmod 045 */
-		}
-		else if (!strcmp(attrp->name, ATTR_qtime)) { /* queue time */
+			break;
+		case JATTR_QTIME: /* queue time */
 			count = strtol(attrp->value, &endp, 10);
 			if (*endp == '\0')
 				resresv->qtime = count;
 			else
 				resresv->qtime = -1;
-		}
-		else if (!strcmp(attrp->name, ATTR_qrank)) { /* queue rank */
+			break;
+		case JATTR_QRANK: { /* queue rank */
 			long long qrank;
 			qrank = strtoll(attrp->value, &endp, 10);
 			if (*endp == '\0')
 				resresv->qrank = qrank;
 			else
 				resresv->qrank = -1;
+			break;
 		}
-		else if (!strcmp(attrp->name, ATTR_server_inst_id)) {
+		case JATTR_SERVER_INST_ID:
 			resresv->svr_inst_id = string_dup(attrp->value);
 			if (resresv->svr_inst_id == NULL) {
 				delete resresv;
 				return NULL;
 			}
-		}
-		else if (!strcmp(attrp->name, ATTR_etime)) { /* eligible time */
+			break;
+		case JATTR_ETIME: /* eligible time */
 			count = strtol(attrp->value, &endp, 10);
 			if (*endp == '\0')
 				resresv->job->etime = count;
 			else
 				resresv->job->etime = -1;
-		}
-		else if (!strcmp(attrp->name, ATTR_stime)) { /* job start time */
+			break;
+		case JATTR_STIME: /* job start time */
 			count = strtol(attrp->value, &endp, 10);
 			if (*endp == '\0')
 				resresv->job->stime = count;
 			else
 				resresv->job->stime = -1;
-		}
-		else if (!strcmp(attrp->name, ATTR_N))		/* job name (qsub -N) */
+			break;
+		case JATTR_JOB_NAME: /* job name (qsub -N) */
 			resresv->job->job_name = string_dup(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_state)) { /* state of job */
+			break;
+		case JATTR_STATE: /* state of job */
 			if (set_job_state(attrp->value, resresv->job) == 0) {
 				set_schd_error_codes(err, NEVER_RUN, ERR_SPECIAL);
 				set_schd_error_arg(err, SPECMSG, "Job is in an invalid state");
 				resresv->is_invalid = 1;
 			}
-		}
-		else if (!strcmp(attrp->name, ATTR_substate)) {
+			break;
+		case JATTR_SUBSTATE:
 			if (!strcmp(attrp->value, SUSP_BY_SCHED_SUBSTATE))
 				resresv->job->is_susp_sched = true;
 			if (!strcmp(attrp->value, PROVISIONING_SUBSTATE))
 				resresv->job->is_provisioning = true;
 			if (!strcmp(attrp->value, PRERUNNING_SUBSTATE))
 				resresv->job->is_prerunning = true;
-		}
-		else if (!strcmp(attrp->name, ATTR_sched_preempted)) {
+			break;
+		case JATTR_SCHED_PREEMPTED:
 			count = strtol(attrp->value, &endp, 10);
 			if (*endp == '\0') {
 				resresv->job->time_preempted = count;
 				resresv->job->is_preempted = true;
 			}
-		}
-		else if (!strcmp(attrp->name, ATTR_comment))	/* job comment */
+			break;
+		case JATTR_COMMENT: /* job comment */
 			resresv->job->comment = string_dup(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_released)) /* resources_released */
+			break;
+		case JATTR_RELEASED: /* resources_released */
 			resresv->job->resreleased = parse_execvnode(attrp->value, sinfo, NULL);
-		else if (!strcmp(attrp->name, ATTR_euser))	/* account name */
+			break;
+		case JATTR_EUSER: /* account name */
 			resresv->user = string_dup(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_egroup))	/* group name */
+			break;
+		case JATTR_EGROUP: /* group name */
 			resresv->group = string_dup(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_project))	/* project name */
+			break;
+		case JATTR_PROJECT: /* project name */
 			resresv->project = string_dup(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_resv_ID))	/* reserve_ID */
+			break;
+		case JATTR_RESV_ID: /* reserve_ID */
 			resresv->job->resv_id = string_dup(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_altid))    /* vendor ID */
+			break;
+		case JATTR_ALTID: /* vendor ID */
 			resresv->job->alt_id = string_dup(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_SchedSelect))
+			break;
+		case JATTR_SCHEDSELECT:
 #ifdef NAS /* localmod 031 */
-		{
 			resresv->job->schedsel = string_dup(attrp->value);
 #endif /* localmod 031 */
-
 			resresv->select = parse_selspec(attrp->value);
-#ifdef NAS /* localmod 031 */
-		}
-#endif /* localmod 031 */
-		else if (!strcmp(attrp->name, ATTR_array_id))
+			break;
+		case JATTR_ARRAY_ID:
 			resresv->job->array_id = attrp->value;
-		else if (!strcmp(attrp->name, ATTR_node_set))
+			break;
+		case JATTR_NODE_SET:
 			resresv->node_set_str = break_comma_list(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_array)) { /* array */
+			break;
+		case JATTR_ARRAY: /* array */
 			if (!strcmp(attrp->value, ATR_TRUE))
 				resresv->job->is_array = true;
-		}
-		else if (!strcmp(attrp->name, ATTR_array_index)) { /* array_index */
+			break;
+		case JATTR_ARRAY_INDEX: /* array_index */
 			count = strtol(attrp->value, &endp, 10);
 			if (*endp == '\0')
 				resresv->job->array_index = count;
@@ -1089,20 +1463,20 @@ query_job(int pbs_sd, struct batch_status *job, server_info *sinfo, queue_info *
 				resresv->job->array_index = -1;
 
 			resresv->job->is_subjob = true;
-		}
-		else if (!strcmp(attrp->name, ATTR_topjob_ineligible)) {
+			break;
+		case JATTR_TOPJOB_INELIGIBLE:
 			if (!strcmp(attrp->value, ATR_TRUE))
 				resresv->job->topjob_ineligible = true;
-		}
-		/* array_indices_remaining */
-		else if (!strcmp(attrp->name, ATTR_array_indices_remaining))
+			break;
+		case JATTR_ARRAY_INDICES_REMAINING:
 			resresv->job->queued_subjobs = range_parse(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_max_run_subjobs)) {
+			break;
+		case JATTR_MAX_RUN_SUBJOBS:
 			count = strtol(attrp->value, &endp, 10);
 			if (*endp == '\0')
 				resresv->job->max_run_subjobs = count;
-		}
-		else if (!strcmp(attrp->name, ATTR_execvnode)) {
+			break;
+		case JATTR_EXECVNODE: {
 			nspec **tmp_nspec_arr;
 			tmp_nspec_arr = parse_execvnode(attrp->value, sinfo, NULL);
 			resresv->nspec_arr = combine_nspec_array(tmp_nspec_arr);
@@ -1110,7 +1484,9 @@ query_job(int pbs_sd, struct batch_status *job, server_info *sinfo, queue_info *
 
 			if (resresv->nspec_arr != NULL)
 				resresv->ninfo_arr = create_node_array_from_nspec(resresv->nspec_arr);
-		} else if (!strcmp(attrp->name, ATTR_l)) { /* resources requested*/
+			break;
+		}
+		case JATTR_RESOURCE_LIST: /* resources requested*/
 			resreq = find_alloc_resource_req_by_str(resresv->resreq, attrp->resource);
 			if (resreq == NULL) {
 				delete resresv;
@@ -1147,45 +1523,53 @@ query_job(int pbs_sd, struct batch_status *job, server_info *sinfo, queue_info *
 					}
 				}
 			}
-		} else if (!strcmp(attrp->name, ATTR_rel_list)) {
+			break;
+		case JATTR_REL_LIST:
 			resreq = find_alloc_resource_req_by_str(resresv->job->resreq_rel, attrp->resource);
 			if (resreq != NULL)
 				set_resource_req(resreq, attrp->value);
 			if (resresv->job->resreq_rel == NULL)
 				resresv->job->resreq_rel = resreq;
-		} else if (!strcmp(attrp->name, ATTR_used)) { /* resources used */
+			break;
+		case JATTR_USED: /* resources used */
 			resreq =
 				find_alloc_resource_req_by_str(resresv->job->resused, attrp->resource);
 			if (resreq != NULL)
 				set_resource_req(resreq, attrp->value);
 			if (resresv->job->resused ==NULL)
 				resresv->job->resused = resreq;
-		} else if (!strcmp(attrp->name, ATTR_accrue_type)) {
+			break;
+		case JATTR_ACCRUE_TYPE:
 			count = strtol(attrp->value, &endp, 10);
 			if (*endp == '\0')
 				resresv->job->accrue_type = count;
 			else
 				resresv->job->accrue_type = 0;
-		} else if (!strcmp(attrp->name, ATTR_eligible_time))
+			break;
+		case JATTR_ELIGIBLE_TIME:
 			resresv->job->eligible_time = (time_t) res_to_num(attrp->value, NULL);
-		else if (!strcmp(attrp->name, ATTR_estimated)) {
+			break;
+		case JATTR_ESTIMATED:
 			if (!strcmp(attrp->resource, "start_time")) {
 				resresv->job->est_start_time =
 					(time_t) res_to_num(attrp->value, NULL);
 			}
 			else if (!strcmp(attrp->resource, "execvnode"))
 				resresv->job->est_execvnode = string_dup(attrp->value);
-		}
-		else if (!strcmp(attrp->name, ATTR_c)) { /* checkpoint allowed? */
+			break;
+		case JATTR_CHECKPOINT: /* checkpoint allowed? */
 			if (strcmp(attrp->value, "n") == 0)
 				resresv->job->can_checkpoint = false;
-		}
-		else if (!strcmp(attrp->name, ATTR_r)) { /* reque allowed ? */
+			break;
+		case JATTR_RERUNABLE: /* reque allowed ? */
 			if (strcmp(attrp->value, ATR_FALSE) == 0)
 				resresv->job->can_requeue = false;
-		}
-		else if (!strcmp(attrp->name, ATTR_depend)) {
+			break;
+		case JATTR_DEPEND:
 			resresv->job->depend_job_str = string_dup(attrp->value);
+			break;
+		default:
+			break;
 		}
 
 		attrp = attrp->next;
@@ -1284,7 +1668,7 @@ query_job(int pbs_sd, struct batch_status *job, server_info *sinfo, queue_info *
 	if (conf.fairshare_ent == "queue") {
 		if (sinfo->fstree != NULL) {
 			resresv->job->ginfo =
-				find_alloc_ginfo(qinfo->name.c_str(), sinfo->fstree->root);
+				find_alloc_ginfo(qinfo->name.c_str(), sinfo->fstree);
 		} else
 			resresv->job->ginfo = NULL;
 	}
@@ -1302,7 +1686,7 @@ query_job(int pbs_sd, struct batch_status *job, server_info *sinfo, queue_info *
 		sprintf(fairshare_name, "%s:%s", resresv->group, resresv->user);
 #endif /* localmod 058 */
 		if (resresv->server->fstree != NULL) {
-			resresv->job->ginfo = find_alloc_ginfo(fairshare_name, sinfo->fstree->root);
+			resresv->job->ginfo = find_alloc_ginfo(fairshare_name, sinfo->fstree);
 		} else
 			resresv->job->ginfo = NULL;
 	}
@@ -2122,6 +2506,7 @@ new_resresv_set(void)
 	}
 
 	rset->can_not_run = 0;
+	rset->verdict_restored = 0;
 	rset->err = NULL;
 	rset->user = NULL;
 	rset->group = NULL;
@@ -2182,6 +2567,7 @@ dup_resresv_set(resresv_set *oset, server_info *nsinfo)
 		return NULL;
 
 	rset->can_not_run = oset->can_not_run;
+	rset->verdict_restored = oset->verdict_restored;
 
 	rset->err = dup_schd_error(oset->err);
 	if (oset->err != NULL && oset->err == NULL) {
@@ -2610,6 +2996,307 @@ create_resresv_sets(status *policy, server_info *sinfo)
 	return rsets;
 }
 
+/* equivalence classes which could not run, kept from cycle to cycle
+ * as long as the universe they failed in does not change
+ */
+static std::size_t equiv_verdict_fingerprint = 0;
+static std::unordered_map<std::string, schd_error *> equiv_verdicts;
+
+/**
+ * @brief mix a value into a hash
+ *
+ * @param[in,out] h - hash to mix into
+ * @param[in] v - hash of the value
+ */
+static inline void
+hash_mix(std::size_t &h, std::size_t v)
+{
+	h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+}
+
+/**
+ * @brief mix a resource list into a hash
+ *
+ * @param[in,out] h - hash to mix into
+ * @param[in] res - resource list
+ */
+static void
+hash_resource_list(std::size_t &h, schd_resource *res)
+{
+	for (; res != NULL; res = res->next) {
+		hash_mix(h, std::hash<std::string>()(res->name));
+		hash_mix(h, std::hash<double>()(res->avail));
+		hash_mix(h, std::hash<double>()(res->assigned));
+		if (res->orig_str_avail != NULL)
+			hash_mix(h, std::hash<std::string>()(res->orig_str_avail));
+	}
+}
+
+/**
+ * @brief fingerprint what is_ok_to_run() looks at when it searches for
+ *	  resources for a job: the nodes, server and queue resources,
+ *	  the running work and the policy which decides placement.
+ *
+ * @param[in] policy - policy info
+ * @param[in] sinfo - server universe
+ *
+ * @return the fingerprint
+ */
+static std::size_t
+universe_fingerprint(status *policy, server_info *sinfo)
+{
+	std::size_t h = 0;
+	std::size_t defs = 0;
+	int i;
+
+	hash_mix(h, policy->is_prime);
+	hash_mix(h, policy->is_ded_time);
+	/* order independent: the set is unordered */
+	for (auto def : policy->resdef_to_check)
+		defs += std::hash<std::string>()(def->name);
+	hash_mix(h, defs);
+	hash_mix(h, sc_attrs.do_not_span_psets);
+	hash_mix(h, sc_attrs.only_explicit_psets);
+	hash_mix(h, sinfo->node_group_enable);
+	if (sinfo->node_group_key != NULL)
+		for (i = 0; sinfo->node_group_key[i] != NULL; i++)
+			hash_mix(h, std::hash<std::string>()(sinfo->node_group_key[i]));
+
+	hash_resource_list(h, sinfo->res);
+
+	for (i = 0; sinfo->queues[i] != NULL; i++) {
+		queue_info *qinfo = sinfo->queues[i];
+		hash_mix(h, std::hash<std::string>()(qinfo->name));
+		hash_mix(h, qinfo->is_started);
+		hash_mix(h, qinfo->is_ok_to_run);
+		hash_mix(h, qinfo->num_nodes);
+		hash_resource_list(h, qinfo->qres);
+	}
+
+	for (i = 0; sinfo->nodes[i] != NULL; i++) {
+		node_info *node = sinfo->nodes[i];
+		unsigned int state = 0;
+
+		state = (node->is_down << 0) | (node->is_free << 1) | (node->is_offline << 2) |
+			(node->is_unknown << 3) | (node->is_exclusive << 4) |
+			(node->is_job_exclusive << 5) | (node->is_resv_exclusive << 6) |
+			(node->is_sharing << 7) | (node->is_busy << 8) | (node->is_job_busy << 9) |
+			(node->is_stale << 10) | (node->is_maintenance << 11) |
+			(node->no_multinode_jobs << 12) | (node->is_provisioning << 13) |
+			(node->is_sleeping << 14) | (node->provision_enable << 15);
+		hash_mix(h, std::hash<std::string>()(node->name));
+		hash_mix(h, state);
+		hash_mix(h, node->sharing);
+		hash_mix(h, std::hash<std::string>()(node->queue_name));
+		hash_mix(h, node->num_jobs);
+		hash_mix(h, node->num_run_resv);
+		hash_mix(h, node->priority);
+		hash_mix(h, node->max_running);
+		hash_mix(h, node->max_user_run);
+		hash_mix(h, node->max_group_run);
+		hash_mix(h, node->last_used_time);
+		if (node->current_aoe != NULL)
+			hash_mix(h, std::hash<std::string>()(node->current_aoe));
+		hash_resource_list(h, node->res);
+	}
+
+	for (i = 0; sinfo->running_jobs[i] != NULL; i++)
+		hash_mix(h, std::hash<std::string>()(sinfo->running_jobs[i]->name));
+
+	for (i = 0; sinfo->resvs[i] != NULL; i++) {
+		resource_resv *resv = sinfo->resvs[i];
+		hash_mix(h, std::hash<std::string>()(resv->name));
+		hash_mix(h, resv->resv->resv_state);
+		hash_mix(h, resv->start);
+		hash_mix(h, resv->end);
+	}
+
+	return h;
+}
+
+/**
+ * @brief build a key which is the same for equal resresv_sets of
+ *	  different cycles
+ *
+ * @param[in] rset - the resresv_set
+ *
+ * @return the key
+ */
+static std::string
+resresv_set_key(resresv_set *rset)
+{
+	std::string key;
+	std::vector<std::string> reqs;
+	char buf[64];
+	int i;
+
+	/* \x1f separates fields, a NULL field is \x1e */
+	key += rset->qinfo != NULL ? rset->qinfo->name : "\x1e";
+	key += '\x1f';
+	key += rset->user != NULL ? rset->user : "\x1e";
+	key += '\x1f';
+	key += rset->group != NULL ? rset->group : "\x1e";
+	key += '\x1f';
+	key += rset->project != NULL ? rset->project : "\x1e";
+	key += '\x1f';
+	for (i = 0; rset->select_spec->chunks[i] != NULL; i++) {
+		snprintf(buf, sizeof(buf), "%d:", rset->select_spec->chunks[i]->num_chunks);
+		key += buf;
+		key += rset->select_spec->chunks[i]->str_chunk;
+		key += '+';
+	}
+	key += '\x1f';
+	if (rset->place_spec != NULL) {
+		place *pl = rset->place_spec;
+		snprintf(buf, sizeof(buf), "%d%d%d%d%d%d%d", pl->free, pl->pack, pl->scatter,
+			pl->vscatter, pl->excl, pl->exclhost, pl->share);
+		key += buf;
+		if (pl->group != NULL)
+			key += pl->group;
+	}
+	key += '\x1f';
+	/* rset->req is compared without regard to order */
+	for (auto req = rset->req; req != NULL; req = req->next) {
+		snprintf(buf, sizeof(buf), "=%.17g=", req->amount);
+		reqs.push_back(std::string(req->name) + buf + (req->res_str != NULL ? req->res_str : ""));
+	}
+	std::sort(reqs.begin(), reqs.end());
+	for (const auto &r : reqs) {
+		key += r;
+		key += '\x1f';
+	}
+
+	return key;
+}
+
+/**
+ * @brief
+ *	mark the equivalence classes which could not run in the previous
+ *	cycle as not able to run, if nothing they depend on has changed.
+ *	If anything has, forget all of them.
+ *
+ * @param[in] policy - policy info
+ * @param[in] sinfo - server universe
+ *
+ * @return void
+ */
+void
+restore_equiv_class_verdicts(status *policy, server_info *sinfo)
+{
+	int restored = 0;
+	int i;
+
+	if (policy == NULL || sinfo == NULL)
+		return;
+
+	auto fp = universe_fingerprint(policy, sinfo);
+	if (fp != equiv_verdict_fingerprint) {
+		clear_equiv_class_verdicts();
+		equiv_verdict_fingerprint = fp;
+		return;
+	}
+
+	if (sinfo->equiv_classes == NULL || sinfo->qrun_job != NULL)
+		return;
+
+	for (i = 0; sinfo->equiv_classes[i] != NULL; i++) {
+		resresv_set *ec = sinfo->equiv_classes[i];
+		auto it = equiv_verdicts.find(resresv_set_key(ec));
+		if (it != equiv_verdicts.end() && !ec->can_not_run) {
+			ec->can_not_run = 1;
+			ec->verdict_restored = 1;
+			ec->err = dup_schd_error(it->second);
+			restored++;
+		}
+	}
+
+	if (restored > 0)
+		log_eventf(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+			"%d job equivalence classes can not run since the previous cycle", restored);
+}
+
+/**
+ * @brief
+ *	forget the verdicts restore_equiv_class_verdicts() kept from the
+ *	previous cycle.  They only hold until a job runs or is preempted:
+ *	the universe fingerprint does not cover the queued jobs which do so.
+ *
+ * @param[in] sinfo - server universe
+ *
+ * @return void
+ */
+void
+drop_restored_equiv_class_verdicts(server_info *sinfo)
+{
+	int i;
+
+	if (sinfo == NULL || sinfo->equiv_classes == NULL)
+		return;
+
+	for (i = 0; sinfo->equiv_classes[i] != NULL; i++) {
+		resresv_set *ec = sinfo->equiv_classes[i];
+		if (ec->verdict_restored) {
+			ec->can_not_run = 0;
+			ec->verdict_restored = 0;
+			free_schd_error(ec->err);
+			ec->err = NULL;
+		}
+	}
+}
+
+/**
+ * @brief
+ *	remember that an equivalence class could not run for the next cycle.
+ *	Only verdicts which depend on nothing but the resources in the
+ *	universe fingerprint are kept: the job must have been checked before
+ *	anything ran or was preempted in this cycle and while no run events
+ *	were in the calendar.
+ *
+ * @param[in] sinfo - server universe
+ * @param[in] ec - equivalence class which can not run
+ * @param[in] unchanged - nothing has run or been preempted this cycle
+ *
+ * @return void
+ */
+void
+save_equiv_class_verdict(server_info *sinfo, resresv_set *ec, int unchanged)
+{
+	if (sinfo == NULL || ec == NULL || ec->err == NULL || !unchanged)
+		return;
+
+	if (sinfo->qrun_job != NULL || (sinfo->calendar != NULL && sinfo->calendar->first_run_event != NULL))
+		return;
+
+	switch (ec->err->error_code) {
+		case INSUFFICIENT_RESOURCE:
+		case INSUFFICIENT_QUEUE_RESOURCE:
+		case INSUFFICIENT_SERVER_RESOURCE:
+		case NOT_ENOUGH_NODES_AVAIL:
+		case NO_NODE_RESOURCES:
+		case NO_FREE_NODES:
+			break;
+		default:
+			return;
+	}
+
+	auto key = resresv_set_key(ec);
+	if (equiv_verdicts.find(key) == equiv_verdicts.end())
+		equiv_verdicts[key] = dup_schd_error(ec->err);
+}
+
+/**
+ * @brief forget all equivalence class verdicts kept between cycles
+ *
+ * @return void
+ */
+void
+clear_equiv_class_verdicts(void)
+{
+	for (auto &v : equiv_verdicts)
+		free_schd_error(v.second);
+	equiv_verdicts.clear();
+}
+
 /**
  * @brief
  * 		job_info copy constructor
@@ -2675,6 +3362,11 @@ dup_job_info(job_info *ojinfo, queue_info *nqinfo, server_info *nsinfo)
 
 	njinfo->resused = dup_resource_req_list(ojinfo->resused);
 
+	njinfo->accrue_type = ojinfo->accrue_type;
+	njinfo->eligible_time = ojinfo->eligible_time;
+	njinfo->time_preempted = ojinfo->time_preempted;
+	njinfo->is_preempted = ojinfo->is_preempted;
+
 	njinfo->array_index = ojinfo->array_index;
 	njinfo->array_id = ojinfo->array_id;
 	njinfo->queued_subjobs = dup_range_list(ojinfo->queued_subjobs);
@@ -2684,13 +3376,19 @@ dup_job_info(job_info *ojinfo, queue_info *nqinfo, server_info *nsinfo)
 	njinfo->resreq_rel = dup_resource_req_list(ojinfo->resreq_rel);
 
 	if (nqinfo->server->fstree !=NULL) {
-		njinfo->ginfo = find_group_info(ojinfo->ginfo->name,
-			nqinfo->server->fstree->root);
+		/* if both universes see the same tree, the group_info can be reused */
+		if (ojinfo->queue != NULL && ojinfo->queue->server->fstree == nqinfo->server->fstree)
+			njinfo->ginfo = ojinfo->ginfo;
+		else if (ojinfo->ginfo != NULL)
+			njinfo->ginfo = find_group_info(ojinfo->ginfo->name,
+				nqinfo->server->fstree);
+		else
+			njinfo->ginfo = NULL;
 	}
 	else
 		njinfo->ginfo = NULL;
 
-	njinfo->depend_job_str = string_dup(njinfo->depend_job_str);
+	njinfo->depend_job_str = string_dup(ojinfo->depend_job_str);
 
 #ifdef RESC_SPEC
 	njinfo->rspec = dup_rescspec(ojinfo->rspec);
@@ -3036,6 +3734,127 @@ find_and_preempt_jobs(status *policy, int pbs_sd, resource_resv *hjob, server_in
 }
 
 
+/**
+ * @brief
+ *		can a node hold at least one chunk of a high priority job if its
+ *		running work is preempted.  Only the node's totals are looked at,
+ *		so the answer is cached for the rest of the search.
+ *
+ * @param[in] policy - policy info
+ * @param[in] hjob - the high priority job to preempt for
+ * @param[in] node - the node
+ * @param[in,out] cache - candidate cache of hjob
+ *
+ * @return bool
+ */
+static bool
+is_preempt_node_useful(status *policy, resource_resv *hjob, node_info *node, preempt_cand_cache *cache)
+{
+	auto it = cache->node_ok.find(node->rank);
+	if (it != cache->node_ok.end())
+		return it->second;
+
+	bool only_check_noncons = false;
+	bool useful = false;
+	schd_error *err;
+
+	err = new_schd_error();
+	if (err == NULL)
+		return false;
+
+	if (node->is_multivnoded) {
+		/* unsafe to consider vnodes from multivnoded hosts "no good" when "not enough" of some consumable
+		 * resource can be found in the vnode, since rest may be provided by other vnodes on the same host
+		 * restrict check on these vnodes to check only against non consumable resources
+		 */
+		if (policy->resdef_to_check_noncons.empty()) {
+			for (const auto& rtc : policy->resdef_to_check) {
+				if (rtc->type.is_non_consumable)
+					policy->resdef_to_check_noncons.insert(rtc);
+			}
+		}
+		only_check_noncons = true;
+	}
+	for (int k = 0; hjob->select->chunks[k] != NULL; k++) {
+		long num_chunks_returned = 0;
+		unsigned int flags = COMPARE_TOTAL | CHECK_ALL_BOOLS | UNSET_RES_ZERO;
+		/* if only non consumables are checked, infinite number of chunks can be satisfied,
+		 * and SCHD_INFINITY is negative, so don't be tempted to check on positive value
+		 */
+		clear_schd_error(err);
+		if (only_check_noncons) {
+			if (!policy->resdef_to_check_noncons.empty())
+				num_chunks_returned = check_avail_resources(node->res, hjob->select->chunks[k]->req,
+								flags, policy->resdef_to_check_noncons, INSUFFICIENT_RESOURCE, err);
+			else
+				num_chunks_returned = SCHD_INFINITY;
+		} else
+			num_chunks_returned = check_avail_resources(node->res, hjob->select->chunks[k]->req,
+					flags, INSUFFICIENT_RESOURCE, err);
+
+		if ( (num_chunks_returned > 0) || (num_chunks_returned == SCHD_INFINITY) ) {
+			useful = true;
+			break;
+		}
+	}
+	free_schd_error(err);
+
+	cache->node_ok[node->rank] = useful;
+	return useful;
+}
+
+/**
+ * @brief
+ *		collect the running jobs of a lower preemption priority than a high
+ *		priority job which run on a node that can hold a chunk of it.  The
+ *		nodes are walked rather than the jobs, so jobs only on nodes which
+ *		are of no use to the high priority job are never looked at.
+ *
+ * @param[in] policy - policy info
+ * @param[in] hjob - the high priority job to preempt for
+ * @param[in] sinfo - the server to look in
+ * @param[in,out] cache - candidate cache of hjob
+ *
+ * @return resource_resv **
+ * @retval NULL terminated array of candidates, to be freed with free()
+ * @retval NULL on error
+ */
+static resource_resv **
+preempt_cands_on_useful_nodes(status *policy, resource_resv *hjob, server_info *sinfo, preempt_cand_cache *cache)
+{
+	resource_resv **cands;
+	std::unordered_set<int> seen;
+	int n = 0;
+
+	cands = static_cast<resource_resv **>(malloc((sinfo->sc.running + 1) * sizeof(resource_resv *)));
+	if (cands == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	for (int i = 0; sinfo->nodes[i] != NULL && n < sinfo->sc.running; i++) {
+		node_info *node = sinfo->nodes[i];
+
+		if (node->num_jobs == 0 || node->job_arr == NULL)
+			continue;
+		if (!is_preempt_node_useful(policy, hjob, node, cache))
+			continue;
+
+		for (int j = 0; node->job_arr[j] != NULL && n < sinfo->sc.running; j++) {
+			resource_resv *rjob = node->job_arr[j];
+
+			if (rjob->job == NULL || !rjob->job->is_running ||
+				rjob->job->preempt >= hjob->job->preempt)
+				continue;
+			if (seen.insert(rjob->rank).second)
+				cands[n++] = rjob;
+		}
+	}
+	cands[n] = NULL;
+
+	return cands;
+}
+
 /**
  * @brief
  * 		find jobs to preempt in order to run a high priority job.
@@ -3093,6 +3912,7 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 	char **preempt_targets_list = NULL;
 	resource_resv **prjobs = NULL;
 	int rjobs_count = 0;
+	preempt_cand_cache cand_cache;
 
 
 	*no_of_jobs = 0;
@@ -3209,6 +4029,37 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 		}
 	}
 
+	/* The first candidate is picked before anything is preempted, so it can
+	 * be looked for in the real universe.  Only jobs on nodes which can hold
+	 * a chunk of the job are looked at.  If there is none, don't pay for
+	 * duplicating the universe to simulate in.
+	 */
+	err = dup_schd_error(full_err);
+	if (err != NULL) {
+		resource_resv **on_nodes;
+		resource_resv **cands = NULL;
+		long first = NO_JOB_FOUND;
+
+		on_nodes = preempt_cands_on_useful_nodes(policy, hjob, sinfo, &cand_cache);
+		if (on_nodes != NULL && on_nodes[0] != NULL)
+			cands = filter_preemptable_jobs(on_nodes, hjob, err);
+		if (cands != NULL)
+			first = select_index_to_preempt(policy, hjob, cands, 0, err, fail_list, &cand_cache);
+		free(cands);
+		free(on_nodes);
+		free_schd_error(err);
+		err = NULL;
+
+		if (first == NO_JOB_FOUND) {
+			log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_INFO, hjob->name,
+				"Found no preemptable candidates, not simulating preemption");
+			free_schd_error_list(full_err);
+			free(pjobs);
+			free_string_array(preempt_targets_list);
+			return NULL;
+		}
+	}
+
 	/* use locally dup'd copy of sinfo so we don't modify the original */
 	if ((nsinfo = dup_server_info(sinfo)) == NULL) {
 		free_schd_error_list(full_err);
@@ -3280,7 +4131,7 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 	}
 
 	skipto = 0;
-	while ((indexfound = select_index_to_preempt(npolicy, nhjob, rjobs_subset, skipto, err, fail_list)) != NO_JOB_FOUND) {
+	while ((indexfound = select_index_to_preempt(npolicy, nhjob, rjobs_subset, skipto, err, fail_list, &cand_cache)) != NO_JOB_FOUND) {
 		struct preempt_ordering *po;
 		int dont_preempt_job = 0;
 		int ind = 0;
@@ -3321,6 +4172,8 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 			remove_resresv_from_array(rjobs_subset, pjob);
 			log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_INFO, pjob->name,
 				  "Preempting job will escalate its priority or priority of other jobs, not preempting it");
+			/* it may not land on the same nodes again */
+			cand_cache.job_ok.erase(pjob->rank);
 			if (sim_run_update_resresv(npolicy, pjob, ns_arr, NO_ALLPART) != 1) {
 				log_event(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_INFO, nhjob->name,
 					  "Trouble finding preemptable candidates");
@@ -3487,195 +4340,162 @@ cleanup:
 
 /**
  * @brief
- *		select a good candidate for preemption
+ *		the checks of a preemption candidate which do not change while
+ *		preemption is simulated.  The answer is cached by job rank.
  *
  * @param[in] policy - policy info
  * @param[in] hjob - the high priority job to preempt for
- * @param[in] rjobs - the list of running jobs to select from
- * @param[in] skipto - Index from where we need to start looking into rjobs
- * @param[in] err    - reason the high prio job isn't running
- * @param[in] fail_list - list of jobs to skip. They previously failed to be preempted.
- *			  Do not select them again.
+ * @param[in] rjob - the candidate
+ * @param[in,out] cache - candidate cache of hjob
  *
- * @return long
- * @retval index of the job to preempt
- * @retval NO_JOB_FOUND nothing can be selected for preemption
- * @retval ERR_IN_SELECT error
+ * @return bool
  */
-long
-select_index_to_preempt(status *policy, resource_resv *hjob,
-	resource_resv **rjobs, long skipto, schd_error *err,
-	int *fail_list)
+static bool
+is_preempt_candidate(status *policy, resource_resv *hjob, resource_resv *rjob, preempt_cand_cache *cache)
 {
-	int i, j, k;
-	int good = 1;		/* good boolean: Is job eligible to be preempted */
 	struct preempt_ordering *po;
+	int j;
 
-	if ( err == NULL || hjob == NULL || hjob->job == NULL ||
-		rjobs == NULL || rjobs[0] == NULL)
-		return NO_JOB_FOUND;
-
-	/* This shouldn't happen, but you can never be too paranoid */
-	if (hjob->job->is_running && hjob->ninfo_arr == NULL)
-		return NO_JOB_FOUND;
+	auto it = cache->job_ok.find(rjob->rank);
+	if (it != cache->job_ok.end())
+		return it->second;
 
-	/* if we find a good job, we'll break out at the bottom
-	 * we can't break out up here since i will be incremented by this point
-	 * and we'll be returning the job AFTER the one we want too
-	 */
-	for (i = skipto; rjobs[i] != NULL; i++) {
-		/* Does the running job have any resource we need? */
-		int node_good = 1;
+	bool good = true;
 
-		/* lets be optimistic.. we'll start off assuming this is a good candidate */
-		good = 1;
+	if (rjob->job->is_provisioning)
+		good = false; /* provisioning job cannot be preempted */
 
-		/* if hjob hit a hard limit, check if candidate job has requested that resource
-		 * if reason is different then set flag as if resource was found
-		 */
+	if (good && rjob->job->can_not_preempt)
+		good = false;
 
-		if (rjobs[i]->job == NULL || rjobs[i]->ninfo_arr == NULL)
-			continue; /* we have problems... */
+	if (good && cache->fail_ranks.find(rjob->rank) != cache->fail_ranks.end())
+		good = false;
 
-		if (!rjobs[i]->job->is_running)
-			/* Only running jobs have resources allocated to them.
-			 * They are only eligible to preempt.
-			 */
-			good = 0;
+	if (good) {
+		/* get the preemption order to be used for this job */
+		po = schd_get_preempt_order(rjob);
 
+		/* check whether chosen order is enabled for this job */
+		for (j = 0; j < PREEMPT_METHOD_HIGH; j++) {
+			if (po->order[j] == PREEMPT_METHOD_SUSPEND  &&
+				rjob->job->can_suspend)
+				break; /* suspension is always allowed */
 
-		if (rjobs[i]->job->is_provisioning)
-			good = 0; /* provisioning job cannot be preempted */
+			if (po->order[j] == PREEMPT_METHOD_CHECKPOINT &&
+				rjob->job->can_checkpoint)
+				break; /* choose if checkpoint is allowed */
 
-		if (good) {
-			if (rjobs[i]->job->can_not_preempt ||
-			rjobs[i]->job->preempt >= hjob->job->preempt)
-				good = 0;
+			if (po->order[j] == PREEMPT_METHOD_REQUEUE &&
+				rjob->job->can_requeue)
+				break; /* choose if requeue is allowed */
+			if (po->order[j] == PREEMPT_METHOD_DELETE)
+				break;
 		}
+		if (j == PREEMPT_METHOD_HIGH) /* no preemption method good */
+			good = false;
+	}
 
-		if (good) {
-			for (j = 0; fail_list[j] != 0; j++) {
-				if (fail_list[j] == rjobs[i]->rank) {
-					good = 0;
-					break;
-				}
-			}
+	if (good) {
+		for (j = 0; good && rjob->ninfo_arr[j] != NULL; j++) {
+			if (rjob->ninfo_arr[j]->is_down || rjob->ninfo_arr[j]->is_offline)
+				good = false;
 		}
+	}
 
-		if (good) {
-			/* get the preemption order to be used for this job */
-			po = schd_get_preempt_order(rjobs[i]);
-
-			/* check whether chosen order is enabled for this job */
-			for (j = 0; j < PREEMPT_METHOD_HIGH; j++) {
-				if (po->order[j] == PREEMPT_METHOD_SUSPEND  &&
-					rjobs[i]->job->can_suspend)
-					break; /* suspension is always allowed */
-
-				if (po->order[j] == PREEMPT_METHOD_CHECKPOINT &&
-					rjobs[i]->job->can_checkpoint)
-					break; /* choose if checkpoint is allowed */
+	/* if the high priority job is suspended then make sure we only
+	 * select jobs from the node the job is currently suspended on
+	 */
 
-				if (po->order[j] == PREEMPT_METHOD_REQUEUE &&
-					rjobs[i]->job->can_requeue)
-					break; /* choose if requeue is allowed */
-				if (po->order[j] == PREEMPT_METHOD_DELETE)
+	if (good) {
+		if (hjob->ninfo_arr != NULL) {
+			for (j = 0; hjob->ninfo_arr[j] != NULL; j++) {
+				if (find_node_by_rank(rjob->ninfo_arr,
+					hjob->ninfo_arr[j]->rank) != NULL)
 					break;
 			}
-			if (j == PREEMPT_METHOD_HIGH) /* no preemption method good */
-				good = 0;
+
+			/* if we made all the way through the list, then rjob has no useful
+			 * nodes for us to use... don't select it, unless it's not node resources we're after
+			 */
+
+			if (hjob->ninfo_arr[j] == NULL)
+				good = false;
 		}
+	}
 
-		if (good) {
-			for (j = 0; good && rjobs[i]->ninfo_arr[j] != NULL; j++) {
-				if (rjobs[i]->ninfo_arr[j]->is_down || rjobs[i]->ninfo_arr[j]->is_offline)
-					good = 0;
+	if (good) {
+		good = false;
+		for (j = 0; rjob->ninfo_arr[j] != NULL; j++) {
+			if (is_preempt_node_useful(policy, hjob, rjob->ninfo_arr[j], cache)) {
+				good = true;
+				break;
 			}
 		}
+	}
 
-		/* if the high priority job is suspended then make sure we only
-		 * select jobs from the node the job is currently suspended on
-		 */
+	cache->job_ok[rjob->rank] = good;
+	return good;
+}
 
-		if (good) {
-			if (hjob->ninfo_arr != NULL) {
-				for (j = 0; hjob->ninfo_arr[j] != NULL; j++) {
-					if (find_node_by_rank(rjobs[i]->ninfo_arr,
-						hjob->ninfo_arr[j]->rank) != NULL)
-						break;
-				}
+/**
+ * @brief
+ *		select a good candidate for preemption
+ *
+ * @param[in] policy - policy info
+ * @param[in] hjob - the high priority job to preempt for
+ * @param[in] rjobs - the list of running jobs to select from
+ * @param[in] skipto - Index from where we need to start looking into rjobs
+ * @param[in] err    - reason the high prio job isn't running
+ * @param[in] fail_list - list of jobs to skip. They previously failed to be preempted.
+ *			  Do not select them again.
+ * @param[in,out] cache - candidate cache of hjob kept between calls.  If NULL,
+ *			  nothing is remembered past this call.
+ *
+ * @return long
+ * @retval index of the job to preempt
+ * @retval NO_JOB_FOUND nothing can be selected for preemption
+ * @retval ERR_IN_SELECT error
+ */
+long
+select_index_to_preempt(status *policy, resource_resv *hjob,
+	resource_resv **rjobs, long skipto, schd_error *err,
+	int *fail_list, preempt_cand_cache *cache)
+{
+	preempt_cand_cache lcache;
+	int i;
 
-				/* if we made all the way through the list, then rjobs[i] has no useful
-				 * nodes for us to use... don't select it, unless it's not node resources we're after
-				 */
+	if ( err == NULL || hjob == NULL || hjob->job == NULL ||
+		rjobs == NULL || rjobs[0] == NULL)
+		return NO_JOB_FOUND;
 
-				if (hjob->ninfo_arr[j] == NULL)
-					good = 0;
-			}
-		}
-		if (good) {
-			schd_error *err;
-			node_good = 0;
-
-			err = new_schd_error();
-			if(err == NULL)
-				return NO_JOB_FOUND;
-
-			for (j = 0; rjobs[i]->ninfo_arr[j] != NULL && !node_good; j++) {
-				node_info *node = rjobs[i]->ninfo_arr[j];
-				bool only_check_noncons = false;
-
-				if (node->is_multivnoded) {
-					/* unsafe to consider vnodes from multivnoded hosts "no good" when "not enough" of some consumable
-					 * resource can be found in the vnode, since rest may be provided by other vnodes on the same host
-					 * restrict check on these vnodes to check only against non consumable resources
-					 */
-					if (policy->resdef_to_check_noncons.empty()) {
-						for (const auto& rtc : policy->resdef_to_check) {
-							if (rtc->type.is_non_consumable)
-								policy->resdef_to_check_noncons.insert(rtc);
-						}
-					}
-					only_check_noncons = true;
-				}
-				for (k = 0; hjob->select->chunks[k] != NULL; k++) {
-					long num_chunks_returned = 0;
-					unsigned int flags = COMPARE_TOTAL | CHECK_ALL_BOOLS | UNSET_RES_ZERO;
-					/* if only non consumables are checked, infinite number of chunks can be satisfied,
-					 * and SCHD_INFINITY is negative, so don't be tempted to check on positive value
-					 */
-					clear_schd_error(err);
-					if (only_check_noncons) {
-						if (!policy->resdef_to_check_noncons.empty())
-							num_chunks_returned = check_avail_resources(node->res, hjob->select->chunks[k]->req,
-											flags, policy->resdef_to_check_noncons, INSUFFICIENT_RESOURCE, err);
-						else
-							num_chunks_returned = SCHD_INFINITY;
-					} else
-						num_chunks_returned = check_avail_resources(node->res, hjob->select->chunks[k]->req,
-								flags, INSUFFICIENT_RESOURCE, err);
-
-					if ( (num_chunks_returned > 0) || (num_chunks_returned == SCHD_INFINITY) ) {
-						node_good = 1;
-						break;
-					}
+	/* This shouldn't happen, but you can never be too paranoid */
+	if (hjob->job->is_running && hjob->ninfo_arr == NULL)
+		return NO_JOB_FOUND;
 
-				}
-			}
-			free_schd_error(err);
-		}
+	if (cache == NULL)
+		cache = &lcache;
+	if (!cache->have_fail_ranks) {
+		for (i = 0; fail_list != NULL && fail_list[i] != 0; i++)
+			cache->fail_ranks.insert(fail_list[i]);
+		cache->have_fail_ranks = true;
+	}
 
-		if (node_good == 0)
-			good = 0;
+	for (i = skipto; rjobs[i] != NULL; i++) {
+		if (rjobs[i]->job == NULL || rjobs[i]->ninfo_arr == NULL)
+			continue; /* we have problems... */
 
+		/* Only running jobs have resources allocated to them.
+		 * They are only eligible to preempt.
+		 * Preemption priorities can change as work is preempted.
+		 */
+		if (!rjobs[i]->job->is_running ||
+			rjobs[i]->job->preempt >= hjob->job->preempt)
+			continue;
 
-		if (good)
-			break;
+		if (is_preempt_candidate(policy, hjob, rjobs[i], cache))
+			return i;
 	}
 
-	if (good && rjobs[i] != NULL)
-		return i;
-
 	return NO_JOB_FOUND;
 }
 
@@ -4089,8 +4909,7 @@ queue_subjob(resource_resv *array, server_info *sinfo,
 
 /**
  * @brief
- * 		evaluate a math formula for jobs based on their resources
- *		NOTE: currently done through embedded python interpreter
+ * 		evaluate a math formula for jobs through the embedded python interpreter
  *
  * @param[in]	formula	-	formula to evaluate
  * @param[in]	resresv	-	job for special case key words
@@ -4101,8 +4920,8 @@ queue_subjob(resource_resv *array, server_info *sinfo,
  */
 
 #ifdef PYTHON
-sch_resource_t
-formula_evaluate(const char *formula, resource_resv *resresv, resource_req *resreq)
+static sch_resource_t
+formula_evaluate_python(const char *formula, resource_resv *resresv, resource_req *resreq)
 {
 	char buf[1024];
 	char *globals;
@@ -4217,13 +5036,43 @@ formula_evaluate(const char *formula, resource_resv *resresv, resource_req *resr
 	return ans;
 }
 #else
-sch_resource_t
-formula_evaluate(char *formula, resource_resv *resresv, resource_req *resreq)
+static sch_resource_t
+formula_evaluate_python(const char *formula, resource_resv *resresv, resource_req *resreq)
 {
 	return 0;
 }
 #endif
 
+/**
+ * @brief
+ * 		evaluate a math formula for jobs based on their resources
+ *		NOTE: formulas are compiled and evaluated natively where possible,
+ *		the rest are evaluated through the embedded python interpreter
+ *
+ * @param[in]	formula	-	formula to evaluate
+ * @param[in]	resresv	-	job for special case key words
+ * @param[in]	resreq	-	resources to use when evaluating
+ *
+ * @return	evaluated formula answer or 0 on exception
+ *
+ */
+sch_resource_t
+formula_evaluate(const char *formula, resource_resv *resresv, resource_req *resreq)
+{
+	const formula_prog *prog;
+	sch_resource_t ans;
+
+	if (formula == NULL || resresv == NULL ||
+		resresv->job == NULL)
+		return 0;
+
+	prog = find_formula_prog(formula);
+	if (prog != NULL && formula_prog_evaluate(prog, resresv, resreq, &ans))
+		return ans;
+
+	return formula_evaluate_python(formula, resresv, resreq);
+}
+
 /**
  * @brief
  * 		Set the job accrue type to eligible time.
@@ -56,6 +56,12 @@ void query_jobs_chunk(th_data_query_jinfo *data);
 /* create an array of jobs for a particular queue */
 resource_resv **query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs, const std::string& queue_name);
 
+/* drop jobs not seen this cycle from the query cache */
+int query_cache_sweep(void);
+
+/* empty the query cache */
+void free_query_cache(void);
+
 
 /*
  *	new_job_info  - allocate and initialize new job_info structure
@@ -169,7 +175,7 @@ find_jobs_to_preempt(status *policy, resource_resv *jinfo,
 long
 select_index_to_preempt(status *policy, resource_resv *hjob,
 	resource_resv **rjobs, long skipto, schd_error *err,
-	int *fail_list);
+	int *fail_list, preempt_cand_cache *cache = NULL);
 
 /*
  *      preempt_level - take a preemption priority and return a preemption
@@ -360,6 +366,19 @@ std::unordered_set<resdef *> create_resresv_sets_resdef(status *policy);
 
 /* Create an array of resresv_sets based on sinfo*/
 resresv_set **create_resresv_sets(status *policy, server_info *sinfo);
+
+/* mark equivalence classes which could not run last cycle if nothing changed */
+void restore_equiv_class_verdicts(status *policy, server_info *sinfo);
+
+/* forget the verdicts kept from the previous cycle once the universe changes */
+void drop_restored_equiv_class_verdicts(server_info *sinfo);
+
+/* remember an equivalence class which could not run for the next cycle */
+void save_equiv_class_verdict(server_info *sinfo, resresv_set *ec, int unchanged);
+
+/* forget all equivalence class verdicts kept between cycles */
+void clear_equiv_class_verdicts(void);
+
 /*
  * This function creates a string and update resources_released job
  *  attribute.
@@ -92,11 +92,10 @@
  * 	lim_setoldlimits()
  * 	lim_dup_ctx()
  * 	is_hardlimit()
- * 	lim_gengroupreskey()
- * 	lim_genprojectreskey()
- * 	lim_genuserreskey()
  * 	lim_callback()
  * 	lim_get()
+ * 	lim_entity_id()
+ * 	lim_get_ent()
  * 	schderr_args_q()
  * 	schderr_args_q_res()
  * 	schderr_args_server()
@@ -119,6 +118,10 @@
 #include	<stdio.h>
 #include	<string.h>
 #include	<assert.h>
+
+#include	<string>
+#include	<unordered_map>
+
 #include	"pbs_config.h"
 #include	"pbs_ifl.h"
 #include	"data_types.h"
@@ -367,14 +370,12 @@ static int
 lim_callback(void *, enum lim_keytypes, char *, char *,
 	char *, char *);
 static void		*lim_dup_ctx(void *);
-static char		*lim_gengroupreskey(const char *);
-static char		*lim_genprojectreskey(const char *);
-static char		*lim_genuserreskey(const char *);
 static void		schderr_args_q(const std::string& , const char *, schd_error *);
 static void 		schderr_args_q_res(const std::string&, const char *, char *, schd_error *);
 static void		schderr_args_server(const char *, schd_error *);
 static void 		schderr_args_server_res(const char *, const char *, schd_error *);
 static sch_resource_t	lim_get(const char *, void *);
+static sch_resource_t	lim_get_ent(void *, enum lim_keytypes, const char *, resdef *);
 static int		lim_setoldlimits(const struct attrl *, void *);
 static int		lim_setreslimits(const struct attrl *, void *);
 static int		lim_setrunlimits(const struct attrl *, void *);
@@ -416,6 +417,31 @@ struct limit_info {
  *		issue.
  */
 static schd_resource	*limres;	/* list of resources that have limits */
+
+/**
+ * @var	lim_entity_ids
+ *
+ * @brief
+ * 		small integer ids for the entity (user, group, project) names
+ *		limits are looked up for.  The ids are only used in lim_cache keys,
+ *		so they are cleared once lim_cache is empty (normally when a
+ *		cycle's universe is freed) and when resource definitions change.
+ */
+static std::unordered_map<std::string, unsigned int> lim_entity_ids;
+
+/**
+ * @var	lim_cache
+ *
+ * @brief
+ * 		limit values already fetched from each limit context, keyed by
+ *		entity id, resource and key type (see lim_get_ent()).  Limits only
+ *		change when the limit attributes are queried at the start of a
+ *		cycle, so lookups after the first one are a hash probe instead of
+ *		building a key string and searching the context's index tree.
+ *		A context's entries are dropped when a limit is added to it and
+ *		when it is freed.
+ */
+static std::unordered_map<void *, std::unordered_map<unsigned long long, sch_resource_t>> lim_cache;
 /**
  * @brief
  * 		We currently store both resource and run limits in a
@@ -523,21 +549,28 @@ lim_free_liminfo(void *p)
 		return;
 
 	if (LI2RESCTX(lip) != NULL) {
+		lim_cache.erase(LI2RESCTX(lip));
 		(void) entlim_free_ctx(LI2RESCTX(lip), free);
 		LI2RESCTX(lip) = NULL;
 	}
 	if (LI2RESCTXSOFT(lip) != NULL) {
+		lim_cache.erase(LI2RESCTXSOFT(lip));
 		(void) entlim_free_ctx(LI2RESCTXSOFT(lip), free);
 		LI2RESCTXSOFT(lip) = NULL;
 	}
 	if (LI2RUNCTX(lip) != NULL) {
+		lim_cache.erase(LI2RUNCTX(lip));
 		(void) entlim_free_ctx(LI2RUNCTX(lip), free);
 		LI2RUNCTX(lip) = NULL;
 	}
 	if (LI2RUNCTXSOFT(lip) != NULL) {
+		lim_cache.erase(LI2RUNCTXSOFT(lip));
 		(void) entlim_free_ctx(LI2RUNCTXSOFT(lip), free);
 		LI2RUNCTXSOFT(lip) = NULL;
 	}
+	/* no cached limit refers to an entity id any more, start them over */
+	if (lim_cache.empty())
+		lim_entity_ids.clear();
 	free(lip);
 }
 /**
@@ -1248,7 +1281,6 @@ static int
 check_server_max_user_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
-	char		*key;
 	char		*user = rr->user;
 	int		used;
 	int		max_user_run, max_genuser_run;
@@ -1262,15 +1294,9 @@ check_server_max_user_run(server_info *si, queue_info *qi, resource_resv *rr,
 
 	cts = sc->user;
 
-	if ((key = entlim_mk_runkey(LIM_USER, user)) == NULL)
-		return (SCHD_ERROR);
-	max_user_run = (int) lim_get(key, LI2RUNCTX(si->liminfo));
-	free(key);
+	max_user_run = (int) lim_get_ent(LI2RUNCTX(si->liminfo), LIM_USER, user, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_USER, genparam)) == NULL)
-		return (SCHD_ERROR);
-	max_genuser_run = (int) lim_get(key, LI2RUNCTX(si->liminfo));
-	free(key);
+	max_genuser_run = (int) lim_get_ent(LI2RUNCTX(si->liminfo), LIM_USER, genparam, NULL);
 
 	if ((max_user_run == SCHD_INFINITY) &&
 		(max_genuser_run == SCHD_INFINITY))
@@ -1318,7 +1344,6 @@ static int
 check_server_max_group_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
-	char		*key;
 	char		*group = rr->group;
 	int		used;
 	int		max_group_run, max_gengroup_run;
@@ -1332,15 +1357,9 @@ check_server_max_group_run(server_info *si, queue_info *qi, resource_resv *rr,
 
 	cts = sc->group;
 
-	if ((key = entlim_mk_runkey(LIM_GROUP, group)) == NULL)
-		return (SCHD_ERROR);
-	max_group_run = (int) lim_get(key, LI2RUNCTX(si->liminfo));
-	free(key);
+	max_group_run = (int) lim_get_ent(LI2RUNCTX(si->liminfo), LIM_GROUP, group, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_GROUP, genparam)) == NULL)
-		return (SCHD_ERROR);
-	max_gengroup_run = (int) lim_get(key, LI2RUNCTX(si->liminfo));
-	free(key);
+	max_gengroup_run = (int) lim_get_ent(LI2RUNCTX(si->liminfo), LIM_GROUP, genparam, NULL);
 
 	if ((max_group_run == SCHD_INFINITY) &&
 		(max_gengroup_run == SCHD_INFINITY))
@@ -1500,7 +1519,6 @@ static int
 check_queue_max_user_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
-	char		*key;
 	char		*user = rr->user;
 	int		used;
 	int		max_user_run, max_genuser_run;
@@ -1514,15 +1532,9 @@ check_queue_max_user_run(server_info *si, queue_info *qi, resource_resv *rr,
 
 	cts = qc->user;
 
-	if ((key = entlim_mk_runkey(LIM_USER, user)) == NULL)
-		return (SCHD_ERROR);
-	max_user_run = (int) lim_get(key, LI2RUNCTX(qi->liminfo));
-	free(key);
+	max_user_run = (int) lim_get_ent(LI2RUNCTX(qi->liminfo), LIM_USER, user, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_USER, genparam)) == NULL)
-		return (SCHD_ERROR);
-	max_genuser_run = (int) lim_get(key, LI2RUNCTX(qi->liminfo));
-	free(key);
+	max_genuser_run = (int) lim_get_ent(LI2RUNCTX(qi->liminfo), LIM_USER, genparam, NULL);
 
 	if ((max_user_run == SCHD_INFINITY) &&
 		(max_genuser_run == SCHD_INFINITY))
@@ -1570,7 +1582,6 @@ static int
 check_queue_max_group_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
-	char		*key;
 	char		*group = rr->group;
 	int		used;
 	int		max_group_run, max_gengroup_run;
@@ -1584,15 +1595,9 @@ check_queue_max_group_run(server_info *si, queue_info *qi, resource_resv *rr,
 
 	cts = qc->group;
 
-	if ((key = entlim_mk_runkey(LIM_GROUP, group)) == NULL)
-		return (SCHD_ERROR);
-	max_group_run = (int) lim_get(key, LI2RUNCTX(qi->liminfo));
-	free(key);
+	max_group_run = (int) lim_get_ent(LI2RUNCTX(qi->liminfo), LIM_GROUP, group, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_GROUP, genparam)) == NULL)
-		return (SCHD_ERROR);
-	max_gengroup_run = (int) lim_get(key, LI2RUNCTX(qi->liminfo));
-	free(key);
+	max_gengroup_run = (int) lim_get_ent(LI2RUNCTX(qi->liminfo), LIM_GROUP, genparam, NULL);
 
 	if ((max_group_run == SCHD_INFINITY) &&
 		(max_gengroup_run == SCHD_INFINITY))
@@ -1754,7 +1759,6 @@ static int
 check_queue_max_res(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
-	char		*reskey;
 	sch_resource_t	max_res;
 	sch_resource_t	used;
 	schd_resource	*res;
@@ -1779,11 +1783,7 @@ check_queue_max_res(server_info *si, queue_info *qi, resource_resv *rr,
 		if ((req = find_resource_req(rr->resreq, res->def)) == NULL)
 			continue;
 
-		if ((reskey = entlim_mk_reskey(LIM_OVERALL, allparam,
-			res->name)) == NULL)
-			return (SCHD_ERROR);
-		max_res = lim_get(reskey, LI2RESCTX(qi->liminfo));
-		free(reskey);
+		max_res = lim_get_ent(LI2RESCTX(qi->liminfo), LIM_OVERALL, allparam, res->def);
 
 		if (max_res == SCHD_INFINITY)
 			continue;
@@ -1828,7 +1828,6 @@ static int
 check_server_max_res(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
-	char		*reskey;
 	sch_resource_t	max_res;
 	sch_resource_t	used;
 	schd_resource	*res;
@@ -1854,11 +1853,7 @@ check_server_max_res(server_info *si, queue_info *qi, resource_resv *rr,
 		if ((req = find_resource_req(rr->resreq, res->def)) == NULL)
 			continue;
 
-		if ((reskey = entlim_mk_reskey(LIM_OVERALL, allparam,
-			res->name)) == NULL)
-			return (SCHD_ERROR);
-		max_res = lim_get(reskey, LI2RESCTX(si->liminfo));
-		free(reskey);
+		max_res = lim_get_ent(LI2RESCTX(si->liminfo), LIM_OVERALL, allparam, res->def);
 
 		if (max_res == SCHD_INFINITY)
 			continue;
@@ -1903,7 +1898,6 @@ check_server_max_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
 	int	max_running;
-	char	*key;
 	counts	*cts = NULL;
 	int	running;
 
@@ -1915,10 +1909,7 @@ check_server_max_run(server_info *si, queue_info *qi, resource_resv *rr,
 
 	cts = sc->all;
 
-	if ((key = entlim_mk_runkey(LIM_OVERALL, allparam)) == NULL)
-		return (SCHD_ERROR);
-	max_running = (int) lim_get(key, LI2RUNCTX(si->liminfo));
-	free(key);
+	max_running = (int) lim_get_ent(LI2RUNCTX(si->liminfo), LIM_OVERALL, allparam, NULL);
 
 
 	running = find_counts_elm(cts, PBS_ALL_ENTITY, NULL, NULL, NULL);
@@ -1957,7 +1948,6 @@ check_queue_max_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
 	int	max_running;
-	char	*key;
 	counts	*cts = NULL;
 	int	running;
 
@@ -1969,11 +1959,7 @@ check_queue_max_run(server_info *si, queue_info *qi, resource_resv *rr,
 
 	cts = qc->all;
 
-	if ((key = entlim_mk_runkey(LIM_OVERALL, allparam)) == NULL)
-		return (SCHD_ERROR);
-
-	max_running = (int) lim_get(key, LI2RUNCTX(qi->liminfo));
-	free(key);
+	max_running = (int) lim_get_ent(LI2RUNCTX(qi->liminfo), LIM_OVERALL, allparam, NULL);
 
 
 	running = find_counts_elm(cts, PBS_ALL_ENTITY, NULL, NULL, NULL);
@@ -2008,7 +1994,6 @@ static int
 check_queue_max_run_soft(server_info *si, queue_info *qi, resource_resv *rr)
 {
 	int	max_running;
-	char	*key;
 	counts	*cnt = NULL;
 	int used = 0;
 
@@ -2019,10 +2004,7 @@ check_queue_max_run_soft(server_info *si, queue_info *qi, resource_resv *rr)
 	if (!qi->has_all_limit)
 	    return (0);
 
-	if ((key = entlim_mk_runkey(LIM_OVERALL, allparam)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_running = (int) lim_get(key, LI2RUNCTXSOFT(qi->liminfo));
-	free(key);
+	max_running = (int) lim_get_ent(LI2RUNCTXSOFT(qi->liminfo), LIM_OVERALL, allparam, NULL);
 
 	/* at this point, we know a limit is set for PBS_ALL*/
 	used = find_counts_elm(qi->alljobcounts, PBS_ALL_ENTITY, NULL, &cnt, NULL);
@@ -2057,7 +2039,6 @@ check_queue_max_run_soft(server_info *si, queue_info *qi, resource_resv *rr)
 static int
 check_queue_max_user_run_soft(server_info *si, queue_info *qi, resource_resv *rr)
 {
-	char		*key;
 	char		*user = rr->user;
 	int		used;
 	int		max_user_run_soft, max_genuser_run_soft;
@@ -2069,15 +2050,9 @@ check_queue_max_user_run_soft(server_info *si, queue_info *qi, resource_resv *rr
 	if (!qi->has_user_limit)
 	    return (0);
 
-	if ((key = entlim_mk_runkey(LIM_USER, user)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_user_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(qi->liminfo));
-	free(key);
+	max_user_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(qi->liminfo), LIM_USER, user, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_USER, genparam)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_genuser_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(qi->liminfo));
-	free(key);
+	max_genuser_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(qi->liminfo), LIM_USER, genparam, NULL);
 
 	if ((max_user_run_soft == SCHD_INFINITY) &&
 		(max_genuser_run_soft == SCHD_INFINITY))
@@ -2131,7 +2106,6 @@ static int
 check_queue_max_group_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
-	char		*key;
 	char		*group = rr->group;
 	int		used;
 	int		max_group_run_soft, max_gengroup_run_soft;
@@ -2143,15 +2117,9 @@ check_queue_max_group_run_soft(server_info *si, queue_info *qi,
 	if (!qi->has_grp_limit)
 	    return (0);
 
-	if ((key = entlim_mk_runkey(LIM_GROUP, group)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_group_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(qi->liminfo));
-	free(key);
+	max_group_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(qi->liminfo), LIM_GROUP, group, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_GROUP, genparam)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_gengroup_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(qi->liminfo));
-	free(key);
+	max_gengroup_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(qi->liminfo), LIM_GROUP, genparam, NULL);
 
 	if ((max_group_run_soft == SCHD_INFINITY) &&
 		(max_gengroup_run_soft == SCHD_INFINITY))
@@ -2263,7 +2231,6 @@ static int
 check_server_max_run_soft(server_info *si, queue_info *qi, resource_resv *rr)
 {
 	int	max_running;
-	char	*key;
 	counts	*cnt = NULL;
 	int used = 0;
 
@@ -2273,10 +2240,7 @@ check_server_max_run_soft(server_info *si, queue_info *qi, resource_resv *rr)
 	if (!si->has_all_limit)
 	    return (0);
 
-	if ((key = entlim_mk_runkey(LIM_OVERALL, allparam)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_running = (int) lim_get(key, LI2RUNCTXSOFT(si->liminfo));
-	free(key);
+	max_running = (int) lim_get_ent(LI2RUNCTXSOFT(si->liminfo), LIM_OVERALL, allparam, NULL);
 
 	/* at this point, we know a limit is set for PBS_ALL*/
 	used = find_counts_elm(si->alljobcounts, PBS_ALL_ENTITY , NULL, &cnt, NULL);
@@ -2311,7 +2275,6 @@ static int
 check_server_max_user_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
-	char		*key;
 	char		*user = rr->user;
 	int		used;
 	int		max_user_run_soft, max_genuser_run_soft;
@@ -2323,15 +2286,9 @@ check_server_max_user_run_soft(server_info *si, queue_info *qi,
 	if (!si->has_user_limit)
 	    return (0);
 
-	if ((key = entlim_mk_runkey(LIM_USER, user)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_user_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(si->liminfo));
-	free(key);
+	max_user_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(si->liminfo), LIM_USER, user, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_USER, genparam)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_genuser_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(si->liminfo));
-	free(key);
+	max_genuser_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(si->liminfo), LIM_USER, genparam, NULL);
 
 	if ((max_user_run_soft == SCHD_INFINITY) &&
 		(max_genuser_run_soft == SCHD_INFINITY))
@@ -2384,7 +2341,6 @@ static int
 check_server_max_group_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
-	char		*key;
 	char		*group = rr->group;
 	int		used;
 	int		max_group_run_soft, max_gengroup_run_soft;
@@ -2396,15 +2352,9 @@ check_server_max_group_run_soft(server_info *si, queue_info *qi,
 	if (!si->has_grp_limit)
 	    return (0);
 
-	if ((key = entlim_mk_runkey(LIM_GROUP, group)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_group_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(si->liminfo));
-	free(key);
+	max_group_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(si->liminfo), LIM_GROUP, group, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_GROUP, genparam)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_gengroup_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(si->liminfo));
-	free(key);
+	max_gengroup_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(si->liminfo), LIM_GROUP, genparam, NULL);
 
 	if ((max_group_run_soft == SCHD_INFINITY) &&
 		(max_gengroup_run_soft == SCHD_INFINITY))
@@ -2516,7 +2466,6 @@ check_server_max_group_res_soft(server_info *si, queue_info *qi,
 static int
 check_server_max_res_soft(server_info *si, queue_info *qi, resource_resv *rr)
 {
-	char		*reskey;
 	sch_resource_t	max_res_soft;
 	sch_resource_t	used;
 	schd_resource	*res;
@@ -2535,11 +2484,7 @@ check_server_max_res_soft(server_info *si, queue_info *qi, resource_resv *rr)
 		if (find_resource_req(rr->resreq, res->def) == NULL)
 			continue;
 
-		if ((reskey = entlim_mk_reskey(LIM_OVERALL, allparam,
-			res->name)) == NULL)
-			return (PREEMPT_TO_BIT(PREEMPT_ERR));
-		max_res_soft = lim_get(reskey, LI2RESCTXSOFT(si->liminfo));
-		free(reskey);
+		max_res_soft = lim_get_ent(LI2RESCTXSOFT(si->liminfo), LIM_OVERALL, allparam, res->def);
 
 		if (max_res_soft == SCHD_INFINITY)
 			continue;
@@ -2585,7 +2530,6 @@ check_server_max_res_soft(server_info *si, queue_info *qi, resource_resv *rr)
 static int
 check_queue_max_res_soft(server_info *si, queue_info *qi, resource_resv *rr)
 {
-	char		*reskey;
 	sch_resource_t	max_res_soft;
 	sch_resource_t	used;
 	schd_resource	*res;
@@ -2604,11 +2548,7 @@ check_queue_max_res_soft(server_info *si, queue_info *qi, resource_resv *rr)
 		if (find_resource_req(rr->resreq, res->def) == NULL)
 			continue;
 
-		if ((reskey = entlim_mk_reskey(LIM_OVERALL, allparam,
-			res->name)) == NULL)
-			return (PREEMPT_TO_BIT(PREEMPT_ERR));
-		max_res_soft = lim_get(reskey, LI2RESCTXSOFT(qi->liminfo));
-		free(reskey);
+		max_res_soft = lim_get_ent(LI2RESCTXSOFT(qi->liminfo), LIM_OVERALL, allparam, res->def);
 
 		if (max_res_soft == SCHD_INFINITY)
 			continue;
@@ -2655,8 +2595,6 @@ check_queue_max_res_soft(server_info *si, queue_info *qi, resource_resv *rr)
 static int
 check_max_group_res(resource_resv *rr, counts *cts_list, resdef **rdef, void *limitctx)
 {
-	char		*groupreskey;
-	char		*gengroupreskey;
 	char		*group;
 	schd_resource	*res;
 	sch_resource_t	max_group_res;
@@ -2676,17 +2614,10 @@ check_max_group_res(resource_resv *rr, counts *cts_list, resdef **rdef, void *li
 			continue;
 
 		/* individual group limit check */
-		if ((groupreskey = entlim_mk_reskey(LIM_GROUP, group,
-			res->name)) == NULL)
-			return (-1);
-		max_group_res = lim_get(groupreskey, limitctx);
-		free(groupreskey);
+		max_group_res = lim_get_ent(limitctx, LIM_GROUP, group, res->def);
 
 		/* generic group limit check */
-		if ((gengroupreskey = lim_gengroupreskey(res->name)) == NULL)
-			return (-1);
-		max_gengroup_res = lim_get(gengroupreskey, limitctx);
-		free(gengroupreskey);
+		max_gengroup_res = lim_get_ent(limitctx, LIM_GROUP, genparam, res->def);
 
 		if ((max_group_res == SCHD_INFINITY) &&
 			(max_gengroup_res == SCHD_INFINITY))
@@ -2733,8 +2664,6 @@ check_max_group_res(resource_resv *rr, counts *cts_list, resdef **rdef, void *li
 static int
 check_max_group_res_soft(resource_resv *rr, counts *cts_list, void *limitctx, int preempt_bit)
 {
-	char		*groupreskey;
-	char		*gengroupreskey;
 	char		*group;
 	schd_resource	*res;
 	sch_resource_t	max_group_res_soft;
@@ -2756,17 +2685,10 @@ check_max_group_res_soft(resource_resv *rr, counts *cts_list, void *limitctx, in
 			continue;
 
 		/* individual group limit check */
-		if ((groupreskey = entlim_mk_reskey(LIM_GROUP, group,
-			res->name)) == NULL)
-			return (-1);
-		max_group_res_soft = lim_get(groupreskey, limitctx);
-		free(groupreskey);
+		max_group_res_soft = lim_get_ent(limitctx, LIM_GROUP, group, res->def);
 
 		/* generic group limit check */
-		if ((gengroupreskey = lim_gengroupreskey(res->name)) == NULL)
-			return (-1);
-		max_gengroup_res_soft = lim_get(gengroupreskey, limitctx);
-		free(gengroupreskey);
+		max_gengroup_res_soft = lim_get_ent(limitctx, LIM_GROUP, genparam, res->def);
 
 		if ((max_group_res_soft == SCHD_INFINITY) &&
 			(max_gengroup_res_soft == SCHD_INFINITY))
@@ -2823,8 +2745,6 @@ static int
 check_max_user_res(resource_resv *rr, counts *cts_list, resdef **rdef,
 	void *limitctx)
 {
-	char		*userreskey;
-	char		*genuserreskey;
 	char		*user;
 	schd_resource	*res;
 	sch_resource_t	max_user_res;
@@ -2845,17 +2765,10 @@ check_max_user_res(resource_resv *rr, counts *cts_list, resdef **rdef,
 			continue;
 
 		/* individual user limit check */
-		if ((userreskey = entlim_mk_reskey(LIM_USER, user,
-			res->name)) == NULL)
-			return (-1);
-		max_user_res = lim_get(userreskey, limitctx);
-		free(userreskey);
+		max_user_res = lim_get_ent(limitctx, LIM_USER, user, res->def);
 
 		/* generic user limit check */
-		if ((genuserreskey = lim_genuserreskey(res->name)) == NULL)
-			return (-1);
-		max_genuser_res = lim_get(genuserreskey, limitctx);
-		free(genuserreskey);
+		max_genuser_res = lim_get_ent(limitctx, LIM_USER, genparam, res->def);
 
 		if ((max_user_res == SCHD_INFINITY) &&
 			(max_genuser_res == SCHD_INFINITY))
@@ -2904,8 +2817,6 @@ static int
 check_max_user_res_soft(resource_resv **rr_arr, resource_resv *rr,
 	counts *cts_list, void *limitctx, int preempt_bit)
 {
-	char		*userreskey;
-	char		*genuserreskey;
 	char		*user;
 	schd_resource	*res;
 	sch_resource_t	max_user_res_soft;
@@ -2927,17 +2838,10 @@ check_max_user_res_soft(resource_resv **rr_arr, resource_resv *rr,
 			continue;
 
 		/* individual user limit check */
-		if ((userreskey = entlim_mk_reskey(LIM_USER, user,
-			res->name)) == NULL)
-			return (-1);
-		max_user_res_soft = lim_get(userreskey, limitctx);
-		free(userreskey);
+		max_user_res_soft = lim_get_ent(limitctx, LIM_USER, user, res->def);
 
 		/* generic user limit check */
-		if ((genuserreskey = lim_genuserreskey(res->name)) == NULL)
-			return (-1);
-		max_genuser_res_soft = lim_get(genuserreskey, limitctx);
-		free(genuserreskey);
+		max_genuser_res_soft = lim_get_ent(limitctx, LIM_USER, genparam, res->def);
 
 		if ((max_user_res_soft == SCHD_INFINITY) &&
 			(max_genuser_res_soft == SCHD_INFINITY))
@@ -3013,7 +2917,8 @@ lim_setreslimits(const struct attrl *a, void *ctx)
 /**
  * @brief
  * 		free and clear saved limit resources.  Must be called whenever
- *		resource definitions are updated.
+ *		resource definitions are updated.  The cached limit values are
+ *		dropped too, since they are keyed by resource index.
  *
  * @return void
  */
@@ -3022,6 +2927,8 @@ clear_limres(void)
 {
 	free_resource_list(limres);
 	limres = NULL;
+	lim_cache.clear();
+	lim_entity_ids.clear();
 }
 
 /**
@@ -3216,6 +3123,14 @@ lim_dup_ctx(void *ctx)
 			return NULL;
 		}
 	}
+
+	/* the duplicate holds the same limits, so it can start with the same cached values */
+	auto c = lim_cache.find(ctx);
+	if (c != lim_cache.end()) {
+		auto cached = c->second;
+		lim_cache[newctx] = std::move(cached);
+	}
+
 	return newctx;
 }
 
@@ -3239,54 +3154,6 @@ is_hardlimit(const struct attrl *a)
 		return (0);
 }
 
-/**
- * @brief
- *		lim_gengroupreskey	special-purpose shortcut function to construct a
- *				generic group resource key
- *
- * @param[in]	res	-	the resource
- *
- * @return	a resource limit key if successful
- * @retval	NULL	: if not
- */
-static char *
-lim_gengroupreskey(const char *res)
-{
-	return (entlim_mk_reskey(LIM_GROUP, genparam, res));
-}
-
-/**
- * @brief
- *		lim_genprojectreskey	special-purpose shortcut function to construct a
- *				generic project resource key
- *
- * @param[in]	res	-	the resource
- *
- * @return	a resource limit key if successful
- * @retval	NULL	: if not
- */
-static char *
-lim_genprojectreskey(const char *res)
-{
-	return (entlim_mk_reskey(LIM_PROJECT, genparam, res));
-}
-
-/**
- * @brief
- *		lim_genuserreskey	special-purpose shortcut function to construct a
- *				generic user resource key
- *
- * @param[in]	res	-	the resource
- *
- * @return	a resource limit key on success
- * @retval	NULL	: on failure
- */
-static char *
-lim_genuserreskey(const char *res)
-{
-	return (entlim_mk_reskey(LIM_USER, genparam, res));
-}
-
 /**
  * @brief
  *		lim_callback install a new key of the given type and value
@@ -3326,6 +3193,7 @@ lim_callback(void *ctx, enum lim_keytypes kt, char *param, char *namestring,
 		return (-1);
 	}
 
+	lim_cache.erase(ctx);
 	if (entlim_add(key, v, ctx) != 0) {
 		log_eventf(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__,
 			"limit set %s %s %s failed", key, res, val);
@@ -3371,6 +3239,76 @@ lim_get(const char *param, void *ctx)
 	}
 }
 
+/**
+ * @brief
+ *		lim_entity_id	intern an entity name
+ *
+ * @param[in]	entity	-	the entity name
+ *
+ * @return	unsigned int
+ * @retval	the entity's id
+ */
+static unsigned int
+lim_entity_id(const char *entity)
+{
+	auto it = lim_entity_ids.find(entity);
+
+	if (it != lim_entity_ids.end())
+		return it->second;
+
+	unsigned int id = lim_entity_ids.size();
+	lim_entity_ids[entity] = id;
+
+	return id;
+}
+
+/**
+ * @brief
+ *		lim_get_ent	fetch an entity's run or resource limit
+ *
+ * @param[in]	ctx	-	the limit storage context
+ * @param[in]	kt	-	the key type (user, group, project, overall)
+ * @param[in]	entity	-	the entity name (or the generic/all names)
+ * @param[in]	def	-	the resource for a resource limit, NULL for a run limit
+ *
+ * @return	sch_resource_t
+ * @retval	the value of the limit
+ * @retval	SCHD_INFINITY if no such limit exists in the named context
+ */
+static sch_resource_t
+lim_get_ent(void *ctx, enum lim_keytypes kt, const char *entity, resdef *def)
+{
+	unsigned long long id;
+	sch_resource_t v;
+	char *key;
+
+	if (ctx == NULL || entity == NULL)
+		return (SCHD_INFINITY);
+
+	id = ((unsigned long long) lim_entity_id(entity) << 32) |
+		((unsigned long long) (def == NULL ? 0 : def->idx + 1) << 2) | kt;
+
+	auto& ctx_cache = lim_cache[ctx];
+	auto it = ctx_cache.find(id);
+	if (it != ctx_cache.end())
+		return it->second;
+
+	if (def == NULL)
+		key = entlim_mk_runkey(kt, entity);
+	else
+		key = entlim_mk_reskey(kt, entity, def->name.c_str());
+	if (key == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return (SCHD_INFINITY);
+	}
+	v = lim_get(key, ctx);
+	free(key);
+
+	ctx_cache[id] = v;
+
+	return (v);
+}
+
 /**
  * @brief
  *		schderr_args_q	log a queue-related run limit exceeded message
@@ -3459,8 +3397,6 @@ static int
 check_max_project_res(resource_resv *rr, counts *cts_list,
 	resdef **rdef, void *limitctx)
 {
-	char		*projectreskey;
-	char		*genprojectreskey;
 	schd_resource	*res;
 	char		*project;
 	sch_resource_t	max_project_res;
@@ -3479,17 +3415,10 @@ check_max_project_res(resource_resv *rr, counts *cts_list,
 			continue;
 
 		/* individual project limit check */
-		if ((projectreskey = entlim_mk_reskey(LIM_PROJECT,
-			project, res->name)) == NULL)
-			return (-1);
-		max_project_res = lim_get(projectreskey, limitctx);
-		free(projectreskey);
+		max_project_res = lim_get_ent(limitctx, LIM_PROJECT, project, res->def);
 
 		/* generic project limit check */
-		if ((genprojectreskey = lim_genprojectreskey(res->name)) == NULL)
-			return (-1);
-		max_genproject_res = lim_get(genprojectreskey, limitctx);
-		free(genprojectreskey);
+		max_genproject_res = lim_get_ent(limitctx, LIM_PROJECT, genparam, res->def);
 
 		if ((max_project_res == SCHD_INFINITY) &&
 			(max_genproject_res == SCHD_INFINITY))
@@ -3536,8 +3465,6 @@ check_max_project_res(resource_resv *rr, counts *cts_list,
 static int
 check_max_project_res_soft(resource_resv *rr, counts *cts_list, void *limitctx, int preempt_bit)
 {
-	char		*projectreskey;
-	char		*genprojectreskey;
 	char		*project;
 	schd_resource	*res;
 	sch_resource_t	max_project_res_soft;
@@ -3558,17 +3485,10 @@ check_max_project_res_soft(resource_resv *rr, counts *cts_list, void *limitctx,
 			continue;
 
 		/* individual project limit check */
-		if ((projectreskey = entlim_mk_reskey(LIM_PROJECT, project,
-			res->name)) == NULL)
-			return (-1);
-		max_project_res_soft = lim_get(projectreskey, limitctx);
-		free(projectreskey);
+		max_project_res_soft = lim_get_ent(limitctx, LIM_PROJECT, project, res->def);
 
 		/* generic project limit check */
-		if ((genprojectreskey = lim_genprojectreskey(res->name)) == NULL)
-			return (-1);
-		max_genproject_res_soft = lim_get(genprojectreskey, limitctx);
-		free(genprojectreskey);
+		max_genproject_res_soft = lim_get_ent(limitctx, LIM_PROJECT, genparam, res->def);
 
 		if ((max_project_res_soft == SCHD_INFINITY) &&
 			(max_genproject_res_soft == SCHD_INFINITY))
@@ -3687,7 +3607,6 @@ static int
 check_server_max_project_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
-	char		*key;
 	char		*project;
 	int		used;
 	int		max_project_run_soft, max_genproject_run_soft;
@@ -3703,15 +3622,9 @@ check_server_max_project_run_soft(server_info *si, queue_info *qi,
 	    return (0);
 
 	project = rr->project;
-	if ((key = entlim_mk_runkey(LIM_PROJECT, project)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_project_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(si->liminfo));
-	free(key);
+	max_project_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(si->liminfo), LIM_PROJECT, project, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_PROJECT, genparam)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_genproject_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(si->liminfo));
-	free(key);
+	max_genproject_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(si->liminfo), LIM_PROJECT, genparam, NULL);
 
 	if ((max_project_run_soft == SCHD_INFINITY) &&
 		(max_genproject_run_soft == SCHD_INFINITY))
@@ -3854,7 +3767,6 @@ static int
 check_queue_max_project_run_soft(server_info *si, queue_info *qi,
 	resource_resv *rr)
 {
-	char		*key;
 	char		*project;
 	int		used;
 	int		max_project_run_soft, max_genproject_run_soft;
@@ -3870,15 +3782,9 @@ check_queue_max_project_run_soft(server_info *si, queue_info *qi,
 	    return (0);
 
 	project = rr->project;
-	if ((key = entlim_mk_runkey(LIM_PROJECT, project)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_project_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(qi->liminfo));
-	free(key);
+	max_project_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(qi->liminfo), LIM_PROJECT, project, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_PROJECT, genparam)) == NULL)
-		return (PREEMPT_TO_BIT(PREEMPT_ERR));
-	max_genproject_run_soft = (int) lim_get(key, LI2RUNCTXSOFT(qi->liminfo));
-	free(key);
+	max_genproject_run_soft = (int) lim_get_ent(LI2RUNCTXSOFT(qi->liminfo), LIM_PROJECT, genparam, NULL);
 
 	if ((max_project_run_soft == SCHD_INFINITY) &&
 		(max_genproject_run_soft == SCHD_INFINITY))
@@ -3967,7 +3873,6 @@ static int
 check_server_max_project_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
-	char		*key;
 	char		*project;
 	int		used;
 	int		max_project_run, max_genproject_run;
@@ -3985,15 +3890,9 @@ check_server_max_project_run(server_info *si, queue_info *qi, resource_resv *rr,
 	    return (0);
 
 	project = rr->project;
-	if ((key = entlim_mk_runkey(LIM_PROJECT, project)) == NULL)
-		return (SCHD_ERROR);
-	max_project_run = (int) lim_get(key, LI2RUNCTX(si->liminfo));
-	free(key);
+	max_project_run = (int) lim_get_ent(LI2RUNCTX(si->liminfo), LIM_PROJECT, project, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_PROJECT, genparam)) == NULL)
-		return (SCHD_ERROR);
-	max_genproject_run = (int) lim_get(key, LI2RUNCTX(si->liminfo));
-	free(key);
+	max_genproject_run = (int) lim_get_ent(LI2RUNCTX(si->liminfo), LIM_PROJECT, genparam, NULL);
 
 	if ((max_project_run == SCHD_INFINITY) &&
 		(max_genproject_run == SCHD_INFINITY))
@@ -4044,7 +3943,6 @@ static int
 check_queue_max_project_run(server_info *si, queue_info *qi, resource_resv *rr,
 	limcounts *sc, limcounts *qc, schd_error *err)
 {
-	char		*key;
 	char		*project;
 	int		used;
 	int		max_project_run, max_genproject_run;
@@ -4062,15 +3960,9 @@ check_queue_max_project_run(server_info *si, queue_info *qi, resource_resv *rr,
 	if (!qi->has_proj_limit)
 	    return (0);
 
-	if ((key = entlim_mk_runkey(LIM_PROJECT, project)) == NULL)
-		return (SCHD_ERROR);
-	max_project_run = (int) lim_get(key, LI2RUNCTX(qi->liminfo));
-	free(key);
+	max_project_run = (int) lim_get_ent(LI2RUNCTX(qi->liminfo), LIM_PROJECT, project, NULL);
 
-	if ((key = entlim_mk_runkey(LIM_PROJECT, genparam)) == NULL)
-		return (SCHD_ERROR);
-	max_genproject_run = (int) lim_get(key, LI2RUNCTX(qi->liminfo));
-	free(key);
+	max_genproject_run = (int) lim_get_ent(LI2RUNCTX(qi->liminfo), LIM_PROJECT, genparam, NULL);
 
 	if ((max_project_run == SCHD_INFINITY) &&
 		(max_genproject_run == SCHD_INFINITY))
@@ -1291,7 +1291,7 @@ char *
 res_to_str_c(sch_resource_t amount, resdef *def, enum resource_fields fld,
 	char *buf, int bufsize)
 {
-	schd_resource res = {0};
+	schd_resource res{};
 	resource_req req = {0};
 	const char *unknown[] = {"unknown", NULL};
 
@@ -1550,4 +1550,56 @@ free_ptr_array(void *inp)
 	for (i = 0; arr[i] != NULL; i++)
 		free(arr[i]);
 	free(arr);
-}
\ No newline at end of file
+}
+/**
+ * @brief	fold a string into a 64 bit FNV-1a digest
+ *
+ * @param[in]	h - digest so far
+ * @param[in]	str - string to fold in (NULL is treated as "")
+ *
+ * @return	unsigned long long - new digest
+ */
+unsigned long long
+digest_str(unsigned long long h, const char *str)
+{
+	if (str != NULL) {
+		for (; *str != '\0'; str++) {
+			h ^= (unsigned char) *str;
+			h *= 1099511628211ULL;
+		}
+	}
+	/* separate fields so "ab","c" and "a","bc" differ */
+	h ^= 0xff;
+	h *= 1099511628211ULL;
+
+	return h;
+}
+
+/**
+ * @brief	compute a digest of a batch_status' name and attributes.
+ *		Two batch_status with the same digest are considered identical.
+ *
+ * @param[in]	bs - batch_status to digest (only this one, not bs->next)
+ * @param[in]	ctx - extra context to fold into the digest (e.g., queue name)
+ *
+ * @return	unsigned long long - the digest
+ */
+unsigned long long
+batch_status_digest(struct batch_status *bs, const std::string& ctx)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	struct attrl *attrp;
+
+	if (bs == NULL)
+		return 0;
+
+	h = digest_str(h, ctx.c_str());
+	h = digest_str(h, bs->name);
+	for (attrp = bs->attribs; attrp != NULL; attrp = attrp->next) {
+		h = digest_str(h, attrp->name);
+		h = digest_str(h, attrp->resource);
+		h = digest_str(h, attrp->value);
+	}
+
+	return h;
+}
@@ -270,6 +270,16 @@ add_str_to_unique_array(char ***str_arr, char *str);
  */
 void free_ptr_array (void *inp);
 
+/*
+ * fold a string into a 64 bit FNV-1a digest
+ */
+unsigned long long digest_str(unsigned long long h, const char *str);
+
+/*
+ * compute a digest of a batch_status' attributes
+ */
+unsigned long long batch_status_digest(struct batch_status *bs, const std::string& ctx);
+
 void log_eventf(int eventtype, int objclass, int sev, const std::string& objname, const char *fmt, ...);
 void log_event(int eventtype, int objclass, int sev, const std::string& objname, const char *text);
 
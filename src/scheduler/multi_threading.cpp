@@ -58,6 +58,7 @@
 #include "queue.h"
 #include "fifo.h"
 #include "resource_resv.h"
+#include "buckets.h"
 #include "multi_threading.h"
 
 /**
@@ -294,6 +295,11 @@ worker(void *tid)
 				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
 				free_resource_resv_array_chunk(static_cast<th_data_free_resresv *>(work->thread_data));
 				break;
+			case TS_MAP_BUCKETS:
+				snprintf(buf, sizeof(buf), "Thread %d calling map_buckets_chunk()", ntid);
+				log_event(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, buf);
+				map_buckets_chunk(static_cast<th_data_map_buckets *>(work->thread_data));
+				break;
 			default:
 				log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_SCHED, LOG_ERR, __func__,
 						"Invalid task type passed to worker thread");
@@ -102,6 +102,10 @@
  * 	sim_exclhost_func()
  * 	set_current_aoe()
  * 	is_exclhost()
+ * 	new_node_table()
+ * 	free_node_table()
+ * 	update_node_table_row()
+ * 	node_table_is_eligible()
  * 	check_node_array_eligibility()
  * 	is_powerok()
  * 	is_eoe_avail_on_vnode()
@@ -148,6 +152,7 @@
 #include "pbs_bitmap.h"
 #include "pbs_license.h"
 #include "multi_threading.h"
+#include "arena.h"
 #ifdef NAS
 #include "site_code.h"
 #endif
@@ -616,6 +621,9 @@ query_node_info(struct batch_status *node, server_info *sinfo)
 	if (ninfo->lic_lock != 1)
 		ninfo->nscr |= NSCR_CYCLE_INELIGIBLE;
 
+	/* node resources are looked up in the innermost node matching loops */
+	index_resource_list(ninfo->res);
+
 	return ninfo;
 }
 
@@ -890,6 +898,7 @@ set_node_info_state(node_info *ninfo, const char *state)
 
 			tok = strtok_r(NULL, ",", &saveptr);
 		}
+		update_node_table_row(NULL, ninfo);
 		return 0;
 	}
 
@@ -969,6 +978,8 @@ remove_node_state(node_info *ninfo, const char *state)
 	else
 		ninfo->nscr |= NSCR_CYCLE_INELIGIBLE;
 
+	update_node_table_row(NULL, ninfo);
+
 	return 0;
 }
 
@@ -1042,6 +1053,8 @@ add_node_state(node_info *ninfo, const char *state)
 	} else
 		ninfo->nscr &= ~NSCR_CYCLE_INELIGIBLE;
 
+	update_node_table_row(NULL, ninfo);
+
 	return 0;
 }
 
@@ -1443,6 +1456,7 @@ dup_node_info(node_info *onode, server_info *nsinfo, unsigned int flags)
 		nnode->res = dup_ind_resource_list(onode->res);
 	else
 		nnode->res = dup_resource_list(onode->res);
+	index_resource_list(nnode->res);
 
 	nnode->max_running = onode->max_running;
 	nnode->max_user_run = onode->max_user_run;
@@ -1741,6 +1755,7 @@ update_node_on_run(nspec *ns, resource_resv *resresv, const char *job_state)
 
 	if (resresv->is_job) {
 		ninfo->num_jobs++;
+		update_node_table_row(NULL, ninfo);
 		if (find_resource_resv_by_indrank(ninfo->job_arr, resresv->resresv_ind, resresv->rank) == NULL) {
 			tmp_arr = add_resresv_to_array(ninfo->job_arr, resresv, NO_FLAGS);
 			if (tmp_arr == NULL)
@@ -1752,6 +1767,7 @@ update_node_on_run(nspec *ns, resource_resv *resresv, const char *job_state)
 	}
 	else if (resresv->is_resv) {
 		ninfo->num_run_resv++;
+		update_node_table_row(NULL, ninfo);
 		if (find_resource_resv_by_indrank(ninfo->run_resvs_arr, resresv->resresv_ind, resresv->rank) == NULL) {
 			tmp_arr = add_resresv_to_array(ninfo->run_resvs_arr, resresv, NO_FLAGS);
 			if (tmp_arr == NULL)
@@ -1896,6 +1912,7 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, const char *job_sta
 		ninfo->num_jobs--;
 		if (ninfo->num_jobs < 0)
 			ninfo->num_jobs = 0;
+		update_node_table_row(NULL, ninfo);
 
 		remove_resresv_from_array(ninfo->job_arr, resresv);
 	}
@@ -1903,6 +1920,7 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, const char *job_sta
 		ninfo->num_run_resv--;
 		if (ninfo->num_run_resv < 0)
 			ninfo->num_run_resv = 0;
+		update_node_table_row(NULL, ninfo);
 
 		remove_resresv_from_array(ninfo->run_resvs_arr, resresv);
 	}
@@ -1992,10 +2010,8 @@ new_nspec()
 {
 	nspec *ns;
 
-	if ((ns = static_cast<nspec *>(malloc(sizeof(nspec)))) == NULL) {
-		log_err(errno, __func__, MEM_ERR_MSG);
+	if ((ns = static_cast<nspec *>(arena_alloc(sizeof(nspec)))) == NULL)
 		return NULL;
-	}
 
 	ns->end_of_chunk = 0;
 	ns->seq_num = 0;
@@ -2026,7 +2042,7 @@ free_nspec(nspec *ns)
 	if (ns->resreq != NULL)
 		free_resource_req_list(ns->resreq);
 
-	free(ns);
+	arena_free(ns);
 }
 
 /**
@@ -2314,7 +2330,12 @@ eval_selspec(status *policy, selspec *spec, place *placespec,
 		return rc;
 	}
 
-	/* Otherwise we're node grouping... */
+	/* Otherwise we're node grouping...
+	 * Unlike the node bucket path (map_buckets_psets_mt()), the placement
+	 * sets are searched serially here.  eval_placement() marks nodes in
+	 * their scratch flags (nscr) as it goes, and a node can be in more than
+	 * one placement set, so two sets can't be searched at the same time.
+	 */
 
 	for (i = 0; nodepart[i] != NULL && rc == 0; i++) {
 		clear_schd_error(err);
@@ -2923,7 +2944,7 @@ eval_complex_selspec(status *policy, selspec *spec, node_info **ninfo_arr, place
 				 */
 				if (conf.provision_policy != AVOID_PROVISION &&
 					!cstat.node_sort->empty() && conf.node_sort_unused)
-					qsort(nodes, tot_nodes, sizeof(node_info *), multi_node_sort);
+					resort_nodes(nodes, tot_nodes);
 			}
 			chunks_needed--;
 		}
@@ -5406,6 +5427,153 @@ is_exclhost(place *placespec, enum vnode_sharing sharing)
 	return 0;
 }
 
+/**
+ * @brief
+ * 		create a node_table from a server's nodes
+ *
+ * @param[in]	unordered_nodes	-	nodes ordered by node_ind
+ *
+ * @return	node_table *
+ * @retval	NULL	: on error
+ */
+node_table *
+new_node_table(node_info **unordered_nodes)
+{
+	node_table *nt;
+	int num_nodes;
+
+	if (unordered_nodes == NULL)
+		return NULL;
+
+	num_nodes = count_array(unordered_nodes);
+
+	if ((nt = new node_table()) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	nt->node.assign(num_nodes, NULL);
+	nt->flags.assign(num_nodes, 0);
+	nt->sharing.assign(num_nodes, 0);
+	nt->num_jobs.assign(num_nodes, 0);
+	nt->num_run_resv.assign(num_nodes, 0);
+	nt->max_running.assign(num_nodes, 0);
+
+	for (int i = 0; i < num_nodes; i++) {
+		if (unordered_nodes[i]->node_ind != i)
+			continue;
+		nt->node[i] = unordered_nodes[i];
+		update_node_table_row(nt, unordered_nodes[i]);
+	}
+
+	return nt;
+}
+
+/**
+ * @brief
+ * 		free a node_table
+ *
+ * @param[in]	nt	-	node_table to free
+ *
+ * @return	void
+ */
+void
+free_node_table(node_table *nt)
+{
+	delete nt;
+}
+
+/**
+ * @brief
+ * 		copy a node's fields into its row of a node_table.  This needs to
+ *		be called whenever one of the fields in the table changes.
+ *
+ * @param[in]	nt	-	the node table (node->server->ntable if NULL)
+ * @param[in]	node	-	the node
+ *
+ * @return	void
+ */
+void
+update_node_table_row(node_table *nt, node_info *node)
+{
+	int ind;
+	unsigned char flags = 0;
+
+	if (node == NULL)
+		return;
+	if (nt == NULL) {
+		if (node->server == NULL || node->server->ntable == NULL)
+			return;
+		nt = node->server->ntable;
+	}
+
+	ind = node->node_ind;
+	if (ind < 0 || static_cast<std::size_t>(ind) >= nt->node.size() || nt->node[ind] != node)
+		return;
+
+	if (node->is_free)
+		flags |= NT_FREE;
+	if (node->resv_enable)
+		flags |= NT_RESV_ENABLE;
+	if (node->no_multinode_jobs)
+		flags |= NT_NO_MULTINODE;
+	if (node->max_user_run != SCHD_INFINITY || node->max_group_run != SCHD_INFINITY)
+		flags |= NT_USER_GROUP_LIMIT;
+
+	nt->flags[ind] = flags;
+	nt->sharing[ind] = node->sharing;
+	nt->num_jobs[ind] = node->num_jobs;
+	nt->num_run_resv[ind] = node->num_run_resv;
+	nt->max_running[ind] = node->max_running;
+}
+
+/**
+ * @brief
+ * 		the checks of is_vnode_eligible() which can be done from a
+ *		node_table.  A node which passes is eligible.  A node which does
+ *		not pass either is not or needs checks the table can't do, so
+ *		is_vnode_eligible() needs to be called for it.
+ *
+ * @param[in]	nt	-	the node table
+ * @param[in]	node	-	the node to check
+ * @param[in]	resresv	-	resource resv which is requesting
+ * @param[in]	pl	-	place spec for request
+ *
+ * @retval	1	: node is eligible
+ * @retval	0	: call is_vnode_eligible()
+ */
+static inline int
+node_table_is_eligible(node_table *nt, node_info *node, resource_resv *resresv, place *pl)
+{
+	int ind = node->node_ind;
+	unsigned char flags;
+
+	if (ind < 0 || static_cast<std::size_t>(ind) >= nt->node.size() || nt->node[ind] != node)
+		return 0;
+
+	flags = nt->flags[ind];
+	if (!(flags & NT_FREE))
+		return 0;
+
+	if ((nt->num_jobs[ind] > 0 || nt->num_run_resv[ind] > 0) &&
+	    is_excl(pl, static_cast<enum vnode_sharing>(nt->sharing[ind])))
+		return 0;
+
+	if (resresv->is_resv && !(flags & NT_RESV_ENABLE))
+		return 0;
+
+	if (resresv->is_job && resresv->server->qrun_job == NULL) {
+		if (flags & NT_USER_GROUP_LIMIT)
+			return 0;
+		if (nt->max_running[ind] != SCHD_INFINITY && nt->max_running[ind] <= nt->num_jobs[ind])
+			return 0;
+	}
+
+	if ((flags & NT_NO_MULTINODE) && resresv->will_use_multinode)
+		return 0;
+
+	return 1;
+}
+
 /**
  * @brief	pthread routing to check eligibility for a chunk of nodes
  *
@@ -5423,6 +5591,7 @@ check_node_eligibility_chunk(th_data_nd_eligible *data)
 	resource_resv *resresv;
 	place *pl;
 	node_info **ninfo_arr;
+	node_table *nt = NULL;
 
 	if (data == NULL)
 		return;
@@ -5444,11 +5613,17 @@ check_node_eligibility_chunk(th_data_nd_eligible *data)
 	pl = data->pl;
 	ninfo_arr = data->ninfo_arr;
 
+	/* the table has no EOE or reservation node state */
+	if (resresv->eoename == NULL && (resresv->job == NULL || resresv->job->resv == NULL))
+		nt = resresv->server->ntable;
+
 	for (i = start; i <= end && ninfo_arr[i] != NULL; i++) {
 		node_info *node;
 
 		node = ninfo_arr[i];
 		if (!node->nscr) {
+			if (nt != NULL && node_table_is_eligible(nt, node, resresv, pl))
+				continue;
 			if (is_vnode_eligible(node, resresv, pl, err) == 0) {
 				node->nscr |= NSCR_INELIGIBLE;
 				if (node->hostset != NULL) {
@@ -160,6 +160,15 @@ int node_queue_cmp(node_info *ninfo, void *arg);
  */
 void update_node_on_end(node_info *ninfo, resource_resv *resresv, const char *job_state);
 
+/* create a node_table from a server's nodes */
+node_table *new_node_table(node_info **unordered_nodes);
+
+/* free a node_table */
+void free_node_table(node_table *nt);
+
+/* copy a node's fields into its row of a node_table */
+void update_node_table_row(node_table *nt, node_info *node);
+
 /*
  *      copy_node_ptr_array - copy an array of jobs using a different set of
  *                            of job pointer (same jobs, different array).
@@ -52,6 +52,8 @@
  * 	dup_node_partition()
  * 	find_node_partition()
  * 	find_node_partition_by_rank()
+ * 	np_layout_new_cycle()
+ * 	np_layout_node_parts()
  * 	create_node_partitions()
  * 	node_partition_update_array()
  * 	node_partition_update()
@@ -92,7 +94,11 @@
 #include "globals.h"
 #include "sort.h"
 #include "buckets.h"
+#include "profile.h"
 
+#include <algorithm>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 /**
@@ -261,6 +267,7 @@ dup_node_partition(node_partition *onp, server_info *nsinfo)
 	nnp->tot_nodes = onp->tot_nodes;
 	nnp->free_nodes = onp->free_nodes;
 	nnp->res = dup_resource_list(onp->res);
+	index_resource_list(nnp->res);
 	nnp->ninfo_arr = copy_node_ptr_array(onp->ninfo_arr, nsinfo->nodes);
 
 	nnp->bkts = dup_node_bucket_array(onp->bkts, nsinfo);
@@ -354,18 +361,178 @@ find_node_partition_by_rank(node_partition **np_arr, int rank)
 	return np_arr[i];
 }
 
+/* A node partition layout remembers which placement sets each node
+ * belongs to for a set of node grouping resources.  It survives across
+ * cycles: a node is only regrouped when its grouping resource values
+ * change, so unchanged topology costs one comparison per node.
+ */
+struct np_layout_part {
+	std::string name;		/* res_name=res_val */
+	int res_i;			/* index of the resource in resnames */
+	std::string res_val;
+};
+
+struct np_layout_node {
+	std::vector<std::vector<std::string>> vals;	/* grouping values per resource */
+	std::vector<int> parts;		/* indices into np_layout::parts */
+	unsigned long gen;		/* last cycle the node was seen */
+};
+
+struct np_layout {
+	std::vector<np_layout_part> parts;
+	std::unordered_map<std::string, int> part_ind;
+	std::unordered_map<std::string, np_layout_node> nodes;
+};
+
+/* layouts keyed by grouping resource names and NP_CREATE_REST */
+static std::unordered_map<std::string, np_layout> np_layouts;
+static unsigned long np_layout_gen = 0;
+
+/**
+ * @brief
+ *		start a new cycle for the node partition layouts.  Nodes which
+ *		were not seen last cycle and partitions no node belongs to any
+ *		more are dropped.
+ *
+ * @return void
+ */
+void
+np_layout_new_cycle(void)
+{
+	for (auto &l : np_layouts) {
+		auto &layout = l.second;
+		std::vector<int> remap(layout.parts.size(), -1);
+		std::vector<np_layout_part> parts;
+
+		for (auto it = layout.nodes.begin(); it != layout.nodes.end();) {
+			if (it->second.gen != np_layout_gen)
+				it = layout.nodes.erase(it);
+			else
+				++it;
+		}
+		for (auto &n : layout.nodes)
+			for (auto &p : n.second.parts)
+				remap[p] = 0;
+		for (std::size_t i = 0; i < remap.size(); i++)
+			if (remap[i] == 0) {
+				remap[i] = parts.size();
+				parts.push_back(std::move(layout.parts[i]));
+			}
+		if (parts.size() == layout.parts.size())
+			continue;
+
+		layout.parts = std::move(parts);
+		layout.part_ind.clear();
+		for (std::size_t i = 0; i < layout.parts.size(); i++)
+			layout.part_ind[layout.parts[i].name] = i;
+		for (auto &n : layout.nodes)
+			for (auto &p : n.second.parts)
+				p = remap[p];
+	}
+	np_layout_gen++;
+}
+
+/**
+ * @brief
+ *		find the placement sets a node belongs to.  The node's grouping
+ *		resource values are compared with what was last seen, and only
+ *		if they have changed is the node regrouped.
+ *
+ * @param[in,out]	layout	-	the layout to use
+ * @param[in]	node	-	the node
+ * @param[in]	resnames	-	node grouping resource names
+ * @param[in]	defs	-	resource definitions of resnames
+ * @param[in]	flags	-	NP_CREATE_REST - group nodes w/o the resource as ""
+ *
+ * @return	the indices of the node's partitions in the layout
+ * @retval	NULL	: a node w/o the resource can't be grouped as ""
+ */
+static const std::vector<int> *
+np_layout_node_parts(np_layout &layout, node_info *node, const char * const *resnames,
+	const std::vector<resdef *> &defs, unsigned int flags)
+{
+	auto &lnode = layout.nodes[node->name];
+	bool changed = false;
+
+	lnode.gen = np_layout_gen;
+	if (lnode.vals.size() != defs.size()) {
+		lnode.vals.assign(defs.size(), std::vector<std::string>());
+		changed = true;
+	}
+
+	for (std::size_t res_i = 0; res_i < defs.size(); res_i++) {
+		auto &vals = lnode.vals[res_i];
+		std::size_t val_i = 0;
+		schd_resource *res;
+
+		res = find_resource(node->res, defs[res_i]);
+		if (res != NULL && res->indirect_res != NULL)
+			res = res->indirect_res;
+
+		if (res == NULL) {
+			/* same value as set_resource() gives for "\"\"" */
+			if (flags & NP_CREATE_REST) {
+				if (defs[res_i] == NULL || !defs[res_i]->type.is_string) {
+					log_event(PBSEVENT_ERROR, PBS_EVENTCLASS_RESC, LOG_WARNING, resnames[res_i],
+						defs[res_i] == NULL ? "Can't find resource definition" :
+						"Invalid value for consumable resource");
+					layout.nodes.erase(node->name);
+					return NULL;
+				}
+				if (vals.size() != 1 || vals[0] != "\"\"") {
+					vals.assign(1, "\"\"");
+					changed = true;
+				}
+			} else if (!vals.empty()) {
+				vals.clear();
+				changed = true;
+			}
+			continue;
+		}
+
+		for (; res->str_avail[val_i] != NULL; val_i++) {
+			if (val_i >= vals.size()) {
+				vals.push_back(res->str_avail[val_i]);
+				changed = true;
+			} else if (vals[val_i] != res->str_avail[val_i]) {
+				vals[val_i] = res->str_avail[val_i];
+				changed = true;
+			}
+		}
+		if (val_i != vals.size()) {
+			vals.resize(val_i);
+			changed = true;
+		}
+	}
+
+	if (!changed)
+		return &lnode.parts;
+
+	lnode.parts.clear();
+	for (std::size_t res_i = 0; res_i < defs.size(); res_i++) {
+		for (const auto &val : lnode.vals[res_i]) {
+			std::string name = std::string(resnames[res_i]) + "=" + val;
+			int ind;
+
+			auto f = layout.part_ind.find(name);
+			if (f == layout.part_ind.end()) {
+				ind = layout.parts.size();
+				layout.parts.push_back({name, static_cast<int>(res_i), val});
+				layout.part_ind[name] = ind;
+			} else
+				ind = f->second;
+			/* a value may be listed more than once */
+			if (std::find(lnode.parts.begin(), lnode.parts.end(), ind) == lnode.parts.end())
+				lnode.parts.push_back(ind);
+		}
+	}
+
+	return &lnode.parts;
+}
+
 /**
  * @brief
  * 		break apart nodes into partitions
- *		A possible side-effect of this function when multiple identical
- *		resources are defined on an attribute, is that the node
- *		partitions accounting for this node may count this node in the
- *		total count of "free_nodes" for that partition (if the node was
- *		free in the first place). Due to this, incorrect accounting,
- *		the metadata of the node partition may cause eval_selspec to
- *		descend into the node matching code instead of bailing out right
- *		away due to the fact that the node partition has insufficient
- *		resources.
  *
  * @param[in]	policy	-	policy info
  * @param[in]	nodes	-	the nodes which to create partitions from
@@ -379,31 +546,25 @@ find_node_partition_by_rank(node_partition **np_arr, int rank)
  * @retval	: created node_partition array
  * @retval	: NULL on error
  *
+ * @par	Which partitions a node belongs to is kept across cycles in a
+ *	layout (@see np_layout_node_parts()), only the partitions themselves
+ *	are created anew.
+ *
  */
 node_partition **
 create_node_partitions(status *policy, node_info **nodes, const char * const *resnames, unsigned int flags, int *num_parts)
 {
 	node_partition **np_arr;
-	node_partition *np;
-	node_partition **tmp_arr;
-	char buf[1024];
-	char *str;
-	bool free_str = false;
-	int np_arr_size = 0;
-	static schd_resource *res;
-
-	int num_nodes;
-
-	schd_resource *tmpres;
-
-	int res_i;		/* index of placement set resource name (resnames) */
-	int val_i;		/* index of placement set resource value */
-	int node_i;		/* index into nodes array */
-	int np_i;		/* index into node partition array we are creating */
-
-	static schd_resource *unset_res = NULL;
-
+	std::vector<resdef *> defs;
+	std::vector<const std::vector<int> *> node_parts;
+	std::vector<int> part_cnt;
+	std::vector<node_partition *> part_np;
+	std::vector<schd_resource *> part_host;
+	std::string key;
 	queue_info **queues = NULL;
+	int num_nodes;
+	int node_i;
+	int np_i;
 
 	if (nodes == NULL || resnames == NULL)
 		return NULL;
@@ -413,183 +574,102 @@ create_node_partitions(status *policy, node_info **nodes, const char * const *re
 
 	num_nodes = count_array(nodes);
 
-	if ((np_arr = static_cast<node_partition **>(malloc((num_nodes + 1) * sizeof(node_partition *)))) == NULL) {
-		log_err(errno, __func__, MEM_ERR_MSG);
-		return NULL;
+	for (int res_i = 0; resnames[res_i] != NULL; res_i++) {
+		defs.push_back(find_resdef(resnames[res_i]));
+		key += resnames[res_i];
+		key += ',';
 	}
+	key += (flags & NP_CREATE_REST) ? "rest" : "";
+	auto &layout = np_layouts[key];
 
-	np_arr_size = num_nodes;
-
-	np_i = 0;
-	np_arr[0] = NULL;
-
-	if (flags & NP_CREATE_REST && unset_res == NULL)
-		unset_res = new_resource();
-
-	for (res_i = 0; resnames[res_i] != NULL; res_i++) {
-		auto def = find_resdef(resnames[res_i]);
-		auto reslen = strlen(resnames[res_i]);
-		for (node_i = 0; nodes[node_i] != NULL; node_i++) {
-			if (nodes[node_i]->is_stale)
-				continue;
+	/* find which partitions each node is in and how big they are */
+	node_parts.assign(num_nodes, NULL);
+	for (node_i = 0; node_i < num_nodes; node_i++) {
+		if (nodes[node_i]->is_stale)
+			continue;
 
-			res = find_resource(nodes[node_i]->res, def);
-
-			if (res == NULL && (flags & NP_CREATE_REST)) {
-				unset_res->name = resnames[res_i];
-				if (set_resource(unset_res, "\"\"", RF_AVAIL) == 0) {
-					free_node_partition_array(np_arr);
-					return NULL;
-				}
-				res = unset_res;
-			}
-			if (res != NULL) {
-				/* Incase of indirect resource, point it to the right place */
-				if (res->indirect_res != NULL)
-					res = res->indirect_res;
-				for (val_i = 0; res->str_avail[val_i] != NULL; val_i++) {
-					/* 2: 1 for '=' 1 for '\0' */
-					if (reslen + strlen(res->str_avail[val_i]) + 2 < 1024) {
-						sprintf(buf, "%s=%s", resnames[res_i], res->str_avail[val_i]);
-						str = buf;
-					}
-					else {
-						pbs_asprintf(&str, "%s=%s", resnames[res_i], res->str_avail[val_i]);
-						free_str = true;
-					}
-					/* If we find the partition, we've already created it - add the node
-					 * to the existing partition.  If we don't find it, we create it.
-					 */
-					np = find_node_partition(np_arr, str);
-					if (np == NULL) {
-						if (np_i >= np_arr_size) {
-							tmp_arr = static_cast<node_partition **>(realloc(np_arr,
-								(np_arr_size * 2 + 1) * sizeof(node_partition *)));
-							if (tmp_arr == NULL) {
-								log_err(errno, __func__, MEM_ERR_MSG);
-								free_node_partition_array(np_arr);
-								if (free_str)
-									free(str);
-								return NULL;
-							}
-							np_arr = tmp_arr;
-							np_arr_size *= 2;
-						}
-
-						np_arr[np_i] = new_node_partition();
-						if (np_arr[np_i] != NULL) {
-							if (free_str) {
-								np_arr[np_i]->name = str;
-								free_str = false;
-							}
-							else
-								np_arr[np_i]->name = string_dup(str);
-
-							np_arr[np_i]->def = def;
-							np_arr[np_i]->res_val = string_dup(res->str_avail[val_i]);
-							np_arr[np_i]->tot_nodes = 1;
-							if (nodes[node_i]->is_free)
-								np_arr[np_i]->free_nodes = 1;
-							np_arr[np_i]->rank = get_sched_rank();
-
-							if (np_arr[np_i]->res_val == NULL) {
-								np_arr[np_i + 1] = NULL;
-								free_node_partition_array(np_arr);
-								return NULL;
-							}
-
-							np_i++;
-							np_arr[np_i] = NULL;
-						}
-						else {
-							free_node_partition_array(np_arr);
-							return NULL;
-						}
-					}
-					else {
-						np->tot_nodes++;
-						if (nodes[node_i]->is_free)
-							np->free_nodes++;
-					}
-					if (free_str) {
-						free(str);
-						free_str = false;
-					}
-
-				}
-			}
-			/* else we ignore nodes without the node partition resource set
-			 * unless the NP_CREATE_REST flag is set
-			 */
-		}
+		node_parts[node_i] = np_layout_node_parts(layout, nodes[node_i], resnames, defs, flags);
+		if (node_parts[node_i] == NULL)
+			return NULL;
+		part_cnt.resize(layout.parts.size(), 0);
+		for (auto p : *node_parts[node_i])
+			part_cnt[p]++;
 	}
+	part_cnt.resize(layout.parts.size(), 0);
 
+	if ((np_arr = static_cast<node_partition **>(malloc((layout.parts.size() + 1) * sizeof(node_partition *)))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	np_arr[0] = NULL;
 
-	/* now that we have a list of node partitions and number of nodes in each
-	 * lets allocate a node array and fill it
-	 */
-
-	for (np_i = 0; np_arr[np_i] != NULL; np_i++) {
-		int i = 0;
-		np_arr[np_i]->ok_break = 1;
-		schd_resource *hostres = NULL;
+	/* create the partitions which have nodes in them */
+	part_np.assign(layout.parts.size(), NULL);
+	part_host.assign(layout.parts.size(), NULL);
+	np_i = 0;
+	for (std::size_t p = 0; p < layout.parts.size(); p++) {
+		node_partition *np;
 
-		np_arr[np_i]->ninfo_arr =
-			static_cast<node_info **>(malloc((np_arr[np_i]->tot_nodes + 1) * sizeof(node_info *)));
+		if (part_cnt[p] == 0)
+			continue;
 
-		if (np_arr[np_i]->ninfo_arr == NULL) {
+		np = new_node_partition();
+		if (np == NULL) {
+			free_node_partition_array(np_arr);
+			return NULL;
+		}
+		np_arr[np_i++] = np;
+		np_arr[np_i] = NULL;
+
+		np->name = string_dup(layout.parts[p].name.c_str());
+		np->def = defs[layout.parts[p].res_i];
+		np->res_val = string_dup(layout.parts[p].res_val.c_str());
+		np->rank = get_sched_rank();
+		np->ok_break = 1;
+		np->ninfo_arr = static_cast<node_info **>(malloc((part_cnt[p] + 1) * sizeof(node_info *)));
+		if (np->name == NULL || np->res_val == NULL || np->ninfo_arr == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
 			free_node_partition_array(np_arr);
 			return NULL;
 		}
+		np->ninfo_arr[0] = NULL;
+		part_np[p] = np;
+	}
+
+	/* fill the partitions in node order */
+	for (node_i = 0; node_i < num_nodes; node_i++) {
+		schd_resource *hostres;
 
-		np_arr[np_i]->ninfo_arr[0] = NULL;
+		if (node_parts[node_i] == NULL)
+			continue;
 
-		for (node_i = 0; nodes[node_i] != NULL &&
-			i < np_arr[np_i]->tot_nodes; node_i++) {
-			if (nodes[node_i]->is_stale)
-				continue;
+		hostres = find_resource(nodes[node_i]->res, allres["host"]);
+		for (auto p : *node_parts[node_i]) {
+			auto np = part_np[p];
 
-			res = find_resource(nodes[node_i]->res, np_arr[np_i]->def);
-			if (res == NULL && (flags & NP_CREATE_REST)) {
-				set_resource(unset_res, "\"\"", RF_AVAIL);
-				res = unset_res;
+			if (np->ok_break && hostres != NULL) {
+				if (part_host[p] == NULL)
+					part_host[p] = hostres;
+				else if (!compare_res_to_str(part_host[p], hostres->str_avail[0], CMP_CASELESS))
+					np->ok_break = 0;
 			}
-			if (res != NULL) {
-				/* Incase of indirect resource, point it to the right place */
-				if (res->indirect_res != NULL)
-					res = res->indirect_res;
-				if (compare_res_to_str(res, np_arr[np_i]->res_val, CMP_CASE)) {
-					if (np_arr[np_i]->ok_break) {
-						tmpres = find_resource(nodes[node_i]->res, allres["host"]);
-						if (tmpres != NULL) {
-							if (hostres == NULL)
-								hostres = tmpres;
-							else {
-								if (!compare_res_to_str(hostres, tmpres->str_avail[0], CMP_CASELESS))
-									np_arr[np_i]->ok_break = 0;
-							}
-						}
-					}
-					if (!(NP_NO_ADD_NP_ARR & flags)) {
-						tmp_arr = static_cast<node_partition **>(add_ptr_to_array(nodes[node_i]->np_arr, np_arr[np_i]));
-						if (tmp_arr == NULL) {
-							free_node_partition_array(np_arr);
-							return NULL;
-						}
-						nodes[node_i]->np_arr = tmp_arr;
-					}
-
-					np_arr[np_i]->ninfo_arr[i] = nodes[node_i];
-					i++;
-					np_arr[np_i]->ninfo_arr[i] = NULL;
+			if (!(NP_NO_ADD_NP_ARR & flags)) {
+				auto tmp_arr = static_cast<node_partition **>(add_ptr_to_array(nodes[node_i]->np_arr, np));
+				if (tmp_arr == NULL) {
+					free_node_partition_array(np_arr);
+					return NULL;
 				}
+				nodes[node_i]->np_arr = tmp_arr;
 			}
+			np->ninfo_arr[np->tot_nodes++] = nodes[node_i];
+			np->ninfo_arr[np->tot_nodes] = NULL;
 		}
-		/* if multiple resource values are present, tot_nodes may be incorrect.
-		 * recalculating tot_nodes for each node partition.
-		 */
-		np_arr[np_i]->tot_nodes = count_array(np_arr[np_i]->ninfo_arr);
+	}
+
+	for (np_i = 0; np_arr[np_i] != NULL; np_i++) {
+		prof_phase_start(PROF_BUCKETS);
 		np_arr[np_i]->bkts = create_node_buckets(policy, np_arr[np_i]->ninfo_arr, queues, NO_PRINT_BUCKETS);
+		prof_phase_end(PROF_BUCKETS);
 		node_partition_update(policy, np_arr[np_i]);
 	}
 
@@ -720,12 +800,14 @@ node_partition_update(status *policy, node_partition *np)
 	int rc = 1;
 	schd_resource *res;
 	unsigned int arl_flags = USE_RESOURCE_LIST | ADD_ALL_BOOL;
+	bool update = false;
 
 	if (np == NULL)
 		return 0;
 
 	/* if res is not NULL, we are updating.  Clear the meta data for the update*/
 	if (np->res != NULL) {
+		update = true;
 		arl_flags |= NO_UPDATE_NON_CONSUMABLE;
 		for (res = np->res; res != NULL; res = res->next) {
 			if (res->type.is_consumable) {
@@ -755,10 +837,18 @@ node_partition_update(status *policy, node_partition *np)
 		}
 	}
 
+	if (!update)
+		index_resource_list(np->res);
+
 	if (!policy->node_sort->empty() && conf.node_sort_unused) {
-		/* Resort the nodes in the partition so that selection works correctly. */
-		qsort(np->ninfo_arr, np->tot_nodes, sizeof(node_info *),
-			multi_node_sort);
+		/* Resort the nodes in the partition so that selection works correctly.
+		 * On an update only the nodes whose resources changed are out of order.
+		 */
+		if (update)
+			resort_nodes(np->ninfo_arr, np->tot_nodes);
+		else
+			qsort(np->ninfo_arr, np->tot_nodes, sizeof(node_info *),
+				multi_node_sort);
 	}
 
 	return rc;
@@ -1225,6 +1315,8 @@ create_placement_sets(status *policy, server_info *sinfo)
 {
 	bool is_success = true;
 
+	np_layout_new_cycle();
+
 	sinfo->allpart = create_specific_nodepart(policy, "all", sinfo->unassoc_nodes, NO_FLAGS);
 	if (sinfo->has_multi_vnode) {
 		const char *resstr[] = {"host", NULL};
@@ -1325,20 +1417,21 @@ sort_all_nodepart(status *policy, server_info *sinfo)
 	if (policy == NULL || sinfo == NULL || sinfo->queues == NULL)
 		return;
 
+	/* The arrays are normally still sorted from the last time, except for
+	 * the partitions whose resources changed since then.
+	 */
 	if (sinfo->node_group_enable && sinfo->node_group_key != NULL)
-		qsort(sinfo->nodepart, sinfo->num_parts,
-		      sizeof(node_partition *), cmp_placement_sets);
+		resort_nodeparts(sinfo->nodepart, sinfo->num_parts, cmp_placement_sets);
 
 	for (i = 0; sinfo->queues[i] != NULL; i++) {
 		queue_info *qinfo = sinfo->queues[i];
 
 		if (sinfo->node_group_enable && qinfo->node_group_key != NULL)
-			qsort(qinfo->nodepart, qinfo->num_parts,
-			      sizeof(node_partition *), cmp_placement_sets);
+			resort_nodeparts(qinfo->nodepart, qinfo->num_parts, cmp_placement_sets);
 	}
 	if (!policy->node_sort->empty() && conf.node_sort_unused && sinfo->hostsets != NULL) {
 		/* Resort the nodes in host sets to correctly reflect unused resources */
-		qsort(sinfo->hostsets, sinfo->num_hostsets, sizeof(node_partition *), multi_nodepart_sort);
+		resort_nodeparts(sinfo->hostsets, sinfo->num_hostsets, multi_nodepart_sort);
 	}
 }
 
@@ -122,6 +122,9 @@ node_partition **copy_node_partition_ptr_array(node_partition **onp_arr, node_pa
 node_partition **create_node_partitions(status *policy, node_info **nodes, const char * const *resnames,
 					unsigned int flags, int *num_parts);
 
+/* start a new cycle for the node partition layouts kept across cycles */
+void np_layout_new_cycle(void);
+
 /*
  *
  *      find_node_partition - find a node partition by name in an array
@@ -101,6 +101,9 @@ config::config() : fairshare_res("cput"), fairshare_ent("euser")
 	node_sort_unused = 0;
 	resv_conf_ignore = 0;
 	allow_aoe_calendar = 0;
+	incremental_query = 0;
+	cycle_stats = 0;
+	capture_snapshot = 0;
 #ifdef NAS /* localmod 034 */
 	prime_sto = 0;
 	non_prime_sto = 0;
@@ -118,6 +121,7 @@ config::config() : fairshare_res("cput"), fairshare_ent("euser")
 	unknown_shares = 0;			/* unknown group shares */
 	max_preempt_attempts = SCHD_INFINITY;					/* max num of preempt attempts per cyc*/
 	max_jobs_to_check = SCHD_INFINITY;			/* max number of jobs to check in cyc*/
+	run_job_window = 0;			/* max run requests awaiting a reply */
 	fairshare_decay_factor = .5;		/* decay factor used when decaying fairshare tree */
 #ifdef NAS
 	/* localmod 034 */
@@ -291,6 +295,19 @@ parse_config(const char *fname)
 					tmpconf.enforce_no_shares = num ? 1 : 0;
 				else if (!strcmp(config_name, PARSE_ALLOW_AOE_CALENDAR))
 					tmpconf.allow_aoe_calendar = 1;
+				else if (!strcmp(config_name, PARSE_INCREMENTAL_QUERY))
+					tmpconf.incremental_query = num ? 1 : 0;
+				else if (!strcmp(config_name, PARSE_CYCLE_STATS))
+					tmpconf.cycle_stats = num ? 1 : 0;
+				else if (!strcmp(config_name, PARSE_CAPTURE_SNAPSHOT))
+					tmpconf.capture_snapshot = num ? 1 : 0;
+				else if (!strcmp(config_name, PARSE_RUN_JOB_WINDOW)) {
+					if (num < 0) {
+						snprintf(errbuf, sizeof(errbuf), "Invalid value %s", config_value);
+						error = true;
+					} else
+						tmpconf.run_job_window = num;
+				}
 				else if (!strcmp(config_name, PARSE_PRIME_SPILL)) {
 					if (prime == PRIME || prime == PT_ALL)
 						tmpconf.prime_spill = res_to_num(config_value, &type);
@@ -532,12 +549,21 @@ parse_config(const char *fname)
 					auto tok = strtok(config_value, DELIM);
 					if (tok != NULL) {
 						auto res = tok;
+						long cache_time = 0;
 
 						/* tok is the rest of the config_value string - the program */
 						tok = strtok(NULL, "");
 						while (tok != NULL && isspace(*tok))
 							tok++;
 
+						/* optional number of seconds to reuse the script's output */
+						if (tok != NULL && isdigit(*tok)) {
+							cache_time = strtol(tok, &endp, 10);
+							tok = endp;
+							while (isspace(*tok))
+								tok++;
+						}
+
 						if (tok != NULL && tok[0] == '!') {
 							tok++;
 							auto command_line = tok;
@@ -555,7 +581,7 @@ parse_config(const char *fname)
 										error = true;
 									}
 								#endif
-								tmpconf.dynamic_res.emplace_back(res, command_line, filename);
+								tmpconf.dynamic_res.emplace_back(res, command_line, filename, cache_time);
 								free(filename);
 							}
 						}
@@ -40,6 +40,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "pbs_bitmap.h"
 
@@ -217,7 +218,7 @@ pbs_bitmap_next_on_bit(pbs_bitmap *pbm, unsigned long start_bit)
 {
 	unsigned long long_ind;
 	long bit;
-	size_t i;
+	unsigned long word;
 
 	if (pbm == NULL)
 		return -1;
@@ -228,33 +229,76 @@ pbs_bitmap_next_on_bit(pbs_bitmap *pbm, unsigned long start_bit)
 	long_ind = start_bit / BYTES_TO_BITS(sizeof(unsigned long));
 	bit = start_bit % BYTES_TO_BITS(sizeof(unsigned long));
 
-	/* special case - look at first long that contains start_bit */
-	if (pbm->bits[long_ind] != 0) {
-		for (i = bit + 1; i < BYTES_TO_BITS(sizeof(unsigned long)); i++) {
-			if (pbm->bits[long_ind] & (1UL << i)) {
-				return (long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + i);
-			}
-		}
+	/* special case - look at first long that contains start_bit.  Mask off start_bit and below */
+	word = pbm->bits[long_ind];
+	if (bit == BYTES_TO_BITS(sizeof(unsigned long)) - 1)
+		word = 0;
+	else
+		word &= ~0UL << (bit + 1);
 
-		/* didn't find an on bit after start_bit_index in the long that contained start_bit */
-		if (long_ind < pbm->num_longs) {
-			long_ind++;
-		}
+	while (word == 0) {
+		long_ind++;
+		if (long_ind >= pbm->num_longs)
+			return -1;
+		word = pbm->bits[long_ind];
 	}
 
-	for( ; long_ind < pbm->num_longs && pbm->bits[long_ind] == 0; long_ind++)
-		;
+	return (long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + __builtin_ctzl(word));
+}
+
+/**
+ * @brief starting at a bit, find the next run of consecutive on bits
+ * @param pbm - the bitmap
+ * @param start_bit - first bit to look at
+ * @param[out] run_len - number of on bits in the run
+ * @return int
+ * @retval number of the first bit of the run
+ * @retval -1 if there is no on bit at or after start_bit
+ */
+int
+pbs_bitmap_next_on_run(pbs_bitmap *pbm, unsigned long start_bit, unsigned long *run_len)
+{
+	unsigned long long_ind;
+	unsigned long word;
+	unsigned long first;
+	unsigned long end;
+
+	if (run_len != NULL)
+		*run_len = 0;
 
-	if (long_ind == pbm->num_longs)
+	if (pbm == NULL || run_len == NULL || start_bit >= pbm->num_bits)
 		return -1;
 
-	for (i = 0 ; i < BYTES_TO_BITS(sizeof(unsigned long)) ; i++) {
-		if (pbm->bits[long_ind] & (1UL << i)) {
-			return (long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + i);
-		}
+	/* find the first on bit at or after start_bit */
+	long_ind = start_bit / BYTES_TO_BITS(sizeof(unsigned long));
+	word = pbm->bits[long_ind] & (~0UL << (start_bit % BYTES_TO_BITS(sizeof(unsigned long))));
+	while (word == 0) {
+		long_ind++;
+		if (long_ind >= pbm->num_longs)
+			return -1;
+		word = pbm->bits[long_ind];
+	}
+	first = long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + __builtin_ctzl(word);
+	if (first >= pbm->num_bits)
+		return -1;
+
+	/* the run ends at the next off bit */
+	word = ~pbm->bits[long_ind] & (~0UL << (first % BYTES_TO_BITS(sizeof(unsigned long))));
+	while (word == 0) {
+		long_ind++;
+		if (long_ind >= pbm->num_longs)
+			break;
+		word = ~pbm->bits[long_ind];
 	}
+	if (long_ind >= pbm->num_longs)
+		end = pbm->num_bits;
+	else
+		end = long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + __builtin_ctzl(word);
+	if (end > pbm->num_bits)
+		end = pbm->num_bits;
 
-	return -1;
+	*run_len = end - first;
+	return first;
 }
 
 /**
@@ -334,3 +378,115 @@ pbs_bitmap_is_equal(pbs_bitmap *L, pbs_bitmap *R)
 
 	return 1;
 }
+
+/**
+ * @brief pbs_bitmap version of L &= ~R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_andnot(pbs_bitmap *L, pbs_bitmap *R)
+{
+	unsigned long i;
+
+	if (L == NULL || R == NULL)
+		return 0;
+
+	for (i = 0; i < L->num_longs && i < R->num_longs; i++)
+		L->bits[i] &= ~R->bits[i];
+
+	return 1;
+}
+
+/**
+ * @brief pbs_bitmap version of L |= R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_or(pbs_bitmap *L, pbs_bitmap *R)
+{
+	unsigned long i;
+
+	if (L == NULL || R == NULL)
+		return 0;
+
+	if (R->num_longs > L->num_longs)
+		if (pbs_bitmap_alloc(L, BYTES_TO_BITS(R->num_longs * sizeof(unsigned long))) == NULL)
+			return 0;
+
+	for (i = 0; i < R->num_longs; i++)
+		L->bits[i] |= R->bits[i];
+
+	if (R->num_bits > L->num_bits)
+		L->num_bits = R->num_bits;
+
+	return 1;
+}
+
+/**
+ * @brief turn all the bits of a bitmap off
+ * @param pbm - the bitmap
+ * @return nothing
+ */
+void
+pbs_bitmap_clear(pbs_bitmap *pbm)
+{
+	if (pbm == NULL)
+		return;
+
+	memset(pbm->bits, 0, pbm->num_longs * sizeof(unsigned long));
+}
+
+/**
+ * @brief set L to the first (lowest) n on bits of R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @param n - number of on bits to take from R
+ * @return unsigned long - number of bits set in L.  Less than n if R has fewer on bits.
+ */
+unsigned long
+pbs_bitmap_first_n_on_bits(pbs_bitmap *L, pbs_bitmap *R, unsigned long n)
+{
+	unsigned long i;
+	unsigned long ct = 0;
+
+	if (L == NULL || R == NULL)
+		return 0;
+
+	if (R->num_longs > L->num_longs)
+		if (pbs_bitmap_alloc(L, BYTES_TO_BITS(R->num_longs * sizeof(unsigned long))) == NULL)
+			return 0;
+	L->num_bits = R->num_bits;
+	pbs_bitmap_clear(L);
+
+	for (i = 0; i < R->num_longs && ct < n; i++) {
+		unsigned long word = R->bits[i];
+		unsigned long word_ct = __builtin_popcountl(word);
+
+		if (ct + word_ct <= n) {
+			/* whole word fits */
+			L->bits[i] = word;
+			ct += word_ct;
+		} else {
+			/* take the lowest on bits one at a time */
+			unsigned long taken = 0;
+
+			for (; ct < n; ct++) {
+				unsigned long low = word & -word;
+
+				taken |= low;
+				word &= ~low;
+			}
+			L->bits[i] = taken;
+		}
+	}
+
+	return ct;
+}
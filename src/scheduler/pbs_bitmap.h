@@ -71,10 +71,25 @@ int pbs_bitmap_first_on_bit(pbs_bitmap *bm);
 /* Starting at start_bit get the next on bit */
 int pbs_bitmap_next_on_bit(pbs_bitmap *pbm, unsigned long start_bit);
 
+/* Starting at start_bit get the next run of on bits */
+int pbs_bitmap_next_on_run(pbs_bitmap *pbm, unsigned long start_bit, unsigned long *run_len);
+
 /* pbs_bitmap's version of L = R */
 int pbs_bitmap_assign(pbs_bitmap *L, pbs_bitmap *R);
 
 /* pbs_bitmap's version of L == R */
 int pbs_bitmap_is_equal(pbs_bitmap *L, pbs_bitmap *R);
 
+/* pbs_bitmap's version of L &= ~R */
+int pbs_bitmap_andnot(pbs_bitmap *L, pbs_bitmap *R);
+
+/* pbs_bitmap's version of L |= R */
+int pbs_bitmap_or(pbs_bitmap *L, pbs_bitmap *R);
+
+/* Turn all bits off */
+void pbs_bitmap_clear(pbs_bitmap *pbm);
+
+/* Set L to the first n on bits of R */
+unsigned long pbs_bitmap_first_n_on_bits(pbs_bitmap *L, pbs_bitmap *R, unsigned long n);
+
 #endif	/* _PBS_BITMASK_H */
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+
+/**
+ * @file    pbs_sched_replay.cpp
+ *
+ * @brief
+ * 		pbs_sched_replay.cpp - replay scheduling cycles from a snapshot
+ *
+ * Functions included are:
+ * 	main()
+ * 	elapsed()
+ *
+ * pbs_sched_replay runs the scheduler's cycle against a snapshot written by
+ * a scheduler with capture_snapshot set, instead of against a server.  The
+ * directory it is run in is a copy of the scheduler's sched_priv (sched_config,
+ * resource_group, usage, holidays, dedicated_time) at the time the snapshot
+ * was taken.  Each cycle replays the same universe: the decisions of one
+ * cycle are not seen by the next.
+ */
+#include <pbs_config.h> /* the master config generated by configure */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#ifdef PYTHON
+#include <Python.h>
+#endif
+
+#include <libpbs.h>
+#include <log.h>
+#include <sched_cmds.h>
+#include "constant.h"
+#include "data_types.h"
+#include "fifo.h"
+#include "globals.h"
+#include "misc.h"
+#include "resource.h"
+#include "snapshot.h"
+
+#define REPLAY_USAGE "[-n cycles] [-t threads] [-I sched_name] [-L logfile] [-d sched_priv] [-v] snapshot"
+
+/**
+ * @brief	seconds between two times
+ *
+ * @param[in]	start	-	start time
+ * @param[in]	end	-	end time
+ *
+ * @return	double
+ */
+static double
+elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief
+ * 		The entry point of pbs_sched_replay
+ *
+ * @return	int
+ * @retval	0	: success
+ * @retval	1	: something is wrong!
+ */
+int
+main(int argc, char *argv[])
+{
+	int c;
+	int errflg = 0;
+	int ncycles = 1;
+	int nthreads = -1;
+	int verbose = 0;
+	char *name = NULL;
+	char *dir = NULL;
+	char *log_file = NULL;
+	double min = 0;
+	double max = 0;
+	double total = 0;
+	sched_cmd cmd = {SCH_SCHEDULE_NEW, NULL};
+
+	if (set_msgdaemonname(const_cast<char *>("pbs_sched_replay"))) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	if (pbs_loadconf(0) <= 0)
+		return 1;
+
+	while ((c = getopt(argc, argv, "n:t:I:L:d:v")) != -1)
+		switch (c) {
+			case 'n':
+				ncycles = atoi(optarg);
+				if (ncycles <= 0)
+					errflg++;
+				break;
+			case 't':
+				nthreads = atoi(optarg);
+				break;
+			case 'I':
+				name = optarg;
+				break;
+			case 'L':
+				log_file = optarg;
+				break;
+			case 'd':
+				dir = optarg;
+				break;
+			case 'v':
+				verbose = 1;
+				break;
+			default:
+				errflg++;
+		}
+
+	if (errflg || argc - optind != 1) {
+		fprintf(stderr, "usage: %s %s\n", argv[0], REPLAY_USAGE);
+		return 1;
+	}
+
+	if (log_file != NULL && log_open(log_file, const_cast<char *>("")) == -1) {
+		fprintf(stderr, "%s: logfile could not be opened\n", argv[0]);
+		return 1;
+	}
+
+	/* load the snapshot before changing into sched_priv, it is relative to where we were run */
+	if (!snapshot_load(argv[optind])) {
+		fprintf(stderr, "%s: could not load snapshot %s\n", argv[0], argv[optind]);
+		return 1;
+	}
+
+	if (dir != NULL && chdir(dir) == -1) {
+		perror("chdir");
+		return 1;
+	}
+
+	if (name == NULL)
+		name = string_dup(snapshot_sched_name().c_str());
+	if (name == NULL || *name == '\0')
+		name = const_cast<char *>(PBS_DFLT_SCHED_NAME);
+	sc_name = name;
+	if (strcmp(sc_name, PBS_DFLT_SCHED_NAME) == 0)
+		dflt_sched = 1;
+
+	if (schedinit(nthreads) != 0) {
+		fprintf(stderr, "%s: local initialization failed\n", argv[0]);
+		return 1;
+	}
+	/* there are no peer servers to pull jobs from */
+	conf.peer_queues.clear();
+
+	if (!update_resource_defs(REPLAY_SD) || !set_validate_sched_attrs(REPLAY_SD)) {
+		fprintf(stderr, "%s: snapshot has no resource definitions or scheduler %s\n", argv[0], sc_name);
+		return 1;
+	}
+
+	for (int i = 0; i < ncycles; i++) {
+		struct timespec start;
+		struct timespec end;
+		double secs;
+		auto &decisions = snapshot_decisions();
+
+		decisions.clear();
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		scheduling_cycle(REPLAY_SD, &cmd);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		secs = elapsed(&start, &end);
+		if (i == 0 || secs < min)
+			min = secs;
+		if (secs > max)
+			max = secs;
+		total += secs;
+
+		printf("cycle %d: %.6f seconds, %zu decisions\n", i + 1, secs, decisions.size());
+		if (verbose)
+			for (const auto &d : decisions)
+				printf("\t%s\n", d.c_str());
+	}
+
+	printf("%d cycles: min %.6f avg %.6f max %.6f seconds\n", ncycles, min, total / ncycles, max);
+
+#ifdef PYTHON
+	Py_Finalize();
+#endif
+	log_close(0);
+
+	return 0;
+}
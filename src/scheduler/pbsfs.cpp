@@ -210,7 +210,7 @@ main(int argc, char *argv[])
 		fprintf(stderr, "Error in preloading fairshare information\n");
 		return 1;
 	}
-	if (parse_group(RESGROUP_FILE, fstree->root) == 0)
+	if (parse_group(RESGROUP_FILE, fstree) == 0)
 		return 1;
 
 	if (flags & FS_TRIM_TREE) {
@@ -220,7 +220,7 @@ main(int argc, char *argv[])
 	else
 		read_usage(USAGE_FILE, 0, fstree);
 
-	calc_fair_share_perc(fstree->root->child, UNSPECIFIED);
+	calc_fair_share_perc(fstree);
 	calc_usage_factor(fstree);
 
 	if (flags & FS_PRINT_TREE)
@@ -230,18 +230,18 @@ main(int argc, char *argv[])
 		print_fairshare(fstree->root, -1);
 	}
 	else if (flags & FS_DECAY) {
-		decay_fairshare_tree(fstree->root);
+		decay_fairshare_tree(fstree);
 		fstree->last_decay = time(NULL);
 	}
 	else if (flags & (FS_GET | FS_SET | FS_COMP)) {
-		ginfo = find_group_info(argv[optind], fstree->root);
+		ginfo = find_group_info(argv[optind], fstree);
 
 		if (ginfo == NULL) {
 			fprintf(stderr, "Fairshare Entity %s does not exist.\n", argv[optind]);
 			return 1;
 		}
 		if (flags & FS_COMP) {
-			ginfo2 = find_group_info(argv[optind + 1], fstree->root);
+			ginfo2 = find_group_info(argv[optind + 1], fstree);
 
 			if (ginfo2 == NULL) {
 				fprintf(stderr, "Fairshare Entity %s does not exist.\n", argv[optind + 1]);
@@ -277,6 +277,8 @@ main(int argc, char *argv[])
 		remove(USAGE_FILE ".bak");
 		if (rename(USAGE_FILE, USAGE_FILE ".bak") < 0)
 			perror("Could not backup usage database.");
+		remove(USAGE_FILE ".bak" USAGE_JOURNAL_EXT);
+		rename(USAGE_FILE USAGE_JOURNAL_EXT, USAGE_FILE ".bak" USAGE_JOURNAL_EXT);
 		write_usage(USAGE_FILE, fstree);
 		if ((fp = fopen(USAGE_TOUCH, "w")) != NULL)
 			fclose(fp);
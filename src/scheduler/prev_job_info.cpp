@@ -60,6 +60,7 @@
 #include "misc.h"
 #include "resource_resv.h"
 #include "globals.h"
+#include "arena.h"
 
 
 /**
@@ -68,8 +69,6 @@
  *
  * @param[in]	jobs	-	job array
  *
- * @par	NOTE: jinfo_arr is modified
- *
  */
 void
 create_prev_job_info(resource_resv **jobs)
@@ -78,16 +77,16 @@ create_prev_job_info(resource_resv **jobs)
 
 	last_running.clear();
 
+	/* resused was allocated from the cycle's arena, copy it to the heap */
+	arena_suspend();
 	for (i = 0; jobs[i] != NULL; i++) {
 		if(jobs[i]->job != NULL) {
-			prev_job_info pjinfo(jobs[i]->name, jobs[i]->job->ginfo->name, jobs[i]->job->resused);
-
-			/* resused is shallow copied, NULL it so it doesn't get freed at the end of the cycle */
-			jobs[i]->job->resused = NULL;
+			prev_job_info pjinfo(jobs[i]->name, jobs[i]->job->ginfo->name, dup_resource_req_list(jobs[i]->job->resused));
 
-			last_running.push_back(pjinfo);
+			last_running.push_back(std::move(pjinfo));
 		}
 	}
+	arena_resume();
 }
 
 prev_job_info::prev_job_info(const std::string& pname, const std::string& ename, resource_req *rused): name(pname), entity_name(ename), resused(rused)
@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+/**
+ * @file    profile.cpp
+ *
+ * @brief
+ * 		profile.cpp - per-phase timing and counts of a scheduling cycle.
+ *
+ * Functions included are:
+ * 	prof_cycle_start()
+ * 	prof_phase_start()
+ * 	prof_phase_end()
+ * 	prof_count()
+ * 	prof_record_universe()
+ * 	prof_cycle_end()
+ */
+
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <log.h>
+#include <pbs_json.h>
+
+#include "data_types.h"
+#include "constant.h"
+#include "config.h"
+#include "globals.h"
+#include "arena.h"
+#include "profile.h"
+
+/* the time spent in one phase of the cycle */
+struct prof_phase_stat {
+	long calls;		/* number of times the phase was entered */
+	double wall;		/* total wall time */
+	double cpu;		/* total process CPU time */
+	double max_wall;	/* longest single call */
+	int depth;		/* nesting level of the phase */
+	struct timespec wall_start;	/* start of the current call */
+	struct timespec cpu_start;
+};
+
+/* the statistics of the current cycle */
+static struct {
+	bool enabled;		/* collecting statistics this cycle */
+	pthread_t thread;	/* the thread running the cycle */
+	time_t start_time;	/* when the cycle started */
+	struct timespec wall_start;
+	struct timespec cpu_start;
+	prof_phase_stat phases[PROF_NUM_PHASES];
+	long counters[PROF_NUM_COUNTERS];
+	long num_jobs;
+	long num_running;
+	long num_queued;
+	long num_nodes;
+	long num_queues;
+	long num_resvs;
+	long num_events;
+	long arena_objs;
+	long arena_blocks;
+} prof;
+
+static const char *prof_phase_names[PROF_NUM_PHASES] = {
+	"query",
+	"init",
+	"sort",
+	"buckets",
+	"node_search",
+	"run",
+	"preempt",
+	"calendar",
+	"updates",
+	"end_cycle"
+};
+
+static const char *prof_counter_names[PROF_NUM_COUNTERS] = {
+	"jobs_considered",
+	"jobs_run",
+	"jobs_preempted",
+	"topjobs"
+};
+
+/**
+ * @brief	seconds between two timespecs
+ *
+ * @param[in]	start	-	the earlier time
+ * @param[in]	end	-	the later time
+ *
+ * @return	double
+ */
+static double
+ts_diff(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief	is the profiler collecting on the calling thread?
+ *		Worker threads are not profiled; their time shows up in the
+ *		CPU time of the phase which started them.
+ *
+ * @return	bool
+ */
+static inline bool
+prof_active(void)
+{
+	return prof.enabled && pthread_equal(prof.thread, pthread_self());
+}
+
+/**
+ * @brief	start collecting statistics for a new cycle if cycle_stats is set
+ *
+ * @return	void
+ */
+void
+prof_cycle_start(void)
+{
+	memset(&prof, 0, sizeof(prof));
+	if (!conf.cycle_stats)
+		return;
+
+	prof.enabled = true;
+	prof.thread = pthread_self();
+	prof.start_time = time(NULL);
+	clock_gettime(CLOCK_MONOTONIC, &prof.wall_start);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &prof.cpu_start);
+}
+
+/**
+ * @brief	enter a phase of the cycle
+ *
+ * @param[in]	phase	-	the phase
+ *
+ * @return	void
+ */
+void
+prof_phase_start(enum prof_phase phase)
+{
+	prof_phase_stat *ps;
+
+	if (!prof_active())
+		return;
+
+	ps = &prof.phases[phase];
+	if (ps->depth++ > 0)
+		return;
+
+	ps->calls++;
+	clock_gettime(CLOCK_MONOTONIC, &ps->wall_start);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ps->cpu_start);
+}
+
+/**
+ * @brief	leave a phase of the cycle started with prof_phase_start()
+ *
+ * @param[in]	phase	-	the phase
+ *
+ * @return	void
+ */
+void
+prof_phase_end(enum prof_phase phase)
+{
+	prof_phase_stat *ps;
+	struct timespec wall_end;
+	struct timespec cpu_end;
+	double wall;
+
+	if (!prof_active())
+		return;
+
+	ps = &prof.phases[phase];
+	if (ps->depth == 0 || --ps->depth > 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+	wall = ts_diff(&ps->wall_start, &wall_end);
+	ps->wall += wall;
+	ps->cpu += ts_diff(&ps->cpu_start, &cpu_end);
+	if (wall > ps->max_wall)
+		ps->max_wall = wall;
+}
+
+/**
+ * @brief	add to one of the cycle's counters
+ *
+ * @param[in]	counter	-	the counter
+ * @param[in]	num	-	amount to add
+ *
+ * @return	void
+ */
+void
+prof_count(enum prof_counter counter, long num)
+{
+	if (!prof_active())
+		return;
+
+	prof.counters[counter] += num;
+}
+
+/**
+ * @brief	record the size of the universe and the arena.  Called at the
+ *		end of the cycle before the universe and the arena are freed.
+ *
+ * @param[in]	sinfo	-	the universe of the cycle (may be NULL)
+ *
+ * @return	void
+ */
+void
+prof_record_universe(server_info *sinfo)
+{
+	size_t objs;
+	size_t blocks;
+
+	if (!prof_active())
+		return;
+
+	if (sinfo != NULL) {
+		prof.num_jobs = sinfo->sc.total;
+		prof.num_running = sinfo->sc.running;
+		prof.num_queued = sinfo->sc.queued;
+		prof.num_nodes = sinfo->num_nodes;
+		prof.num_queues = sinfo->num_queues;
+		prof.num_resvs = sinfo->num_resvs;
+		if (sinfo->calendar != NULL) {
+			timed_event *te;
+
+			for (te = sinfo->calendar->events; te != NULL; te = te->next)
+				prof.num_events++;
+		}
+	}
+
+	arena_stats(&objs, &blocks);
+	prof.arena_objs = objs;
+	prof.arena_blocks = blocks;
+}
+
+/**
+ * @brief	add a numeric value to the json node list
+ *
+ * @param[in]	key	-	name of the value
+ * @param[in]	fmt	-	printf format of the value
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+static int
+prof_json_num(const char *key, const char *fmt, ...)
+{
+	char buf[64];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	return add_json_node(JSON_VALUE, JSON_NULL, JSON_NOVALUE, const_cast<char *>(key), buf) != NULL;
+}
+
+/**
+ * @brief	write the statistics of the cycle to CYCLE_STATS_FILE
+ *
+ * @param[in]	wall	-	wall time of the cycle
+ * @param[in]	cpu	-	CPU time of the cycle
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+static int
+prof_write_stats(double wall, double cpu)
+{
+	FILE *fp;
+	int i;
+	int ok;
+	const char *tmpfile = CYCLE_STATS_FILE ".new";
+
+	ok = prof_json_num("cycle_start", "%ld", (long) prof.start_time) &&
+	     prof_json_num("wall_time", "%.6f", wall) &&
+	     prof_json_num("cpu_time", "%.6f", cpu) &&
+	     add_json_node(JSON_OBJECT, JSON_NULL, JSON_NOVALUE, const_cast<char *>("phases"), NULL) != NULL;
+
+	for (i = 0; ok && i < PROF_NUM_PHASES; i++) {
+		prof_phase_stat *ps = &prof.phases[i];
+
+		ok = add_json_node(JSON_OBJECT, JSON_NULL, JSON_NOVALUE, const_cast<char *>(prof_phase_names[i]), NULL) != NULL &&
+		     prof_json_num("calls", "%ld", ps->calls) &&
+		     prof_json_num("wall", "%.6f", ps->wall) &&
+		     prof_json_num("cpu", "%.6f", ps->cpu) &&
+		     prof_json_num("max_wall", "%.6f", ps->max_wall) &&
+		     add_json_node(JSON_OBJECT_END, JSON_NULL, JSON_NOVALUE, NULL, NULL) != NULL;
+	}
+
+	ok = ok && add_json_node(JSON_OBJECT_END, JSON_NULL, JSON_NOVALUE, NULL, NULL) != NULL &&
+	     add_json_node(JSON_OBJECT, JSON_NULL, JSON_NOVALUE, const_cast<char *>("counts"), NULL) != NULL &&
+	     prof_json_num("jobs", "%ld", prof.num_jobs) &&
+	     prof_json_num("running_jobs", "%ld", prof.num_running) &&
+	     prof_json_num("queued_jobs", "%ld", prof.num_queued) &&
+	     prof_json_num("nodes", "%ld", prof.num_nodes) &&
+	     prof_json_num("queues", "%ld", prof.num_queues) &&
+	     prof_json_num("resvs", "%ld", prof.num_resvs) &&
+	     prof_json_num("calendar_events", "%ld", prof.num_events) &&
+	     prof_json_num("arena_objects", "%ld", prof.arena_objs) &&
+	     prof_json_num("arena_blocks", "%ld", prof.arena_blocks);
+
+	for (i = 0; ok && i < PROF_NUM_COUNTERS; i++)
+		ok = prof_json_num(prof_counter_names[i], "%ld", prof.counters[i]);
+
+	ok = ok && add_json_node(JSON_OBJECT_END, JSON_NULL, JSON_NOVALUE, NULL, NULL) != NULL;
+
+	if (ok) {
+		if ((fp = fopen(tmpfile, "w")) == NULL) {
+			log_errf(errno, __func__, "Could not open %s", tmpfile);
+			ok = 0;
+		} else {
+			if (generate_json(fp) != 0)
+				ok = 0;
+			if (fclose(fp) != 0)
+				ok = 0;
+			if (ok && rename(tmpfile, CYCLE_STATS_FILE) == -1) {
+				log_errf(errno, __func__, "Could not rename %s", tmpfile);
+				ok = 0;
+			}
+		}
+	}
+
+	free_json_node_list();
+	return ok;
+}
+
+/**
+ * @brief	finish the statistics of the cycle: log a summary and write
+ *		them to CYCLE_STATS_FILE
+ *
+ * @return	void
+ */
+void
+prof_cycle_end(void)
+{
+	struct timespec wall_end;
+	struct timespec cpu_end;
+	double wall;
+	double cpu;
+
+	if (!prof_active())
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+	wall = ts_diff(&prof.wall_start, &wall_end);
+	cpu = ts_diff(&prof.cpu_start, &cpu_end);
+
+	log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__,
+		   "Cycle took %.3fs wall %.3fs cpu: query %.3fs sort %.3fs node_search %.3fs (%ld jobs) "
+		   "preempt %.3fs calendar %.3fs updates %.3fs",
+		   wall, cpu, prof.phases[PROF_QUERY].wall, prof.phases[PROF_SORT].wall,
+		   prof.phases[PROF_NODE_SEARCH].wall, prof.phases[PROF_NODE_SEARCH].calls,
+		   prof.phases[PROF_PREEMPT].wall, prof.phases[PROF_CALENDAR].wall,
+		   prof.phases[PROF_UPDATES].wall);
+
+	prof_write_stats(wall, cpu);
+	prof.enabled = false;
+}
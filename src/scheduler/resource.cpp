@@ -77,12 +77,15 @@
 #include "misc.h"
 #include "globals.h"
 #include "resource_resv.h"
+#include "job_info.h"
 #include "pbs_internal.h"
 #include "limits_if.h"
 #include "sort.h"
 #include "parse.h"
 #include "limits_if.h"
 #include "fifo.h"
+#include "formula.h"
+#include "buckets.h"
 
 
 
@@ -101,6 +104,7 @@ query_resources(int pbs_sd)
 	struct batch_status *cur_bs;		/* used to iterate over resources */
 	struct attrl *attrp;			/* iterate over resource fields */
 	std::unordered_map<std::string, resdef *> tmpres;
+	int idx = 0;
 
 	if ((bs = send_statrsc(pbs_sd, NULL, NULL, const_cast<char *>("p"))) == NULL) {
 		const char *errmsg = pbs_geterrmsg(pbs_sd);
@@ -126,7 +130,8 @@ query_resources(int pbs_sd)
 				flags = strtol(attrp->value, &endp, 10);
 			}
 		}
-		tmpres[cur_bs->name] = new resdef(cur_bs->name, flags, rtype);
+		if (tmpres.find(cur_bs->name) == tmpres.end())
+			tmpres[cur_bs->name] = new resdef(cur_bs->name, flags, rtype, idx++);
 	}
 	pbs_statfree(bs);
 
@@ -379,10 +384,19 @@ update_resource_defs(int pbs_sd)
 		}
 	}
 
+	/* cached jobs, node buckets, compiled formulas and kept scheduling
+	 * verdicts hold pointers to the old resource definitions
+	 */
+	free_query_cache();
+	free_node_bucket_cache();
+	clear_formula_cache();
+	clear_equiv_class_verdicts();
+
 	for (auto& d : allres)
 		delete d.second;
 
 	allres = tmpres;
+	num_resdefs = allres.size();
 
 	consres.clear();
 	for (const auto& def : allres) {
@@ -112,6 +112,7 @@
 #include "range.h"
 #include "simulate.h"
 #include "multi_threading.h"
+#include "arena.h"
 
 
 /**
@@ -1009,12 +1010,10 @@ new_resource_req()
 {
 	resource_req *resreq;
 
-	if ((resreq = static_cast<resource_req *>(calloc(1, sizeof(resource_req)))) == NULL) {
-		log_err(errno, __func__, MEM_ERR_MSG);
+	if ((resreq = static_cast<resource_req *>(arena_alloc(sizeof(resource_req)))) == NULL)
 		return NULL;
-	}
 
-	/* member type zero'd by calloc() */
+	/* member type zero'd by arena_alloc() */
 
 	resreq->name = NULL;
 	resreq->res_str = NULL;
@@ -1380,7 +1379,7 @@ free_resource_req(resource_req *req)
 	if (req->res_str != NULL)
 		free(req->res_str);
 
-	free(req);
+	arena_free(req);
 }
 
 /**
@@ -2015,10 +2014,8 @@ new_chunk()
 {
 	chunk *ch;
 
-	if ((ch = static_cast<chunk *>(malloc(sizeof(chunk)))) == NULL) {
-		log_err(errno, __func__, MEM_ERR_MSG);
+	if ((ch = static_cast<chunk *>(arena_alloc(sizeof(chunk)))) == NULL)
 		return NULL;
-	}
 
 	ch->num_chunks = 0;
 	ch->seq_num = 0;
@@ -2145,7 +2142,7 @@ free_chunk(chunk *ch)
 	if (ch->req != NULL)
 		free_resource_req_list(ch->req);
 
-	free(ch);
+	arena_free(ch);
 }
 
 /**
@@ -2313,7 +2310,7 @@ compare_non_consumable(schd_resource *res, resource_req *req)
 
 	if (req->type.is_string && res != NULL) {
 		/* 'host' to follow IETF rules; 'host' is case insensitive  */
-		if (!strcmp(res->name, "host"))
+		if (!strcmp(req->name, "host"))
 			return compare_res_to_str(res, req->res_str, CMP_CASELESS);
 		else
 			return compare_res_to_str(res, req->res_str, CMP_CASE);
@@ -39,9 +39,15 @@
 
 #include <pbs_config.h>
 
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
 #include <pbs_ifl.h>
 #include <libpbs.h>
+#include <libutil.h>
 #include "data_types.h"
 #include "fifo.h"
 #include "globals.h"
@@ -49,6 +55,9 @@
 #include "misc.h"
 #include "log.h"
 #include "server_info.h"
+#include "snapshot.h"
+
+static void read_run_job_replies(std::size_t keep);
 
 
 /**
@@ -95,6 +104,13 @@ send_run_job(int virtual_sd, int has_runjob_hook, const std::string& jobid, char
 	if (jobid.empty() || execvnode == NULL)
 		return 1;
 
+	if (snapshot_replaying()) {
+		snapshot_decision("run", jobid, execvnode);
+		return 0;
+	}
+
+	read_run_job_replies(0);
+
 	job_owner_sd = get_svr_inst_fd(virtual_sd, svr_id_job);
 
 	if (sc_attrs.runjob_mode == RJ_EXECJOB_HOOK)
@@ -105,6 +121,141 @@ send_run_job(int virtual_sd, int has_runjob_hook, const std::string& jobid, char
 		return pbs_asyrunjob(job_owner_sd, const_cast<char *>(jobid.c_str()), execvnode, NULL);
 }
 
+/* a run request sent by send_run_job_pipelined() whose reply has not been read */
+struct pending_run_job {
+	int virtual_sd;		/* virtual sd for the cluster */
+	int sd;			/* server instance the request was sent to */
+	resource_resv *resresv;	/* the job which was run */
+};
+
+/* a run request the server rejected, waiting for finish_run_jobs() */
+struct rejected_run_job {
+	int virtual_sd;		/* virtual sd for the cluster */
+	resource_resv *resresv;	/* the job which did not run */
+	int pbsrc;		/* the server's error code */
+	std::string errmsg;	/* the server's error message */
+};
+
+/* replies to run requests are read in the order the requests were sent */
+static std::deque<pending_run_job> pending_run_jobs;
+static std::vector<rejected_run_job> rejected_run_jobs;
+
+/**
+ * @brief	Read the replies to run requests sent by send_run_job_pipelined()
+ *		until at most 'keep' requests are outstanding.  Any request
+ *		which expects a reply has to call this with 0 first, so it
+ *		does not read a run request's reply as its own.
+ *
+ * @param[in]	keep	-	number of requests to leave outstanding
+ *
+ * @return	void
+ *
+ * @note	Rejected runs are only recorded here.  The universe is not
+ *		changed until finish_run_jobs(), because callers can be in
+ *		the middle of walking it.
+ */
+static void
+read_run_job_replies(std::size_t keep)
+{
+	while (pending_run_jobs.size() > keep) {
+		auto prj = pending_run_jobs.front();
+		struct batch_reply *reply;
+		int rc;
+
+		pending_run_jobs.pop_front();
+
+		reply = PBSD_rdrpy(prj.sd);
+		rc = get_conn_errno(prj.sd);
+		PBSD_FreeReply(reply);
+
+		if (rc != 0) {
+			const char *errmsg = pbs_geterrmsg(prj.sd);
+
+			rejected_run_jobs.push_back({prj.virtual_sd, prj.resresv, rc, errmsg != NULL ? errmsg : ""});
+		} else
+			log_event(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO, prj.resresv->name, "Job run");
+	}
+}
+
+/**
+ * @brief	Is the reply to a pipelined run request for a job still unread?
+ *
+ * @param[in]	rjob	-	the job
+ *
+ * @return	bool
+ * @retval	true	the server has not answered the run request yet
+ * @retval	false	otherwise
+ */
+bool
+run_job_pending(const resource_resv *rjob)
+{
+	for (const auto& prj : pending_run_jobs)
+		if (prj.resresv == rjob)
+			return true;
+
+	return false;
+}
+
+/**
+ * @brief	Send a run request to the server without waiting for the reply.
+ *		At most conf.run_job_window requests are outstanding; if the
+ *		window is full, the reply to the oldest request is read first.
+ *
+ * @param[in]	virtual_sd	-	virtual sd for the cluster
+ * @param[in]	rjob	-	the job to run
+ * @param[in]	execvnode	-	the execvnode to run the job on
+ *
+ * @return	int
+ * @retval	0	the request was sent
+ * @retval	!0	the request could not be sent
+ *
+ * @note	The job is treated as running until finish_run_jobs() finds
+ *		out otherwise and calls run_job_rejected() to undo the run.
+ */
+int
+send_run_job_pipelined(int virtual_sd, resource_resv *rjob, char *execvnode)
+{
+	int job_owner_sd;
+	int rc;
+
+	if (rjob == NULL || execvnode == NULL)
+		return 1;
+
+	if (snapshot_replaying()) {
+		snapshot_decision("run", rjob->name, execvnode);
+		return 0;
+	}
+
+	if (conf.run_job_window > 0)
+		read_run_job_replies(conf.run_job_window - 1);
+
+	job_owner_sd = get_svr_inst_fd(virtual_sd, rjob->svr_inst_id);
+
+	rc = PBSD_run_put(job_owner_sd, const_cast<char *>(rjob->name.c_str()), execvnode, NULL, PBS_BATCH_AsyrunJob_ack);
+	if (rc != 0)
+		return rc;
+
+	pending_run_jobs.push_back({virtual_sd, job_owner_sd, rjob});
+	return 0;
+}
+
+/**
+ * @brief	Read the replies to all outstanding run requests and undo the
+ *		runs the server rejected.  Only called from fixed points in
+ *		the cycle where nothing is walking the universe.
+ *
+ * @return	void
+ */
+void
+finish_run_jobs(void)
+{
+	read_run_job_replies(0);
+
+	for (auto& rrj : rejected_run_jobs)
+		run_job_rejected(rrj.virtual_sd, rrj.resresv, rrj.pbsrc, rrj.errmsg.c_str());
+	rejected_run_jobs.clear();
+}
+
 /**
  * @brief
  * 		send delayed attributes to the server for a job
@@ -179,6 +330,27 @@ send_preempt_jobs(int virtual_sd, char **preempt_jobs_list)
 {
 	preempt_job_info *ret;
 
+	if (snapshot_replaying()) {
+		int n;
+
+		for (n = 0; preempt_jobs_list[n] != NULL; n++)
+			;
+		ret = static_cast<preempt_job_info *>(calloc(n + 1, sizeof(preempt_job_info)));
+		if (ret == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+		/* every job is suspended, the cheapest way to preempt it */
+		for (n = 0; preempt_jobs_list[n] != NULL; n++) {
+			pbs_strncpy(ret[n].job_id, preempt_jobs_list[n], sizeof(ret[n].job_id));
+			strcpy(ret[n].order, "S");
+			snapshot_decision("preempt", preempt_jobs_list[n], "S");
+		}
+		return ret;
+	}
+
+	read_run_job_replies(0);
+
     ret = pbs_preempt_jobs(virtual_sd, preempt_jobs_list);
 
 	if (handle_part_tolerance(ret) == NULL) {
@@ -205,6 +377,13 @@ send_sigjob(int virtual_sd, resource_resv *resresv, const char *signal, char *ex
 {
 	int ret = 0;
 
+	if (snapshot_replaying()) {
+		snapshot_decision("signal", resresv->name, signal);
+		return 0;
+	}
+
+	read_run_job_replies(0);
+
 	ret = pbs_sigjob(get_svr_inst_fd(virtual_sd, resresv->svr_inst_id),
 			  const_cast<char *>(resresv->name.c_str()), const_cast<char *>(signal), extend);
 
@@ -232,6 +411,13 @@ send_confirmresv(int virtual_sd, resource_resv *resv, const char *location, unsi
 {
 	int ret = 0;
 
+	if (snapshot_replaying()) {
+		snapshot_decision("confirm", resv->name, location);
+		return 0;
+	}
+
+	read_run_job_replies(0);
+
 	ret = pbs_confirmresv(get_svr_inst_fd(virtual_sd, resv->svr_inst_id),
 		const_cast<char *>(resv->name.c_str()), const_cast<char *>(location), start, const_cast<char *>(extend));	
 
@@ -241,6 +427,25 @@ send_confirmresv(int virtual_sd, resource_resv *resv, const char *location, unsi
 	return ret;
 }
 
+/**
+ * @brief	find the queue a selstat is for
+ *
+ * @param[in]	attrib	-	the selection criteria
+ *
+ * @return	const char *
+ * @retval	the queue name
+ * @retval	NULL	: not limited to a queue
+ */
+static const char *
+selstat_queue(struct attropl *attrib)
+{
+	for (auto cur = attrib; cur != NULL; cur = cur->next)
+		if (strcmp(cur->name, ATTR_q) == 0)
+			return cur->value;
+
+	return NULL;
+}
+
 /**
  * @brief	Wrapper for pbs_selstat
  *
@@ -256,12 +461,20 @@ send_confirmresv(int virtual_sd, resource_resv *resv, const char *location, unsi
 struct batch_status *
 send_selstat(int virtual_fd, struct attropl *attrib, struct attrl *rattrib, char *extend)
 {
+	const char *queue = selstat_queue(attrib);
+
+	if (snapshot_replaying())
+		return snapshot_reply(SNAP_JOB, queue);
+
+	read_run_job_replies(0);
 	auto ret = pbs_selstat(virtual_fd, attrib, rattrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
 
+	snapshot_capture(SNAP_JOB, queue, ret);
+
 	return ret;
 }
 
@@ -280,12 +493,18 @@ send_selstat(int virtual_fd, struct attropl *attrib, struct attrl *rattrib, char
 struct batch_status *
 send_statvnode(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
+	if (snapshot_replaying())
+		return snapshot_reply(SNAP_NODE, id);
+
+	read_run_job_replies(0);
 	auto ret = pbs_statvnode(virtual_fd, id, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
 
+	snapshot_capture(SNAP_NODE, id, ret);
+
 	return ret;
 }
 
@@ -303,12 +522,18 @@ send_statvnode(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statsched(int virtual_fd, struct attrl *attrib, char *extend)
 {
+	if (snapshot_replaying())
+		return snapshot_reply(SNAP_SCHED, NULL);
+
+	read_run_job_replies(0);
 	auto ret = pbs_statsched(virtual_fd, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
 
+	snapshot_capture(SNAP_SCHED, NULL, ret);
+
 	return ret;
 }
 
@@ -327,12 +552,18 @@ send_statsched(int virtual_fd, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statqueue(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
+	if (snapshot_replaying())
+		return snapshot_reply(SNAP_QUEUE, id);
+
+	read_run_job_replies(0);
 	auto ret = pbs_statque(virtual_fd, id, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
 
+	snapshot_capture(SNAP_QUEUE, id, ret);
+
 	return ret;
 }
 
@@ -350,12 +581,18 @@ send_statqueue(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statserver(int virtual_fd, struct attrl *attrib, char *extend)
 {
+	if (snapshot_replaying())
+		return snapshot_reply(SNAP_SERVER, NULL);
+
+	read_run_job_replies(0);
 	auto ret = pbs_statserver(virtual_fd, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
 
+	snapshot_capture(SNAP_SERVER, NULL, ret);
+
 	return ret;
 }
 
@@ -374,12 +611,18 @@ send_statserver(int virtual_fd, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statrsc(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
+	if (snapshot_replaying())
+		return snapshot_reply(SNAP_RSC, id);
+
+	read_run_job_replies(0);
 	auto ret = pbs_statrsc(virtual_fd, id, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
 
+	snapshot_capture(SNAP_RSC, id, ret);
+
 	return ret;
 }
 
@@ -398,11 +641,17 @@ send_statrsc(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 struct batch_status *
 send_statresv(int virtual_fd, char *id, struct attrl *attrib, char *extend)
 {
+	if (snapshot_replaying())
+		return snapshot_reply(SNAP_RESV, id);
+
+	read_run_job_replies(0);
 	auto ret = pbs_statresv(virtual_fd, id, attrib, extend);
 	if (handle_part_tolerance(ret) == NULL) {
 		pbs_statfree(ret);
 		return NULL;
 	}
 
+	snapshot_capture(SNAP_RESV, id, ret);
+
 	return ret;
 }
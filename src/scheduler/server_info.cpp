@@ -84,6 +84,7 @@
  * 	dup_counts()
  * 	dup_counts_list()
  * 	find_counts()
+ * 	index_counts_list()
  * 	find_alloc_counts()
  * 	update_counts_on_run()
  * 	update_counts_on_end()
@@ -114,6 +115,9 @@
 #include <errno.h>
 #include <ctype.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 #include <sys/wait.h>
 
 #include "pbs_entlim.h"
@@ -145,6 +149,7 @@
 #include "check.h"
 #include "fifo.h"
 #include "buckets.h"
+#include "profile.h"
 #include "parse.h"
 #include "hook.h"
 #include "libpbs.h"
@@ -261,6 +266,12 @@ query_server(status *pol, int pbs_sd)
 		return NULL;
 	}
 
+	if (conf.incremental_query)
+		log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG, __func__,
+			"%d unchanged jobs cached for the next cycle", query_cache_sweep());
+	else if (!job_query_cache.empty())
+		free_query_cache();
+
 	if (sinfo->has_nodes_assoc_queue)
 		sinfo->unassoc_nodes =
 			node_filter(sinfo->nodes, sinfo->num_nodes, is_unassoc_node, NULL, 0);
@@ -466,13 +477,11 @@ query_server(status *pol, int pbs_sd)
 		free(np);
 	}
 
-	sinfo->buckets = create_node_buckets(policy, sinfo->nodes, sinfo->queues, UPDATE_BUCKET_IND);
+	prof_phase_start(PROF_BUCKETS);
+	sinfo->buckets = update_node_buckets(policy, sinfo->nodes, sinfo->queues);
+	prof_phase_end(PROF_BUCKETS);
 
-	if (sinfo->buckets != NULL) {
-		int ct;
-		ct = count_array(sinfo->buckets);
-		qsort(sinfo->buckets, ct, sizeof(node_bucket *), multi_bkt_sort);
-	}
+	sinfo->ntable = new_node_table(sinfo->unordered_nodes);
 
 	pbs_statfree(server);
 
@@ -664,10 +673,91 @@ query_server_info(status *pol, struct batch_status *server)
 	return sinfo;
 }
 
+/* a server_dyn_res script which is running */
+struct dyn_res_run {
+	const dyn_res *dr;
+	schd_resource *res;
+	pid_t pid;
+	int fd;			/* read end of the script's stdout */
+	int pipe_err;
+	std::string out;	/* first line of output so far */
+};
+
+/* last good output of each server_dyn_res script with a cache time */
+struct dyn_res_cached {
+	std::string value;
+	time_t expires;
+};
+static std::unordered_map<std::string, dyn_res_cached> dyn_res_cache;
+
+/**
+ * @brief
+ * 		start a server_dyn_res script with its stdout connected to a pipe
+ *
+ * @param[in,out]	run	-	the script to start.  pid, fd and pipe_err are set
+ *
+ * @return	void
+ */
+static void
+start_dyn_res(dyn_res_run& run)
+{
+	sigset_t allsigs;
+	int pdes[2];
+
+	run.pid = 0;
+	run.fd = -1;
+	run.pipe_err = errno = 0;
+
+	if (pipe(pdes) < 0) {
+		run.pipe_err = errno;
+		return;
+	}
+
+	switch (run.pid = fork()) {
+		case -1:	/* error */
+			close(pdes[0]);
+			close(pdes[1]);
+			run.pipe_err = errno;
+			run.pid = 0;
+			return;
+		case 0:		/* child */
+			close(pdes[0]);
+			if (pdes[1] != STDOUT_FILENO) {
+				dup2(pdes[1], STDOUT_FILENO);
+				close(pdes[1]);
+			}
+			setpgid(0, 0);
+			if (sigemptyset(&allsigs) == -1) {
+				log_err(errno, __func__, "sigemptyset failed");
+			}
+			if (sigprocmask(SIG_SETMASK, &allsigs, NULL) == -1) {	/* unblock all signals */
+				log_err(errno, __func__, "sigprocmask(UNBLOCK)");
+			}
+
+			char *argv[4];
+			argv[0] = const_cast<char *>("/bin/sh");
+			argv[1] = const_cast<char *>("-c");
+			argv[2] = const_cast<char *>(run.dr->command_line.c_str());
+			argv[3] = NULL;
+
+			execve("/bin/sh", argv, environ);
+			_exit(127);
+	}
+
+	/* parent: scripts started later must not inherit this pipe */
+	close(pdes[1]);
+	fcntl(pdes[0], F_SETFD, FD_CLOEXEC);
+	run.fd = pdes[0];
+}
+
 /**
  * @brief
  * 		execute all configured server_dyn_res scripts
  *
+ *		All scripts whose value is not cached are started at once, and
+ *		their first line of output is collected until they are done or
+ *		server_dyn_res_alarm runs out for all of them together.
+ *
  * @param[in]	sinfo	-	server info
  *
  * @retval	0	: on success
@@ -676,152 +766,171 @@ query_server_info(status *pol, struct batch_status *server)
 int
 query_server_dyn_res(server_info *sinfo)
 {
-	int k;
-	int pipe_err;
 	char res_zero[] = "0";	/* dynamic res failure implies resource <-0 */
 	schd_resource *res;		/* used for updating node resources */
-	FILE *fp;			/* for popen() for res_assn */
-
+	std::vector<dyn_res_run> runs;
+	time_t now = time(NULL);
 
 	for (const auto& dr : conf.dynamic_res) {
 		res = find_alloc_resource_by_str(sinfo->res, dr.res);
-		if (res != NULL) {
-			fd_set set;
-			sigset_t allsigs;
-			pid_t pid = 0;			/* pid of child */
-			int pdes[2];
-			char buf[256]; /* buffer for reading from pipe */
-			k = 0;
-			buf[0] = '\0';
+		if (res == NULL)
+			continue;
 
-			if (sinfo->res == NULL)
-				sinfo->res = res;
-
-			pipe_err = errno = 0;
-
-			/* Make sure file does not have open permissions */
-			#if !defined(DEBUG) && !defined(NO_SECURITY_CHECK)
-				int err;
-				err = tmp_file_sec_user(const_cast<char *>(dr.script_name.c_str()), 0, 1, S_IWGRP|S_IWOTH, 1, getuid());
-				if (err != 0) {
-					log_eventf(PBSEVENT_SECURITY, PBS_EVENTCLASS_SERVER, LOG_ERR, "server_dyn_res",
-						"error: %s file has a non-secure file access, setting resource %s to 0, errno: %d",
-						dr.script_name.c_str(), res->name, err);
-					set_resource(res, res_zero, RF_AVAIL);
-					continue;
-				}
-			#endif
+		if (sinfo->res == NULL)
+			sinfo->res = res;
 
-			if (pipe(pdes) < 0) {
-				pipe_err = errno;
+		if (dr.cache_time > 0) {
+			auto c = dyn_res_cache.find(dr.res + " " + dr.command_line);
+			if (c != dyn_res_cache.end() && c->second.expires > now) {
+				set_resource(res, const_cast<char *>(c->second.value.c_str()), RF_AVAIL);
+				log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
+					"%s = %s (cached)", dr.command_line.c_str(), res_to_str(res, RF_AVAIL));
+				continue;
 			}
-			if (!pipe_err) {
-				switch(pid = fork()) {
-				case -1:	/* error */
-					close(pdes[0]);
-					close(pdes[1]);
-					pipe_err = errno;
-					break;
-				case 0:		/* child */
-					close(pdes[0]);
-					if (pdes[1] != STDOUT_FILENO) {
-						dup2(pdes[1], STDOUT_FILENO);
-						close(pdes[1]);
-					}
-					setpgid(0, 0);
-					if (sigemptyset(&allsigs) == -1) {
-						log_err(errno, __func__, "sigemptyset failed");
-					}
-					if (sigprocmask(SIG_SETMASK, &allsigs, NULL) == -1) {	/* unblock all signals */
-						log_err(errno, __func__, "sigprocmask(UNBLOCK)");
-					}
+		}
 
-					char *argv[4];
-					argv[0] = const_cast<char *>("/bin/sh");
-					argv[1] = const_cast<char *>("-c");
-					argv[2] = const_cast<char *>(dr.command_line.c_str());
-					argv[3] = NULL;
+		/* Make sure file does not have open permissions */
+		#if !defined(DEBUG) && !defined(NO_SECURITY_CHECK)
+			int err;
+			err = tmp_file_sec_user(const_cast<char *>(dr.script_name.c_str()), 0, 1, S_IWGRP|S_IWOTH, 1, getuid());
+			if (err != 0) {
+				log_eventf(PBSEVENT_SECURITY, PBS_EVENTCLASS_SERVER, LOG_ERR, "server_dyn_res",
+					"error: %s file has a non-secure file access, setting resource %s to 0, errno: %d",
+					dr.script_name.c_str(), res->name, err);
+				set_resource(res, res_zero, RF_AVAIL);
+				continue;
+			}
+		#endif
 
-					execve("/bin/sh", argv, environ);
-					_exit(127);
-				}
+		dyn_res_run run;
+		run.dr = &dr;
+		run.res = res;
+		start_dyn_res(run);
+		runs.push_back(run);
+	}
+
+	if (runs.empty())
+		return 0;
+
+	/* collect output until every script finished its first line or the deadline passes */
+	time_t deadline = now + sc_attrs.server_dyn_res_alarm;
+	for (;;) {
+		std::vector<struct pollfd> pfds;
+		std::vector<dyn_res_run *> polled;
+		int timeout = -1;
+		int ret;
+
+		for (auto& run : runs) {
+			if (run.fd != -1) {
+				pfds.push_back({run.fd, POLLIN, 0});
+				polled.push_back(&run);
 			}
+		}
+		if (pfds.empty())
+			break;
 
-			k = 0;
-			if (!pipe_err) {
-				int ret;
-				FD_ZERO(&set);
-				FD_SET(pdes[0], &set);
-				if (sc_attrs.server_dyn_res_alarm) {
-					struct timeval timeout;
-					timeout.tv_sec = sc_attrs.server_dyn_res_alarm;
-					timeout.tv_usec = 0;
-					ret = select(FD_SETSIZE, &set, NULL, NULL, &timeout);
-				} else {
-					ret = select(FD_SETSIZE, &set, NULL, NULL, NULL);
-				}
-				if (ret == -1) {
-					log_eventf(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
-					"Select() failed for script %s", dr.command_line.c_str());
-				} else if (ret == 0) {
+		if (sc_attrs.server_dyn_res_alarm) {
+			time_t left = deadline - time(NULL);
+			if (left <= 0) {
+				for (auto run : polled)
 					log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
-					"Program %s timed out", dr.command_line.c_str());
-				}
-				if (pid > 0) {
-					close(pdes[1]);
-					if (ret > 0) {
-						/* Parent; only open if child created and select showed sth to read,
-						* but assume fdopen can't fail
-						*/
-						fp = fdopen(pdes[0], "r");
-						if (fgets(buf, sizeof(buf), fp) == NULL) {
-							pipe_err = errno;
-						} else
-							k = strlen(buf);
-						
-						fclose(fp);
-					} else
-						close(pdes[0]);
-				}
+						"Program %s timed out", run->dr->command_line.c_str());
+				break;
 			}
+			timeout = left * 1000;
+		}
 
-			if (k > 0) {
-				buf[k] = '\0';
-				/* chop \r or \n from buf so that is_num() doesn't think it's a str */
-				while (--k) {
-					if ((buf[k] != '\n') && (buf[k] != '\r'))
-						break;
-					buf[k] = '\0';
-				}
-				if (set_resource(res, buf, RF_AVAIL) == 0) {
-					log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
-						"Script %s returned bad output", dr.command_line.c_str());
-					(void) set_resource(res, res_zero, RF_AVAIL);
-				}
-			} else {
-				if (pipe_err != 0)
-					log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
-						"Can't pipe to program %s: %s", dr.command_line.c_str(), strerror(pipe_err));
+		ret = poll(pfds.data(), pfds.size(), timeout);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			for (auto run : polled)
+				log_eventf(PBSEVENT_ERROR, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
+					"Select() failed for script %s", run->dr->command_line.c_str());
+			break;
+		}
+
+		for (size_t i = 0; i < pfds.size(); i++) {
+			dyn_res_run *run = polled[i];
+			char buf[256];
+			ssize_t n;
+
+			if (pfds[i].revents == 0)
+				continue;
+
+			n = read(run->fd, buf, sizeof(buf) - 1);
+			if (n > 0)
+				run->out.append(buf, n);
+			else if (n < 0)
+				run->pipe_err = errno;
+
+			/* only the first line is used, like fgets() would read it */
+			auto nl = run->out.find('\n');
+			if (n <= 0 || nl != std::string::npos || run->out.size() >= sizeof(buf) - 1) {
+				if (nl != std::string::npos)
+					run->out.resize(nl + 1);
+				if (run->out.size() > sizeof(buf) - 1)
+					run->out.resize(sizeof(buf) - 1);
+				close(run->fd);
+				run->fd = -1;
+			}
+		}
+	}
+
+	for (auto& run : runs) {
+		std::string& buf = run.out;
+
+		res = run.res;
+		/* output of a script which ran out of time is not used */
+		if (run.fd != -1) {
+			close(run.fd);
+			run.fd = -1;
+			buf.clear();
+		}
+
+		if (!buf.empty()) {
+			/* chop \r or \n from buf so that is_num() doesn't think it's a str */
+			while (buf.size() > 1 && (buf.back() == '\n' || buf.back() == '\r'))
+				buf.pop_back();
+			if (set_resource(res, const_cast<char *>(buf.c_str()), RF_AVAIL) == 0) {
 				log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
-					"Setting resource %s to 0", res->name);
+					"Script %s returned bad output", run.dr->command_line.c_str());
 				(void) set_resource(res, res_zero, RF_AVAIL);
-			}
-			if (res->type.is_non_consumable)
-				log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
-					"%s = %s", dr.command_line.c_str(), res_to_str(res, RF_AVAIL));
+			} else if (run.dr->cache_time > 0)
+				dyn_res_cache[run.dr->res + " " + run.dr->command_line] = {buf, now + run.dr->cache_time};
+		} else {
+			if (run.pipe_err != 0)
+				log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
+					"Can't pipe to program %s: %s", run.dr->command_line.c_str(), strerror(run.pipe_err));
+			log_eventf(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
+				"Setting resource %s to 0", res->name);
+			(void) set_resource(res, res_zero, RF_AVAIL);
+		}
+		if (res->type.is_non_consumable)
+			log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
+				"%s = %s", run.dr->command_line.c_str(), res_to_str(res, RF_AVAIL));
+		else
+			log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
+				"%s = %s (\"%s\")", run.dr->command_line.c_str(), res_to_str(res, RF_AVAIL), buf.c_str());
+	}
+
+	/* give all the scripts one grace period together before killing them */
+	bool waiting = false;
+	for (auto& run : runs) {
+		if (run.pid > 0) {
+			kill(-run.pid, SIGTERM);
+			if (waitpid(run.pid, NULL, WNOHANG) == 0)
+				waiting = true;
 			else
-				log_eventf(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG, "server_dyn_res",
-					"%s = %s (\"%s\")", dr.command_line.c_str(), res_to_str(res, RF_AVAIL), buf);
-
-			if (pid > 0) {
-				kill(-pid, SIGTERM);
-				if (waitpid(pid, NULL, WNOHANG) == 0) {
-					usleep(250000);
-					if (waitpid(pid, NULL, WNOHANG) == 0) {
-						kill(-pid, SIGKILL);
-						waitpid(pid, NULL, 0);
-					}
-				}
+				run.pid = 0;
+		}
+	}
+	if (waiting) {
+		usleep(250000);
+		for (auto& run : runs) {
+			if (run.pid > 0 && waitpid(run.pid, NULL, WNOHANG) == 0) {
+				kill(-run.pid, SIGKILL);
+				waitpid(run.pid, NULL, 0);
 			}
 		}
 	}
@@ -851,20 +960,31 @@ find_alloc_resource(schd_resource *resplist, resdef *def)
 	if (def == NULL)
 		return NULL;
 
-	for (resp = resplist; resp != NULL && resp->def != def; resp = resp->next) {
-		prev = resp;
-	}
+	if ((resp = find_resource(resplist, def)) != NULL)
+		return resp;
 
-	if (resp == NULL) {
-		if ((resp = new_resource()) == NULL)
-			return NULL;
+	if (resplist != NULL)
+		prev = resplist->index != NULL ? resplist->index->tail : resplist;
+	for (; prev != NULL && prev->next != NULL; prev = prev->next)
+		;
 
-		resp->def = def;
-		resp->type = def->type;
-		resp->name = def->name.c_str();
+	if ((resp = new_resource()) == NULL)
+		return NULL;
 
-		if (prev != NULL)
-			prev->next = resp;
+	resp->def = def;
+	resp->type = def->type;
+	resp->name = def->name.c_str();
+
+	if (prev != NULL)
+		prev->next = resp;
+
+	if (resplist != NULL && resplist->index != NULL) {
+		res_index *ri = resplist->index;
+
+		if (def->idx < ri->size && ri->tail->next == resp) {
+			ri->res[def->idx] = resp;
+			ri->tail = resp;
+		}
 	}
 
 	return resp;
@@ -960,11 +1080,20 @@ schd_resource *
 find_resource(schd_resource *reslist, resdef *def)
 {
 	schd_resource *resp;
+	res_index *ri;
 
 	if (reslist == NULL || def == NULL)
 		return NULL;
 
-	resp = reslist;
+	ri = reslist->index;
+	if (ri != NULL && def->idx < ri->size && ri->res[def->idx] == NULL)
+		/* only resources added since the list was indexed are left */
+		resp = ri->tail->next;
+	else if (ri != NULL && def->idx < ri->size && ri->res[def->idx]->def == def)
+		return ri->res[def->idx];
+	else
+		/* not indexed, or indexed against other resource definitions */
+		resp = reslist;
 
 	while (resp != NULL && resp->def != def)
 		resp = resp->next;
@@ -972,6 +1101,80 @@ find_resource(schd_resource *reslist, resdef *def)
 	return resp;
 }
 
+/**
+ * @brief
+ * 		build a lookup index on the head of a resource list so
+ *		find_resource() does not have to walk the list.  Resources
+ *		appended to the list later are still found, but only
+ *		find_alloc_resource() adds them to the index.
+ *
+ * @note	Resources must not be removed from an indexed list
+ *
+ * @param[in,out]	reslist - the resource list to index
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure (the list is left unindexed)
+ *
+ * @par MT-Safe:	no
+ */
+int
+index_resource_list(schd_resource *reslist)
+{
+	res_index *ri;
+	schd_resource *resp;
+
+	if (reslist == NULL)
+		return 0;
+
+	free_resource_index(reslist);
+
+	if (num_resdefs == 0)
+		return 0;
+
+	if ((ri = static_cast<res_index *>(malloc(sizeof(res_index)))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return 0;
+	}
+
+	if ((ri->res = static_cast<schd_resource **>(calloc(num_resdefs, sizeof(schd_resource *)))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free(ri);
+		return 0;
+	}
+	ri->size = num_resdefs;
+
+	for (resp = reslist; resp != NULL; resp = resp->next) {
+		if (resp->def != NULL && resp->def->idx < ri->size &&
+		    ri->res[resp->def->idx] == NULL)
+			ri->res[resp->def->idx] = resp;
+		ri->tail = resp;
+	}
+
+	reslist->index = ri;
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		free the lookup index of a resource list
+ *
+ * @param[in,out]	reslist - the head of the resource list
+ *
+ * @return	void
+ */
+void
+free_resource_index(schd_resource *reslist)
+{
+	if (reslist == NULL || reslist->index == NULL)
+		return;
+
+	free(reslist->index->res);
+	free(reslist->index);
+	reslist->index = NULL;
+}
+
 /**
  * @brief	free the sinfo->svr_to_psets map
  * 			Note: this won't be needed once we convert node_partition to a class
@@ -1078,7 +1281,7 @@ free_server_info(server_info *sinfo)
 		free_event_list(sinfo->calendar);
 	if (sinfo->policy != NULL)
 		delete sinfo->policy;
-	if (sinfo->fstree != NULL)
+	if (sinfo->fstree != NULL && !sinfo->fstree_shared)
 		delete sinfo->fstree;
 	if (sinfo->liminfo != NULL) {
 		lim_free_liminfo(sinfo->liminfo);
@@ -1094,6 +1297,8 @@ free_server_info(server_info *sinfo)
 	if(sinfo->unordered_nodes != NULL)
 		free(sinfo->unordered_nodes);
 
+	free_node_table(sinfo->ntable);
+
 	free_resource_list(sinfo->res);
 	free(sinfo->job_sort_formula);
 
@@ -1158,6 +1363,8 @@ free_resource(schd_resource *resp)
 	if (resp->str_assigned != NULL)
 		free(resp->str_assigned);
 
+	free_resource_index(resp);
+
 	free(resp);
 }
 
@@ -1204,6 +1411,7 @@ new_server_info(int limallocflag)
 	sinfo->power_provisioning = 0;
 	sinfo->use_hard_duration = 0;
 	sinfo->pset_metadata_stale = 0;
+	sinfo->fstree_shared = 0;
 	sinfo->num_parts = 0;
 	sinfo->name = NULL;
 	sinfo->res = NULL;
@@ -1237,6 +1445,7 @@ new_server_info(int limallocflag)
 	sinfo->equiv_classes = NULL;
 	sinfo->buckets = NULL;
 	sinfo->unordered_nodes = NULL;
+	sinfo->ntable = NULL;
 	sinfo->num_queues = 0;
 	sinfo->num_nodes = 0;
 	sinfo->num_resvs = 0;
@@ -1286,6 +1495,7 @@ new_resource()
 	resp->indirect_res = NULL;
 	resp->str_avail = NULL;
 	resp->str_assigned = NULL;
+	resp->index = NULL;
 	resp->assigned = RES_DEFAULT_ASSN;
 	resp->avail = RES_DEFAULT_AVAIL;
 
@@ -1709,16 +1919,13 @@ update_server_on_run(status *policy, server_info *sinfo,
 
 				resv_nodes = resresv->job->resv->resv->resv_nodes;
 				num_resv_nodes = count_array(resv_nodes);
-				qsort(resv_nodes, num_resv_nodes, sizeof(node_info *),
-					multi_node_sort);
+				resort_nodes(resv_nodes, num_resv_nodes);
 			} else {
-				qsort(sinfo->nodes, sinfo->num_nodes, sizeof(node_info *),
-					multi_node_sort);
+				resort_nodes(sinfo->nodes, sinfo->num_nodes);
 
 				if (sinfo->nodes != sinfo->unassoc_nodes) {
 					auto num_unassoc = count_array(sinfo->unassoc_nodes);
-					qsort(sinfo->unassoc_nodes, num_unassoc, sizeof(node_info *),
-						multi_node_sort);
+					resort_nodes(sinfo->unassoc_nodes, num_unassoc);
 				}
 			}
 		}
@@ -2175,6 +2382,11 @@ check_resv_running_on_node(resource_resv *resv, const void *arg)
  * @brief
  * 		dup_server_info - duplicate a server_info struct
  *
+ *		Only the fairshare tree is shared copy-on-write with osinfo
+ *		(see unshare_fairshare_tree()).  Nodes, jobs, reservations
+ *		and queues are deep copied: the simulation code changes them
+ *		in place and points at them from each other.
+ *
  * @param[in]	osinfo	-	the struct to copy
  *
  * @return	duplicated server_info
@@ -2195,12 +2407,13 @@ dup_server_info(server_info *osinfo)
 	if ((nsinfo = new_server_info(0)) == NULL)
 		return NULL;
 
+	/* The fairshare tree is borrowed from osinfo.  It is only read while
+	 * simulating until a job is run.  At that point update_usage_on_run()
+	 * will give nsinfo its own copy.
+	 */
 	if (osinfo->fstree != NULL) {
-		nsinfo->fstree = new fairshare_head(*osinfo->fstree);
-		if (nsinfo->fstree == NULL) {
-			free_server(nsinfo);
-			return NULL;
-		}
+		nsinfo->fstree = osinfo->fstree;
+		nsinfo->fstree_shared = 1;
 	}
 	nsinfo->has_mult_express = osinfo->has_mult_express;
 	nsinfo->has_soft_limit = osinfo->has_soft_limit;
@@ -2394,6 +2607,9 @@ dup_server_info(server_info *osinfo)
 	/* Copy the map of server psets */
 	nsinfo->svr_to_psets = dup_server_psets(osinfo->svr_to_psets, nsinfo);
 
+	if (osinfo->ntable != NULL)
+		nsinfo->ntable = new_node_table(nsinfo->unordered_nodes);
+
 	return nsinfo;
 }
 
@@ -2624,6 +2840,7 @@ new_counts(void)
 	cts->rescts = NULL;
 	cts->soft_limit_preempt_bit = 0;
 	cts->next = NULL;
+	cts->index = NULL;
 
 	return cts;
 }
@@ -2650,6 +2867,7 @@ free_counts(counts *cts)
 	if (cts->rescts != NULL)
 		free_resource_count_list(cts->rescts);
 
+	delete cts->index;
 	cts->next = NULL;
 
 	free(cts);
@@ -2767,18 +2985,55 @@ counts *
 find_counts(counts *ctslist, const char *name)
 {
 	counts *cur;
+	int len = 0;
 
 	if (ctslist == NULL || name == NULL)
 		return NULL;
 
+	if (ctslist->index != NULL) {
+		auto it = ctslist->index->find(name);
+		if (it == ctslist->index->end())
+			return NULL;
+		return it->second;
+	}
+
 	cur = ctslist;
 
-	while (cur != NULL && strcmp(cur->name, name))
+	while (cur != NULL && strcmp(cur->name, name)) {
 		cur = cur->next;
+		len++;
+	}
+
+	/* index long lists so later lookups don't walk them again */
+	if (len >= COUNTS_INDEX_MIN)
+		index_counts_list(ctslist);
 
 	return cur;
 }
 
+/**
+ * @brief
+ * 		index_counts_list - build the hash index of a counts list on its head
+ *
+ * @param[in,out]	ctslist - the counts list to index
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+index_counts_list(counts *ctslist)
+{
+	counts *cur;
+
+	if (ctslist == NULL || ctslist->index != NULL)
+		return;
+
+	ctslist->index = new std::unordered_map<std::string, counts *>;
+	for (cur = ctslist; cur != NULL; cur = cur->next)
+		ctslist->index->emplace(cur->name, cur);
+}
+
 /**
  * @brief
  * 		find_alloc_counts - find a counts structure by name or allocate
@@ -2801,6 +3056,21 @@ find_alloc_counts(counts *ctslist, const char *name)
 	if (name == NULL)
 		return NULL;
 
+	/* an indexed list: no need to walk to the end, add right after the head */
+	if (ctslist != NULL && ctslist->index != NULL) {
+		if ((cur = find_counts(ctslist, name)) != NULL)
+			return cur;
+
+		ncounts = new_counts();
+		if (ncounts != NULL) {
+			ncounts->name = string_dup(name);
+			ncounts->next = ctslist->next;
+			ctslist->next = ncounts;
+			(*ctslist->index)[ncounts->name] = ncounts;
+		}
+		return ncounts;
+	}
+
 	prev = cur = ctslist;
 
 	while (cur != NULL && strcmp(cur->name, name)) {
@@ -2923,7 +3193,7 @@ counts_max(counts *cmax, counts *ncounts)
 	cmax_head = cmax;
 
 	for (cur = ncounts; cur != NULL; cur = cur->next) {
-		cur_fmax = find_counts(cmax, cur->name);
+		cur_fmax = find_counts(cmax_head, cur->name);
 		if (cur_fmax == NULL) {
 			cur_fmax = dup_counts(cur);
 			if (cur_fmax == NULL) {
@@ -2932,6 +3202,12 @@ counts_max(counts *cmax, counts *ncounts)
 			}
 
 			cur_fmax->next = cmax_head;
+			/* the index belongs to the head of the list */
+			if (cmax_head->index != NULL) {
+				cur_fmax->index = cmax_head->index;
+				cmax_head->index = NULL;
+				(*cur_fmax->index)[cur_fmax->name] = cur_fmax;
+			}
 			cmax_head = cur_fmax;
 		} else {
 			if (cur->running > cur_fmax->running)
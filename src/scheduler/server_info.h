@@ -88,6 +88,12 @@ schd_resource *find_resource_by_str(schd_resource *reslist, const std::string& n
  */
 schd_resource *find_resource(schd_resource *reslist, resdef *def);
 
+/*
+ *	build/free a lookup index on the head of a resource list
+ */
+int index_resource_list(schd_resource *reslist);
+void free_resource_index(schd_resource *reslist);
+
 /*
  *	free_server_info - free the space used by a server_info structure
  */
@@ -272,6 +278,11 @@ counts *dup_counts_list(counts *ctslist);
  */
 counts *find_counts(counts *ctslist, const char *name);
 
+/*
+ *      index_counts_list - build the hash index of a counts list on its head
+ */
+void index_counts_list(counts *ctslist);
+
 /*
  *      find_alloc_counts - find a counts structure by name or allocate a new
  *                          counts, name it, and add it to the end of the list
@@ -58,6 +58,12 @@
  * 	perform_event()
  * 	exists_run_event()
  * 	calc_run_time()
+ * 	timeline_add_amounts()
+ * 	timeline_fits()
+ * 	new_resource_timeline()
+ * 	timeline_may_fit()
+ * 	timeline_advance()
+ * 	free_resource_timeline()
  * 	create_event_list()
  * 	create_events()
  * 	new_event_list()
@@ -69,6 +75,8 @@
  * 	dup_timed_event_list()
  * 	free_timed_event()
  * 	free_timed_event_list()
+ * 	index_event_list()
+ * 	insert_calendar_event()
  * 	add_event()
  * 	add_timed_event()
  * 	delete_event()
@@ -92,6 +100,9 @@
 #include <errno.h>
 #include <log.h>
 
+#include <unordered_map>
+#include <unordered_set>
+
 #include "simulate.h"
 #include "data_types.h"
 #include "resource_resv.h"
@@ -724,6 +735,8 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 	nspec **ns = NULL;
 	unsigned int ok_flags = NO_ALLPART;
 	queue_info *qinfo = NULL;
+	resource_timeline *timeline;
+	int skipped = 0;	/* the resresv wasn't checked after the last event */
 
 	if (name.empty() || sinfo == NULL)
 		return (time_t) -1;
@@ -747,6 +760,11 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 	if(err == NULL)
 		return (time_t) 0;
 
+	/* is_ok_to_run() is only worth calling at a point in the calendar
+	 * where enough of the resresv's node resources might be free
+	 */
+	timeline = new_resource_timeline(sinfo, resresv);
+
 	do {
 		/* policy is used from sinfo instead of being passed into calc_run_time()
 		 * because it's being simulated/updated in simulate_events()
@@ -754,12 +772,18 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 
 		auto desc = describe_simret(ret);
 		if (desc > 0 || (desc == 0 && policy_change_info(sinfo, resresv))) {
-			clear_schd_error(err);
-			ns = is_ok_to_run(sinfo->policy, sinfo, qinfo, resresv, ok_flags, err);
+			if (timeline_may_fit(timeline)) {
+				clear_schd_error(err);
+				ns = is_ok_to_run(sinfo->policy, sinfo, qinfo, resresv, ok_flags, err);
+				skipped = 0;
+			} else
+				skipped = 1;
 		}
 
-		if (ns == NULL) /* event can not run */
+		if (ns == NULL) { /* event can not run */
 			ret = simulate_events(sinfo->policy, sinfo, SIM_NEXT_EVENT, &sc_attrs.opt_backfill_fuzzy, &event_time);
+			timeline_advance(timeline, event_time);
+		}
 
 #ifdef NAS /* localmod 030 */
 		if (check_for_cycle_interrupt(0)) {
@@ -768,6 +792,8 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 #endif /* localmod 030 */
 	} while (ns == NULL && !(ret & (TIMED_NOEVENT|TIMED_ERROR)));
 
+	free_resource_timeline(timeline);
+
 #ifdef NAS /* localmod 030 */
 	if (check_for_cycle_interrupt(0) || (ret & TIMED_ERROR)) {
 #else
@@ -781,6 +807,11 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 
 	/* we can't run the job, but there are no timed events left to process */
 	if (ns == NULL && (ret & TIMED_NOEVENT)) {
+		/* the last check was skipped, find out why the resresv can't run */
+		if (skipped) {
+			clear_schd_error(err);
+			free_nspecs(is_ok_to_run(sinfo->policy, sinfo, qinfo, resresv, ok_flags, err));
+		}
 		schdlogerr(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, resresv->name,
 				"Can't find start time estimate", err);
 		free_schd_error(err);
@@ -825,6 +856,303 @@ calc_run_time(const std::string& name, server_info *sinfo, int flags)
 	return event_time;
 }
 
+/**
+ * @brief
+ * 		add (or with sign -1 subtract) the amounts of the timeline's
+ *		resources a resresv uses to the totals.  The amounts come from
+ *		the resresv's nspecs if it has any, otherwise from its select.
+ *
+ * @param[in]	tl	-	timeline whose resources to add
+ * @param[in]	resresv	-	resresv using the resources
+ * @param[in]	sign	-	1 to add, -1 to subtract
+ * @param[in,out] total	-	amounts to add to
+ *
+ * @return void
+ */
+static void
+timeline_add_amounts(resource_timeline *tl, resource_resv *resresv, int sign,
+	std::vector<sch_resource_t> &total)
+{
+	std::size_t i;
+	int j;
+
+	if (resresv->nspec_arr != NULL) {
+		for (j = 0; resresv->nspec_arr[j] != NULL; j++) {
+			for (i = 0; i < tl->defs.size(); i++) {
+				auto req = find_resource_req(resresv->nspec_arr[j]->resreq, tl->defs[i]);
+				if (req != NULL)
+					total[i] += sign * req->amount;
+			}
+		}
+	} else if (resresv->select != NULL) {
+		for (j = 0; resresv->select->chunks[j] != NULL; j++) {
+			for (i = 0; i < tl->defs.size(); i++) {
+				auto req = find_resource_req(resresv->select->chunks[j]->req, tl->defs[i]);
+				if (req != NULL)
+					total[i] += sign * req->amount * resresv->select->chunks[j]->num_chunks;
+			}
+		}
+	}
+}
+
+/**
+ * @brief
+ * 		can the timeline's request fit into the free amounts
+ *
+ * @param[in]	tl	-	timeline holding the request
+ * @param[in]	total	-	free amounts over all nodes
+ * @param[in]	hmax	-	most free on one host, or NULL to not check
+ *
+ * @return	bool
+ * @retval	true	: the request may fit
+ * @retval	false	: the request can not fit
+ */
+static bool
+timeline_fits(resource_timeline *tl, std::vector<sch_resource_t> &total,
+	std::vector<sch_resource_t> *hmax)
+{
+	std::size_t i;
+
+	for (i = 0; i < tl->defs.size(); i++) {
+		if (total[i] < tl->need_total[i])
+			return false;
+		if (hmax != NULL && (*hmax)[i] < tl->need_chunk[i])
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief
+ * 		build the free resource timeline of a job over the calendar.
+ *		At each event time it holds whether the job's consumable node
+ *		resources could fit into what is free on all nodes and whether
+ *		the largest chunk could fit on any one host.
+ *
+ * @par
+ *		The free amounts are upper bounds.  End events add back what a
+ *		resresv used.  Run events are only subtracted when the amounts
+ *		are known: for jobs outside of reservations which will be placed
+ *		by check_nodes() when they are simulated.  Per-host amounts only
+ *		ever grow.  Resources which are not checked, are indirect or are
+ *		unset on a node are not tracked.
+ *
+ * @param[in]	sinfo	-	server whose calendar to use
+ * @param[in]	resresv	-	the job to build the timeline for
+ *
+ * @return	resource_timeline *
+ * @retval	NULL	: nothing to track or resresv is not a queued job.
+ *			  The job may fit anywhere in the calendar.
+ */
+resource_timeline *
+new_resource_timeline(server_info *sinfo, resource_resv *resresv)
+{
+	resource_timeline *tl;
+	std::unordered_map<node_partition *, std::size_t> host_ind;
+	std::unordered_set<resource_resv *> started;
+	std::unordered_set<resdef *> untracked;
+	std::vector<std::vector<sch_resource_t>> host_free;
+	std::vector<sch_resource_t> total;
+	std::vector<sch_resource_t> hmax;
+	bool check_hosts = true;
+	timed_event *te;
+	std::size_t i;
+	int j;
+
+	if (sinfo == NULL || resresv == NULL || sinfo->calendar == NULL)
+		return NULL;
+	if (!resresv->is_job || resresv->job == NULL || resresv->job->resv != NULL ||
+	    !resresv->job->is_queued || resresv->select == NULL)
+		return NULL;
+
+	tl = new resource_timeline();
+	tl->cur = 0;
+
+	for (auto def : resresv->select->defs) {
+		sch_resource_t amt_total = 0;
+		sch_resource_t amt_chunk = 0;
+
+		if (!def->type.is_consumable)
+			continue;
+		if (sinfo->policy->resdef_to_check.find(def) == sinfo->policy->resdef_to_check.end())
+			continue;
+		if (conf.ignore_res.find(def->name) != conf.ignore_res.end())
+			continue;
+
+		for (j = 0; resresv->select->chunks[j] != NULL; j++) {
+			auto req = find_resource_req(resresv->select->chunks[j]->req, def);
+			if (req != NULL) {
+				amt_total += req->amount * resresv->select->chunks[j]->num_chunks;
+				if (req->amount > amt_chunk)
+					amt_chunk = req->amount;
+			}
+		}
+		if (amt_chunk > 0) {
+			tl->defs.push_back(def);
+			tl->need_total.push_back(amt_total);
+			tl->need_chunk.push_back(amt_chunk);
+		}
+	}
+
+	/* what is free now */
+	total.assign(tl->defs.size(), 0);
+	for (j = 0; sinfo->nodes[j] != NULL; j++) {
+		node_info *node = sinfo->nodes[j];
+		std::size_t h = 0;
+
+		if (node->hostset == NULL)
+			check_hosts = false;
+		else {
+			auto it = host_ind.find(node->hostset);
+			if (it == host_ind.end()) {
+				h = host_free.size();
+				host_ind[node->hostset] = h;
+				host_free.emplace_back(tl->defs.size(), 0);
+			} else
+				h = it->second;
+		}
+
+		for (i = 0; i < tl->defs.size(); i++) {
+			auto res = find_resource(node->res, tl->defs[i]);
+			if (res == NULL)
+				continue;
+			if (res->indirect_res != NULL || res->avail == SCHD_INFINITY_RES) {
+				untracked.insert(tl->defs[i]);
+				continue;
+			}
+			total[i] += dynamic_avail(res);
+			if (node->hostset != NULL)
+				host_free[h][i] += dynamic_avail(res);
+		}
+	}
+
+	/* resources shared between vnodes or unset on some are not tracked */
+	for (i = 0; i < tl->defs.size(); ) {
+		if (untracked.find(tl->defs[i]) != untracked.end()) {
+			tl->defs.erase(tl->defs.begin() + i);
+			tl->need_total.erase(tl->need_total.begin() + i);
+			tl->need_chunk.erase(tl->need_chunk.begin() + i);
+			total.erase(total.begin() + i);
+			for (auto &hf : host_free)
+				hf.erase(hf.begin() + i);
+		} else
+			i++;
+	}
+
+	if (tl->defs.empty()) {
+		delete tl;
+		return NULL;
+	}
+
+	hmax.assign(tl->defs.size(), 0);
+	for (auto &hf : host_free)
+		for (i = 0; i < tl->defs.size(); i++)
+			if (hf[i] > hmax[i])
+				hmax[i] = hf[i];
+
+	tl->step_time.push_back(*sinfo->calendar->current_time);
+	tl->step_fits.push_back(timeline_fits(tl, total, check_hosts ? &hmax : NULL));
+
+	te = find_init_timed_event(sinfo->calendar->next_event, IGNORE_DISABLED_EVENTS,
+		TIMED_RUN_EVENT | TIMED_END_EVENT);
+	while (te != NULL) {
+		auto rr = static_cast<resource_resv *>(te->event_ptr);
+
+		if (te->event_type == TIMED_RUN_EVENT) {
+			started.insert(rr);
+			if (rr->is_job && rr->job != NULL && !rr->job->is_array &&
+			    rr->job->resv == NULL && rr->nspec_arr == NULL)
+				timeline_add_amounts(tl, rr, -1, total);
+		} else {
+			timeline_add_amounts(tl, rr, 1, total);
+			if (rr->nspec_arr != NULL) {
+				for (j = 0; rr->nspec_arr[j] != NULL; j++) {
+					auto ninfo = rr->nspec_arr[j]->ninfo;
+					if (ninfo == NULL || ninfo->hostset == NULL)
+						continue;
+					auto it = host_ind.find(ninfo->hostset);
+					if (it == host_ind.end())
+						continue;
+					for (i = 0; i < tl->defs.size(); i++) {
+						auto req = find_resource_req(rr->nspec_arr[j]->resreq, tl->defs[i]);
+						if (req == NULL)
+							continue;
+						host_free[it->second][i] += req->amount;
+						if (host_free[it->second][i] > hmax[i])
+							hmax[i] = host_free[it->second][i];
+					}
+				}
+			} else if (started.find(rr) == started.end())
+				/* don't know where this resresv is freeing its resources */
+				check_hosts = false;
+		}
+
+		auto next = find_next_timed_event(te, IGNORE_DISABLED_EVENTS,
+			TIMED_RUN_EVENT | TIMED_END_EVENT);
+		if (next == NULL || next->event_time != te->event_time) {
+			tl->step_time.push_back(te->event_time);
+			tl->step_fits.push_back(timeline_fits(tl, total, check_hosts ? &hmax : NULL));
+		}
+		te = next;
+	}
+
+	return tl;
+}
+
+/**
+ * @brief
+ * 		can the job fit at the timeline's current step
+ *
+ * @param[in]	tl	-	the timeline (NULL means no timeline)
+ *
+ * @return	int
+ * @retval	1	: the job may fit
+ * @retval	0	: the job can not fit
+ */
+int
+timeline_may_fit(resource_timeline *tl)
+{
+	if (tl == NULL)
+		return 1;
+
+	return tl->step_fits[tl->cur] ? 1 : 0;
+}
+
+/**
+ * @brief
+ * 		move a timeline up to the calendar's time after the events
+ *		up to and including time t have been simulated
+ *
+ * @param[in]	tl	-	the timeline
+ * @param[in]	t	-	time the calendar has been simulated to
+ *
+ * @return void
+ */
+void
+timeline_advance(resource_timeline *tl, time_t t)
+{
+	if (tl == NULL)
+		return;
+
+	while (tl->cur + 1 < tl->step_time.size() && tl->step_time[tl->cur + 1] <= t)
+		tl->cur++;
+}
+
+/**
+ * @brief
+ * 		resource_timeline destructor
+ *
+ * @param[in]	tl	-	the timeline to free
+ *
+ * @return void
+ */
+void
+free_resource_timeline(resource_timeline *tl)
+{
+	delete tl;
+}
+
 /**
  * @brief
  * 		create an event_list from running jobs and confirmed resvs
@@ -844,6 +1172,7 @@ create_event_list(server_info *sinfo)
 		return NULL;
 
 	elist->events = create_events(sinfo);
+	index_event_list(elist);
 
 	elist->next_event = elist->events;
 	elist->first_run_event = find_timed_event(elist->events, TIMED_RUN_EVENT);
@@ -853,10 +1182,69 @@ create_event_list(server_info *sinfo)
 	return elist;
 }
 
+/**
+ * @brief
+ * 		link a timed_event into the calendar's sorted list using the
+ *		time index rather than walking the list.  The placement is the
+ *		same as add_timed_event(): end events come first among events
+ *		at the same time and all other events go last.
+ *
+ * @param[in] calendar - event list with a time index
+ * @param[in] te       - timed event to link in
+ *
+ * @return void
+ */
+static void
+insert_calendar_event(event_list *calendar, timed_event *te)
+{
+	auto &index = *calendar->time_index;
+	auto it = index.lower_bound(te->event_time);
+	timed_event *before = NULL;	/* te goes in front of this event */
+	timed_event *after = NULL;	/* te goes behind this event */
+
+	if (it != index.end() && it->first == te->event_time) {
+		if (te->event_type == TIMED_END_EVENT) {
+			before = it->second.first;
+			it->second.first = te;
+		} else {
+			after = it->second.second;
+			it->second.second = te;
+		}
+	} else {
+		if (it != index.end())
+			before = it->second.first;
+		else if (it != index.begin())
+			after = std::prev(it)->second.second;
+		index.emplace_hint(it, te->event_time, std::make_pair(te, te));
+	}
+
+	if (before != NULL) {
+		te->next = before;
+		te->prev = before->prev;
+		if (before->prev != NULL)
+			before->prev->next = te;
+		else
+			calendar->events = te;
+		before->prev = te;
+	} else if (after != NULL) {
+		te->prev = after;
+		te->next = after->next;
+		if (after->next != NULL)
+			after->next->prev = te;
+		after->next = te;
+	} else {
+		te->prev = NULL;
+		te->next = NULL;
+		calendar->events = te;
+	}
+}
+
 /**
  * @brief
  *		create_events - creates an timed_event list from running jobs
- *			    and confirmed reservations
+ *			    and confirmed reservations.  The events are linked in
+ *			    through a local time index, so building the list does
+ *			    not walk it once per event.
  *
  * @param[in] sinfo - server universe to act upon
  *
@@ -874,6 +1262,10 @@ create_events(server_info *sinfo)
 	time_t 		end = 0;
 	resource_resv	**all_resresv_copy;
 	int		all_resresv_len;
+	std::map<time_t, std::pair<timed_event *, timed_event *>> index;
+	event_list	elist = {};
+
+	elist.time_index = &index;
 
 	/* create a temporary copy of all_resresv array which is sorted such that
 	 * the timed events are in the front of the array.
@@ -901,7 +1293,7 @@ create_events(server_info *sinfo)
 				errflag++;
 				break;
 			}
-			events = add_timed_event(events, te);
+			insert_calendar_event(&elist, te);
 		}
 
 		if (sinfo->use_hard_duration)
@@ -913,7 +1305,7 @@ create_events(server_info *sinfo)
 			errflag++;
 			break;
 		}
-		events = add_timed_event(events, te);
+		insert_calendar_event(&elist, te);
 	}
 
 	/* for nodes that are in state=sleep add a timed event */
@@ -926,10 +1318,12 @@ create_events(server_info *sinfo)
 				errflag++;
 				break;
 			}
-			events = add_timed_event(events, te);
+			insert_calendar_event(&elist, te);
 		}
 	}
 
+	events = elist.events;
+
 	/* A malloc error was encountered, free all allocated memory and return */
 	if (errflag > 0) {
 		free_timed_event_list(events);
@@ -963,6 +1357,7 @@ new_event_list()
 	elist->next_event = NULL;
 	elist->first_run_event = NULL;
 	elist->current_time = NULL;
+	elist->time_index = new std::map<time_t, std::pair<timed_event *, timed_event *>>();
 
 	return elist;
 }
@@ -999,6 +1394,7 @@ dup_event_list(event_list *oelist, server_info *nsinfo)
 			free_event_list(nelist);
 			return NULL;
 		}
+		index_event_list(nelist);
 	}
 
 	if (oelist->next_event != NULL) {
@@ -1041,6 +1437,7 @@ free_event_list(event_list *elist)
 		return;
 
 	free_timed_event_list(elist->events);
+	delete elist->time_index;
 	free(elist);
 }
 
@@ -1414,6 +1811,31 @@ free_timed_event_list(timed_event *te_list)
 	}
 }
 
+/**
+ * @brief
+ * 		rebuild the time index of an event_list from its events
+ *
+ * @param[in] elist - event list to index
+ *
+ * @return void
+ */
+void
+index_event_list(event_list *elist)
+{
+	timed_event *te;
+
+	if (elist == NULL || elist->time_index == NULL)
+		return;
+
+	elist->time_index->clear();
+	for (te = elist->events; te != NULL; te = te->next) {
+		auto &bounds = (*elist->time_index)[te->event_time];
+		if (bounds.first == NULL)
+			bounds.first = te;
+		bounds.second = te;
+	}
+}
+
 /**
  * @brief
  * 		add a timed_event to an event list
@@ -1439,7 +1861,10 @@ add_event(event_list *calendar, timed_event *te)
 	if (calendar->events == NULL)
 		events_is_null = 1;
 
-	calendar->events = add_timed_event(calendar->events, te);
+	if (calendar->time_index != NULL)
+		insert_calendar_event(calendar, te);
+	else
+		calendar->events = add_timed_event(calendar->events, te);
 
 	/* empty event list - the new event is the only event */
 	if (events_is_null)
@@ -1452,8 +1877,11 @@ add_event(event_list *calendar, timed_event *te)
 			if (te->event_time < calendar->next_event->event_time)
 				calendar->next_event = te;
 			else if (te->event_time == calendar->next_event->event_time) {
-				calendar->next_event =
-					find_timed_event(calendar->events, te->event_time);
+				if (calendar->time_index != NULL)
+					calendar->next_event = calendar->time_index->find(te->event_time)->second.first;
+				else
+					calendar->next_event =
+						find_timed_event(calendar->events, te->event_time);
 			}
 		}
 	}
@@ -1549,8 +1977,21 @@ delete_event(server_info *sinfo, timed_event *e)
 	if (calendar->next_event == e)
 		calendar->next_event = e->next;
 
+	/* no run event comes before the first one, so search on from e */
 	if (calendar->first_run_event == e)
-		calendar->first_run_event = find_timed_event(calendar->events, TIMED_RUN_EVENT);
+		calendar->first_run_event = find_timed_event(e->next, TIMED_RUN_EVENT);
+
+	if (calendar->time_index != NULL) {
+		auto it = calendar->time_index->find(e->event_time);
+		if (it != calendar->time_index->end()) {
+			if (it->second.first == e && it->second.second == e)
+				calendar->time_index->erase(it);
+			else if (it->second.first == e)
+				it->second.first = e->next;
+			else if (it->second.second == e)
+				it->second.second = e->prev;
+		}
+	}
 
 	if (e->prev == NULL)
 		calendar->events = e->next;
@@ -305,6 +305,12 @@ timed_event *find_event_by_name(timed_event *events, char *name);
  *      \return head of timed_event list
  */
 timed_event *add_timed_event(timed_event *events, timed_event *te);
+
+/*
+ *	index_event_list - rebuild the time index of an event_list from its events
+ */
+void index_event_list(event_list *elist);
+
 /*
  *
  *	add_event - add a timed_event to an event list
@@ -345,6 +351,32 @@ create_event(enum timed_event_types event_type,
  */
 time_t calc_run_time(const std::string& name, server_info *sinfo, int flags);
 
+/*
+ *	new_resource_timeline - build the free resource timeline of a job
+ *				over the calendar
+ *
+ *	  sinfo   - server whose calendar to use
+ *	  resresv - job to build the timeline for
+ *
+ *	return the timeline or NULL if the job may fit anywhere
+ */
+resource_timeline *new_resource_timeline(server_info *sinfo, resource_resv *resresv);
+
+/*
+ *	timeline_may_fit - can the job fit at the timeline's current step
+ */
+int timeline_may_fit(resource_timeline *tl);
+
+/*
+ *	timeline_advance - move a timeline up to the calendar's time
+ */
+void timeline_advance(resource_timeline *tl, time_t t);
+
+/*
+ *	free_resource_timeline - resource_timeline destructor
+ */
+void free_resource_timeline(resource_timeline *tl);
+
 /*
  *
  *	find_event_ptr - find the correct event pointer for the duplicated
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+/**
+ * @file    snapshot.cpp
+ *
+ * @brief
+ * 		snapshot.cpp - capture the server replies of a cycle and replay them
+ *
+ * Functions included are:
+ * 	snapshot_capture()
+ * 	snapshot_capture_start()
+ * 	snapshot_capture_end()
+ * 	snapshot_load()
+ * 	snapshot_replaying()
+ * 	snapshot_time()
+ * 	snapshot_sched_name()
+ * 	snapshot_reply()
+ * 	snapshot_decision()
+ * 	snapshot_decisions()
+ *
+ * A snapshot is a text file of tab separated records:
+ *	PBS_SCHED_SNAPSHOT <version>
+ *	T <time of the cycle>
+ *	N <scheduler name>
+ *	R <request> <key>		a reply; key is the queue name for jobs
+ *	O <name>			an object in the reply
+ *	A <name> <resource> <value>	an attribute of the object
+ * Tabs, newlines and backslashes in fields are escaped with a backslash.
+ */
+
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pbs_ifl.h>
+#include <pbs_error.h>
+#include <log.h>
+
+#include "constant.h"
+#include "config.h"
+#include "data_types.h"
+#include "globals.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC "PBS_SCHED_SNAPSHOT"
+#define SNAPSHOT_VERSION 1
+
+/* an attribute of a replayed object */
+struct snap_attr {
+	std::string name;
+	std::string resource;
+	std::string value;
+};
+
+/* an object of a replayed reply */
+struct snap_obj {
+	std::string name;
+	std::vector<snap_attr> attrs;
+};
+
+static const char *snap_req_names[SNAP_NUM_REQS] = {
+	"server",
+	"sched",
+	"queue",
+	"node",
+	"job",
+	"resv",
+	"rsc"
+};
+
+/* the last reply to requests which are not made every cycle */
+static std::string last_reply[SNAP_NUM_REQS];
+
+static FILE *capture_fp = NULL;
+
+static bool replaying = false;
+static time_t replay_time = 0;
+static std::string replay_sched_name;
+static std::map<std::pair<int, std::string>, std::vector<snap_obj>> replay_replies;
+static std::vector<std::string> decisions;
+
+/**
+ * @brief	append a field to a record, escaping tabs, newlines and backslashes
+ *
+ * @param[in,out]	rec	-	the record
+ * @param[in]	field	-	the field (NULL is written as an empty field)
+ *
+ * @return	void
+ */
+static void
+snap_add_field(std::string &rec, const char *field)
+{
+	rec += '\t';
+	if (field == NULL)
+		return;
+
+	for (const char *p = field; *p != '\0'; p++) {
+		switch (*p) {
+			case '\t':
+				rec += "\\t";
+				break;
+			case '\n':
+				rec += "\\n";
+				break;
+			case '\\':
+				rec += "\\\\";
+				break;
+			default:
+				rec += *p;
+		}
+	}
+}
+
+/**
+ * @brief	split a record into its unescaped fields
+ *
+ * @param[in]	line	-	the record without its newline
+ *
+ * @return	the fields of the record
+ */
+static std::vector<std::string>
+snap_split(const char *line)
+{
+	std::vector<std::string> fields(1);
+
+	for (const char *p = line; *p != '\0'; p++) {
+		if (*p == '\t')
+			fields.emplace_back();
+		else if (*p == '\\' && p[1] != '\0') {
+			p++;
+			if (*p == 't')
+				fields.back() += '\t';
+			else if (*p == 'n')
+				fields.back() += '\n';
+			else
+				fields.back() += *p;
+		} else
+			fields.back() += *p;
+	}
+
+	return fields;
+}
+
+/**
+ * @brief	format a reply from the server as snapshot records
+ *
+ * @param[in]	req	-	the request
+ * @param[in]	key	-	the key of the request (may be NULL)
+ * @param[in]	bs	-	the reply
+ *
+ * @return	the records
+ */
+static std::string
+snap_format(enum snapshot_req req, const char *key, struct batch_status *bs)
+{
+	std::string rec("R");
+
+	snap_add_field(rec, snap_req_names[req]);
+	snap_add_field(rec, key);
+	rec += '\n';
+
+	for (auto cur = bs; cur != NULL; cur = cur->next) {
+		rec += 'O';
+		snap_add_field(rec, cur->name);
+		rec += '\n';
+		for (auto attr = cur->attribs; attr != NULL; attr = attr->next) {
+			rec += 'A';
+			snap_add_field(rec, attr->name);
+			snap_add_field(rec, attr->resource);
+			snap_add_field(rec, attr->value);
+			rec += '\n';
+		}
+	}
+
+	return rec;
+}
+
+/**
+ * @brief	record a reply from the server.  The scheduler and resource
+ *		definitions are only queried when they change, so their last
+ *		reply is kept to start each snapshot with.
+ *
+ * @param[in]	req	-	the request
+ * @param[in]	key	-	the key of the request (may be NULL)
+ * @param[in]	bs	-	the reply
+ *
+ * @return	void
+ */
+void
+snapshot_capture(enum snapshot_req req, const char *key, struct batch_status *bs)
+{
+	if (req == SNAP_SCHED || req == SNAP_RSC)
+		last_reply[req] = snap_format(req, key, bs);
+	else if (capture_fp != NULL)
+		fputs(snap_format(req, key, bs).c_str(), capture_fp);
+}
+
+/**
+ * @brief	start writing a snapshot of the cycle if capture_snapshot is set
+ *
+ * @param[in]	now	-	the time of the cycle
+ *
+ * @return	void
+ */
+void
+snapshot_capture_start(time_t now)
+{
+	const char *tmpfile = SNAPSHOT_FILE ".new";
+
+	if (capture_fp != NULL || !conf.capture_snapshot || replaying)
+		return;
+
+	if ((capture_fp = fopen(tmpfile, "w")) == NULL) {
+		log_errf(errno, __func__, "Could not open %s", tmpfile);
+		return;
+	}
+
+	fprintf(capture_fp, "%s\t%d\nT\t%ld\n", SNAPSHOT_MAGIC, SNAPSHOT_VERSION, (long) now);
+	std::string rec("N");
+	snap_add_field(rec, sc_name);
+	rec += '\n';
+	fputs(rec.c_str(), capture_fp);
+	fputs(last_reply[SNAP_SCHED].c_str(), capture_fp);
+	fputs(last_reply[SNAP_RSC].c_str(), capture_fp);
+}
+
+/**
+ * @brief	finish the snapshot of the cycle and move it into place
+ *
+ * @return	void
+ */
+void
+snapshot_capture_end(void)
+{
+	const char *tmpfile = SNAPSHOT_FILE ".new";
+
+	if (capture_fp == NULL)
+		return;
+
+	if (fclose(capture_fp) != 0)
+		log_errf(errno, __func__, "Could not write %s", tmpfile);
+	else if (rename(tmpfile, SNAPSHOT_FILE) == -1)
+		log_errf(errno, __func__, "Could not rename %s", tmpfile);
+	capture_fp = NULL;
+}
+
+/**
+ * @brief	load a snapshot and answer the scheduler's requests from it
+ *
+ * @param[in]	file	-	the snapshot
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+int
+snapshot_load(const char *file)
+{
+	FILE *fp;
+	char *line = NULL;
+	size_t len = 0;
+	ssize_t n;
+	int lineno = 0;
+	std::vector<snap_obj> *reply = NULL;
+	int ok = 1;
+
+	if ((fp = fopen(file, "r")) == NULL) {
+		log_errf(errno, __func__, "Could not open %s", file);
+		return 0;
+	}
+
+	replay_replies.clear();
+	while (ok && (n = getline(&line, &len, fp)) != -1) {
+		lineno++;
+		if (n > 0 && line[n - 1] == '\n')
+			line[n - 1] = '\0';
+
+		auto fields = snap_split(line);
+		const std::string &tag = fields[0];
+
+		if (lineno == 1)
+			ok = tag == SNAPSHOT_MAGIC && fields.size() == 2 && atoi(fields[1].c_str()) == SNAPSHOT_VERSION;
+		else if (tag == "T" && fields.size() == 2)
+			replay_time = strtol(fields[1].c_str(), NULL, 10);
+		else if (tag == "N" && fields.size() == 2)
+			replay_sched_name = fields[1];
+		else if (tag == "R" && fields.size() == 3) {
+			int req;
+
+			for (req = 0; req < SNAP_NUM_REQS; req++)
+				if (fields[1] == snap_req_names[req])
+					break;
+			if (req == SNAP_NUM_REQS)
+				ok = 0;
+			else {
+				reply = &replay_replies[std::make_pair(req, fields[2])];
+				reply->clear();
+			}
+		} else if (tag == "O" && fields.size() == 2 && reply != NULL)
+			reply->push_back({fields[1], {}});
+		else if (tag == "A" && fields.size() == 4 && reply != NULL && !reply->empty())
+			reply->back().attrs.push_back({fields[1], fields[2], fields[3]});
+		else if (!tag.empty())
+			ok = 0;
+	}
+	free(line);
+	fclose(fp);
+
+	if (!ok) {
+		log_errf(-1, __func__, "%s: invalid snapshot at line %d", file, lineno);
+		replay_replies.clear();
+		return 0;
+	}
+
+	replaying = true;
+	return 1;
+}
+
+/**
+ * @brief	are we answering requests from a snapshot?
+ *
+ * @return	bool
+ */
+bool
+snapshot_replaying(void)
+{
+	return replaying;
+}
+
+/**
+ * @brief	the time of the cycle the snapshot was taken in
+ *
+ * @return	time_t
+ * @retval	0	: not replaying
+ */
+time_t
+snapshot_time(void)
+{
+	return replaying ? replay_time : 0;
+}
+
+/**
+ * @brief	the name of the scheduler which took the snapshot
+ *
+ * @return	const std::string &
+ */
+const std::string &
+snapshot_sched_name(void)
+{
+	return replay_sched_name;
+}
+
+/**
+ * @brief	answer a request from the snapshot
+ *
+ * @param[in]	req	-	the request
+ * @param[in]	key	-	the key of the request (may be NULL)
+ *
+ * @return	struct batch_status *
+ * @retval	a new copy of the recorded reply - free with pbs_statfree()
+ * @retval	NULL	: empty reply, not recorded, or malloc error
+ */
+struct batch_status *
+snapshot_reply(enum snapshot_req req, const char *key)
+{
+	struct batch_status *head = NULL;
+	struct batch_status **bsp = &head;
+
+	pbs_errno = PBSE_NONE;
+
+	auto it = replay_replies.find(std::make_pair(static_cast<int>(req), std::string(key == NULL ? "" : key)));
+	if (it == replay_replies.end())
+		return NULL;
+
+	for (const auto &obj : it->second) {
+		struct attrl **ap;
+
+		if ((*bsp = static_cast<batch_status *>(calloc(1, sizeof(struct batch_status)))) == NULL)
+			goto err;
+		if (((*bsp)->name = strdup(obj.name.c_str())) == NULL)
+			goto err;
+
+		ap = &(*bsp)->attribs;
+		for (const auto &sa : obj.attrs) {
+			if ((*ap = static_cast<attrl *>(calloc(1, sizeof(struct attrl)))) == NULL)
+				goto err;
+			(*ap)->op = SET;
+			if (((*ap)->name = strdup(sa.name.c_str())) == NULL)
+				goto err;
+			if (!sa.resource.empty() && ((*ap)->resource = strdup(sa.resource.c_str())) == NULL)
+				goto err;
+			if (((*ap)->value = strdup(sa.value.c_str())) == NULL)
+				goto err;
+			ap = &(*ap)->next;
+		}
+		bsp = &(*bsp)->next;
+	}
+
+	return head;
+
+err:
+	log_err(errno, __func__, MEM_ERR_MSG);
+	pbs_statfree(head);
+	pbs_errno = PBSE_SYSTEM;
+	return NULL;
+}
+
+/**
+ * @brief	record a request which would have changed the server
+ *
+ * @param[in]	action	-	what was done (e.g. "run")
+ * @param[in]	name	-	the object it was done to
+ * @param[in]	arg	-	argument of the action (may be NULL)
+ *
+ * @return	void
+ */
+void
+snapshot_decision(const char *action, const std::string &name, const char *arg)
+{
+	std::string d(action);
+
+	d += ' ';
+	d += name;
+	if (arg != NULL) {
+		d += ' ';
+		d += arg;
+	}
+	decisions.push_back(std::move(d));
+}
+
+/**
+ * @brief	the decisions recorded since the caller last cleared them
+ *
+ * @return	std::vector<std::string> &
+ */
+std::vector<std::string> &
+snapshot_decisions(void)
+{
+	return decisions;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 1994-2021 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of both the OpenPBS software ("OpenPBS")
+ * and the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * OpenPBS is free software. You can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * PBS Pro is commercially licensed software that shares a common core with
+ * the OpenPBS software.  For a copy of the commercial license terms and
+ * conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+ * Altair Legal Department.
+ *
+ * Altair's dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of OpenPBS and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair's trademarks, including but not limited to "PBS™",
+ * "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+ * subject to Altair's trademark licensing policies.
+ */
+#ifndef SRC_SCHEDULER_SNAPSHOT_H_
+#define SRC_SCHEDULER_SNAPSHOT_H_
+
+#include <string>
+#include <vector>
+#include <time.h>
+#include <pbs_ifl.h>
+#include "constant.h"
+
+/*
+ * Universe snapshots.  When capture_snapshot is set in the sched_config,
+ * every reply the scheduler gets from the server in a cycle is written to
+ * SNAPSHOT_FILE.  pbs_sched_replay loads a snapshot and answers the
+ * scheduler's requests from it instead of from a server.  While replaying,
+ * requests which change the server (run, preempt, ...) are recorded as
+ * decisions and always succeed.
+ */
+
+/* capture */
+void snapshot_capture(enum snapshot_req req, const char *key, struct batch_status *bs);
+void snapshot_capture_start(time_t now);
+void snapshot_capture_end(void);
+
+/* replay */
+int snapshot_load(const char *file);
+bool snapshot_replaying(void);
+time_t snapshot_time(void);
+const std::string &snapshot_sched_name(void);
+struct batch_status *snapshot_reply(enum snapshot_req req, const char *key);
+void snapshot_decision(const char *action, const std::string &name, const char *arg);
+std::vector<std::string> &snapshot_decisions(void);
+
+#endif /* SRC_SCHEDULER_SNAPSHOT_H_ */
@@ -68,6 +68,10 @@
  * 	cmp_node_host()
  * 	cmp_aoe()
  * 	cmp_job_preemption_time_asc()
+ * 	sort_job_array()
+ * 	resort_jobs()
+ * 	resort_nodes()
+ * 	resort_nodeparts()
  * 	sort_jobs()
  * 	swapfunc()
  * 	med3()
@@ -94,6 +98,10 @@
 #include "server_info.h"
 #include "resource.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #ifdef NAS
 #include "site_code.h"
 #endif
@@ -136,6 +144,7 @@ cmpres(sch_resource_t r1, sch_resource_t r2)
  *			total memory
  *			free cpus
  *			free memory
+ *			name
  *
  * @param[in]	v1	-	node partition 1
  * @param[in]	v2	-	node partition 2
@@ -191,6 +200,14 @@ cmp_placement_sets(const void *v1, const void *v2)
 			rc = cmpres(dynamic_avail(mem1), dynamic_avail(mem2));
 	}
 
+	/* The order of the sets going into the sort is kept from earlier cycles.
+	 * Break ties on the name so the result does not depend on that history.
+	 */
+	if (!rc) {
+		if (np1->name != NULL && np2->name != NULL)
+			rc = strcmp(np1->name, np2->name);
+	}
+
 	return rc;
 
 }
@@ -1151,6 +1168,153 @@ cmp_job_preemption_time_asc(const void *j1, const void *j2)
 	return 0;
 }
 
+/* a job and its sort keys, computed once before sorting */
+struct job_sort_ent {
+	resource_resv *resresv;
+	bool runnable;
+	unsigned int preempt;
+	time_t time_preempted;
+	float formula_value;
+	const sch_resource_t *keys;	/* values of the cstat.sort_by keys */
+};
+
+/**
+ * @brief
+ * 		compare two jobs by their precomputed sort keys.  Sorts the same
+ *		way as cmp_sort()
+ *
+ * @param[in]	e1	-	job 1
+ * @param[in]	e2	-	job 2
+ *
+ * @return	-1,0,1 : standard qsort() cmp
+ */
+static int
+cmp_job_sort_ent(const job_sort_ent& e1, const job_sort_ent& e2)
+{
+	size_t i;
+
+	if (e1.runnable != e2.runnable)
+		return e1.runnable ? -1 : 1;
+
+	/* preemption priority, high to low */
+	if (e1.preempt != e2.preempt)
+		return e1.preempt < e2.preempt ? 1 : -1;
+
+	/* preempted jobs first, the earliest preempted first */
+	if (e1.time_preempted != e2.time_preempted) {
+		if (e2.time_preempted == UNSPECIFIED)
+			return -1;
+		if (e1.time_preempted == UNSPECIFIED)
+			return 1;
+		return e1.time_preempted < e2.time_preempted ? -1 : 1;
+	}
+
+	/* job sort formula, high to low */
+	if (e1.formula_value < e2.formula_value)
+		return 1;
+	if (e1.formula_value > e2.formula_value)
+		return -1;
+
+#ifndef NAS /* localmod 041 */
+	if (e1.resresv->server->policy->fair_share) {
+		int cmp = cmp_fairshare(&e1.resresv, &e2.resresv);
+		if (cmp != 0)
+			return cmp;
+	}
+#endif /* localmod 041 */
+
+	for (i = 0; i < cstat.sort_by->size(); i++) {
+		sch_resource_t v1 = e1.keys[i];
+		sch_resource_t v2 = e2.keys[i];
+
+		if (v1 == v2)
+			continue;
+
+		if ((*cstat.sort_by)[i].order == ASC)
+			return v1 < v2 ? -1 : 1;
+		else
+			return v1 < v2 ? 1 : -1;
+	}
+
+	/* stabilize the sort */
+	if (e1.resresv->qrank != e2.resresv->qrank)
+		return e1.resresv->qrank < e2.resresv->qrank ? -1 : 1;
+	if (e1.resresv->rank != e2.resresv->rank)
+		return e1.resresv->rank < e2.resresv->rank ? -1 : 1;
+
+	return 0;
+}
+
+/**
+ * @brief
+ * 		look up a job's sort keys
+ *
+ * @param[out]	ent	-	entry to fill in
+ * @param[in]	resresv	-	the job
+ * @param[out]	keys	-	storage for the cstat.sort_by key values
+ *
+ * @return	void
+ */
+static void
+fill_job_sort_ent(job_sort_ent *ent, resource_resv *resresv, sch_resource_t *keys)
+{
+	size_t j;
+
+	ent->resresv = resresv;
+	ent->runnable = in_runnable_state(resresv);
+	ent->preempt = resresv->job->preempt;
+	ent->time_preempted = resresv->job->time_preempted;
+	ent->formula_value = resresv->job->formula_value;
+	ent->keys = keys;
+	for (j = 0; j < cstat.sort_by->size(); j++) {
+		const sort_info& si = (*cstat.sort_by)[j];
+		keys[j] = find_resresv_amount(resresv, si.res_name, si.def);
+	}
+}
+
+/**
+ * @brief
+ * 		sort an array of jobs the way qsort() with cmp_sort() would.
+ *		Each job's sort keys (the job_sort_key resources, the formula
+ *		value, preemption data, etc) are looked up once into a packed key
+ *		vector instead of at every comparison.
+ *
+ * @param[in,out]	jobs	-	the jobs to sort
+ * @param[in]	num_jobs	-	the number of jobs in jobs
+ *
+ * @return	void
+ */
+void
+sort_job_array(resource_resv **jobs, int num_jobs)
+{
+	size_t num_keys;
+	int i;
+
+	if (jobs == NULL || num_jobs < 2)
+		return;
+
+	for (i = 0; i < num_jobs; i++) {
+		/* something other than a job, let cmp_sort() sort it out */
+		if (jobs[i] == NULL || jobs[i]->job == NULL) {
+			qsort(jobs, num_jobs, sizeof(resource_resv *), cmp_sort);
+			return;
+		}
+	}
+
+	num_keys = cstat.sort_by->size();
+	std::vector<sch_resource_t> keys(num_jobs * num_keys);
+	std::vector<job_sort_ent> ents(num_jobs);
+
+	for (i = 0; i < num_jobs; i++)
+		fill_job_sort_ent(&ents[i], jobs[i], keys.data() + i * num_keys);
+
+	std::sort(ents.begin(), ents.end(),
+		[](const job_sort_ent& e1, const job_sort_ent& e2) { return cmp_job_sort_ent(e1, e2) < 0; });
+
+	for (i = 0; i < num_jobs; i++)
+		jobs[i] = ents[i].resresv;
+}
+
 /**
  * @brief
  * cmp_resv_state	- compare reservation state with RESV_BEING_ALTERED.
@@ -1180,6 +1344,308 @@ cmp_resv_state(const void *r1, const void *r2)
 		return 0;
 }
 
+/* a job array as it was when it was last sorted */
+struct sorted_array_state {
+	resource_resv **jobs;	/* the array */
+	int num_jobs;		/* number of jobs in the array */
+	int num_runnable;	/* number of runnable jobs at the front of the array */
+};
+
+/* arrays sorted by the last sort_jobs()/resort_jobs(), by owning server or queue */
+static std::unordered_map<const void *, sorted_array_state> sorted_arrays;
+/* temp_usage of the top level fairshare groups at the time of the last sort */
+static std::unordered_map<group_info *, usage_t> sorted_group_usage;
+
+/**
+ * @brief
+ * 		remember the state of a sorted job array for resort_jobs()
+ *
+ * @param[in]	owner	-	server or queue the array belongs to
+ * @param[in]	jobs	-	the sorted jobs
+ * @param[in]	num_jobs	-	the number of jobs
+ *
+ * @return	void
+ */
+static void
+record_sorted_array(const void *owner, resource_resv **jobs, int num_jobs)
+{
+	sorted_array_state st;
+
+	st.jobs = jobs;
+	st.num_jobs = num_jobs;
+	for (st.num_runnable = 0; st.num_runnable < num_jobs; st.num_runnable++)
+		if (!in_runnable_state(jobs[st.num_runnable]))
+			break;
+
+	sorted_arrays[owner] = st;
+}
+
+/**
+ * @brief
+ * 		remember the usage of the top level fairshare groups for resort_jobs()
+ *
+ * @param[in]	sinfo	-	the server
+ *
+ * @return	void
+ */
+static void
+record_sorted_group_usage(server_info *sinfo)
+{
+	group_info *g;
+
+	sorted_group_usage.clear();
+	if (sinfo->fstree == NULL || sinfo->fstree->root == NULL)
+		return;
+
+	for (g = sinfo->fstree->root->child; g != NULL; g = g->sibling)
+		sorted_group_usage[g] = g->temp_usage;
+}
+
+/**
+ * @brief
+ * 		has the usage of a job's fairshare entity changed since the last sort?
+ *		compare_path() never compares the root, so any change below the
+ *		root shows in the job's top level group.
+ *
+ * @param[in]	resresv	-	the job
+ *
+ * @return	bool
+ */
+static bool
+job_usage_changed(resource_resv *resresv)
+{
+	group_info *top;
+
+	if (resresv->job->ginfo == NULL || resresv->job->ginfo->gpath.size() < 2)
+		return false;
+
+	top = resresv->job->ginfo->gpath[1];
+	auto it = sorted_group_usage.find(top);
+	if (it == sorted_group_usage.end())
+		return true;
+
+	return it->second != top->temp_usage;
+}
+
+/**
+ * @brief
+ * 		re-sort a job array sorted by the last sort by repositioning only
+ *		the jobs whose sort keys have changed since then: jobs which became
+ *		unrunnable, new jobs (subjobs), and jobs whose fairshare usage
+ *		changed.  The other jobs keep their relative order.  The changed
+ *		jobs are sorted and merged back in with a binary search each.
+ *
+ * @param[in]	owner	-	server or queue the array belongs to
+ * @param[in,out]	jobs	-	the jobs
+ * @param[in]	num_jobs	-	the number of jobs
+ *
+ * @return	int
+ * @retval	1	: array resorted
+ * @retval	0	: array needs a full sort
+ */
+static int
+resort_job_array(const void *owner, resource_resv **jobs, int num_jobs)
+{
+	std::vector<resource_resv *> clean;
+	std::vector<resource_resv *> dirty;
+	size_t num_keys = cstat.sort_by->size();
+	std::vector<sch_resource_t> dkeys(num_keys);
+	std::vector<sch_resource_t> ckeys(num_keys);
+	job_sort_ent dent;
+	job_sort_ent cent;
+	size_t ci = 0;
+	size_t lo = 0;
+	int out = 0;
+	int i;
+
+	auto it = sorted_arrays.find(owner);
+	if (it == sorted_arrays.end() || it->second.jobs != jobs || num_jobs < it->second.num_jobs)
+		return 0;
+
+	clean.reserve(num_jobs);
+	for (i = 0; i < num_jobs; i++) {
+		resource_resv *resresv = jobs[i];
+
+		if (resresv == NULL || resresv->job == NULL)
+			return 0;
+
+		if (i >= it->second.num_jobs ||
+		    in_runnable_state(resresv) != (i < it->second.num_runnable) ||
+		    job_usage_changed(resresv))
+			dirty.push_back(resresv);
+		else
+			clean.push_back(resresv);
+	}
+
+	/* too much has changed, a full sort is cheaper */
+	if (dirty.size() > clean.size())
+		return 0;
+
+	if (!dirty.empty()) {
+		sort_job_array(dirty.data(), dirty.size());
+
+		for (auto d : dirty) {
+			size_t hi = clean.size();
+
+			fill_job_sort_ent(&dent, d, dkeys.data());
+			while (lo < hi) {
+				size_t mid = lo + (hi - lo) / 2;
+
+				fill_job_sort_ent(&cent, clean[mid], ckeys.data());
+				if (cmp_job_sort_ent(cent, dent) < 0)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			for (; ci < lo; ci++)
+				jobs[out++] = clean[ci];
+			jobs[out++] = d;
+		}
+		for (; ci < clean.size(); ci++)
+			jobs[out++] = clean[ci];
+	}
+
+	record_sorted_array(owner, jobs, num_jobs);
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		re-sort the jobs after a job has run without sorting everything again.
+ *		Only used when job order can only have changed by fairshare usage
+ *		or jobs becoming unrunnable (i.e., fairshare resorts between runs).
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in,out]	sinfo	-	server whose jobs to resort
+ *
+ * @return	int
+ * @retval	1	: jobs resorted
+ * @retval	0	: jobs need a full sort_jobs()
+ */
+int
+resort_jobs(status *policy, server_info *sinfo)
+{
+	if (!policy->fair_share)
+		return 0;
+
+	if (policy->by_queue || policy->round_robin) {
+		int job_index = 0;
+
+		for (int i = 0; i < sinfo->num_queues; i++) {
+			if (sinfo->queues[i]->sc.total > 0) {
+				if (!resort_job_array(sinfo->queues[i], sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total))
+					return 0;
+			}
+		}
+		for (int count = 0; count != sinfo->num_queues; count++) {
+			for (int index = 0; index < sinfo->queues[count]->sc.total; index++) {
+				sinfo->jobs[job_index] = sinfo->queues[count]->jobs[index];
+				job_index++;
+			}
+		}
+		sinfo->jobs[job_index] = NULL;
+	} else if (!resort_job_array(sinfo, sinfo->jobs, count_array(sinfo->jobs)))
+		return 0;
+
+	record_sorted_group_usage(sinfo);
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		re-sort an array which was sorted by cmp before some of its elements
+ *		changed.  Elements which are out of order are taken out, and the
+ *		rest, which is still in order, is kept as it is.  The taken out
+ *		elements are sorted and binary searched back into place.  The result
+ *		is fully sorted whatever the array looked like before, but only an
+ *		array which was nearly sorted is cheaper than qsort().
+ *
+ * @param[in,out]	arr	-	the array
+ * @param[in]	num	-	number of elements in arr
+ * @param[in]	cmp	-	qsort() compare function arr was sorted with
+ *
+ * @return	void
+ */
+template <typename T>
+static void
+resort_sorted_array(T **arr, int num, int (*cmp)(const void *, const void *))
+{
+	std::vector<T *> kept;
+	std::vector<T *> moved;
+	auto less = [cmp](T *a, T *b) { return cmp(&a, &b) < 0; };
+
+	if (arr == NULL || num < 2)
+		return;
+
+	kept.reserve(num);
+	for (int i = 0; i < num; i++) {
+		if (kept.empty() || !less(arr[i], kept.back())) {
+			kept.push_back(arr[i]);
+			continue;
+		}
+		/* If the next element is also before the last kept one, the last kept
+		 * one grew out of its place.  Otherwise this one shrank out of its place.
+		 */
+		if (i + 1 < num && less(arr[i + 1], kept.back())) {
+			moved.push_back(kept.back());
+			kept.pop_back();
+			i--;
+		} else
+			moved.push_back(arr[i]);
+	}
+
+	if (moved.empty())
+		return;
+
+	std::sort(moved.begin(), moved.end(), less);
+
+	int out = 0;
+	auto k = kept.begin();
+	for (auto m : moved) {
+		auto pos = std::upper_bound(k, kept.end(), m, less);
+		for (; k != pos; k++)
+			arr[out++] = *k;
+		arr[out++] = m;
+	}
+	for (; k != kept.end(); k++)
+		arr[out++] = *k;
+}
+
+/**
+ * @brief
+ * 		re-sort a node array by the node sort keys after some of its nodes'
+ *		resources changed.  Only the nodes which are out of order are moved.
+ *
+ * @param[in,out]	nodes	-	node array sorted with multi_node_sort()
+ * @param[in]	num_nodes	-	number of nodes in the array
+ *
+ * @return	void
+ */
+void
+resort_nodes(node_info **nodes, int num_nodes)
+{
+	resort_sorted_array(nodes, num_nodes, multi_node_sort);
+}
+
+/**
+ * @brief
+ * 		re-sort a node partition array after some of its partitions'
+ *		resources changed.  Only the partitions which are out of order are moved.
+ *
+ * @param[in,out]	nps	-	node partition array sorted with cmp
+ * @param[in]	num_parts	-	number of node partitions in the array
+ * @param[in]	cmp	-	compare function the array is sorted with
+ *
+ * @return	void
+ */
+void
+resort_nodeparts(node_partition **nps, int num_parts, int (*cmp)(const void *, const void *))
+{
+	resort_sorted_array(nps, num_parts, cmp);
+}
+
 /**
  * @brief
  * 		sort_jobs - This function sorts all jobs according to their preemption
@@ -1199,6 +1665,8 @@ sort_jobs(status *policy, server_info *sinfo)
 	/** sort jobs in such a way that Higher Priority jobs come on top
 	 * followed by preempted jobs and then normal jobs
 	 */
+	sorted_arrays.clear();
+	sorted_group_usage.clear();
 	if (policy->fair_share) {
 		/** sort per queue basis and then use these jobs (combined from all the queues)
 		 * to select the next job.
@@ -1210,8 +1678,8 @@ sort_jobs(status *policy, server_info *sinfo)
 			 */
 			for (int i = 0; i < sinfo->num_queues; i++) {
 				if (sinfo->queues[i]->sc.total > 0) {
-					qsort(sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total,
-						sizeof(resource_resv*), cmp_sort);
+					sort_job_array(sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total);
+					record_sorted_array(sinfo->queues[i], sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total);
 				}
 			}
 			for (int count = 0; count != sinfo->num_queues; count++) {
@@ -1224,14 +1692,16 @@ sort_jobs(status *policy, server_info *sinfo)
 		}
 		/** Sort on entire complex **/
 		else if (!policy->by_queue && !policy->round_robin) {
-			qsort(sinfo->jobs, count_array(sinfo->jobs), sizeof(resource_resv *), cmp_sort);
+			sort_job_array(sinfo->jobs, count_array(sinfo->jobs));
+			record_sorted_array(sinfo, sinfo->jobs, count_array(sinfo->jobs));
 		}
+		record_sorted_group_usage(sinfo);
 	}
 	else if (policy->by_queue) {
 		for (int i = 0; i < sinfo->num_queues; i++) {
-			qsort(sinfo->queues[i]->jobs, count_array(sinfo->queues[i]->jobs), sizeof(resource_resv *), cmp_sort);
+			sort_job_array(sinfo->queues[i]->jobs, count_array(sinfo->queues[i]->jobs));
 		}
-		qsort(sinfo->jobs, count_array(sinfo->jobs), sizeof(resource_resv*), cmp_sort);
+		sort_job_array(sinfo->jobs, count_array(sinfo->jobs));
 	}
 	else if (policy->round_robin) {
 		if (sinfo -> queue_list != NULL) {
@@ -1241,13 +1711,12 @@ sort_jobs(status *policy, server_info *sinfo)
 				int queue_index_size = count_array(sinfo->queue_list[i]);
 				for (int j = 0; j < queue_index_size; j++)
 				{
-					qsort(sinfo->queue_list[i][j]->jobs, count_array(sinfo->queue_list[i][j]->jobs),
-						sizeof(resource_resv *), cmp_sort);
+					sort_job_array(sinfo->queue_list[i][j]->jobs, count_array(sinfo->queue_list[i][j]->jobs));
 				}
 			}
 
 		}
 	}
 	else
-		qsort(sinfo->jobs, count_array(sinfo->jobs), sizeof(resource_resv*), cmp_sort);
+		sort_job_array(sinfo->jobs, count_array(sinfo->jobs));
 }
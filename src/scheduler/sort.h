@@ -186,6 +186,27 @@ int cmp_preemption(resource_resv *r1, resource_resv *r2);
  */
 int cmp_resv_state(const void *r1, const void *r2);
 
+/*
+ * sort_job_array - sort jobs like cmp_sort() with precomputed sort keys
+ */
+void sort_job_array(resource_resv **jobs, int num_jobs);
+
+/*
+ * resort_jobs - re-sort the jobs after a run by only moving jobs which changed
+ */
+int resort_jobs(status *policy, server_info *sinfo);
+
+/*
+ * resort_nodes - re-sort a sorted node array by only moving nodes which are out of order
+ */
+void resort_nodes(node_info **nodes, int num_nodes);
+
+/*
+ * resort_nodeparts - re-sort a sorted node partition array by only moving
+ *		      partitions which are out of order
+ */
+void resort_nodeparts(node_partition **nps, int num_parts, int (*cmp)(const void *, const void *));
+
 /*
  * sort_jobs - This function sorts all jobs according to their preemption
  *             priority, preempted time and fairshare.
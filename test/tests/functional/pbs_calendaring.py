@@ -228,3 +228,92 @@ class TestCalendaring(TestFunctional):
         est_time = job3[0]['estimated.start_time']
         est_time = time.mktime(time.strptime(est_time, '%c'))
         self.assertAlmostEqual(end_time, est_time, delta=1)
+
+    def test_topjob_start_after_calendared_job(self):
+        """
+        In this test we test that a top job is calendared after the
+        resources used by an earlier top job are freed, not when enough
+        running jobs have ended
+        """
+
+        self.scheduler.set_sched_config({'strict_ordering': 'true all'})
+        a = {'resources_available.ncpus': 3}
+        self.server.manager(MGR_CMD_SET, NODE, a, self.mom.shortname)
+        a = {'backfill_depth': '2'}
+        self.server.manager(MGR_CMD_SET, SERVER, a)
+        a = {'opt_backfill_fuzzy': 'off'}
+        self.server.manager(MGR_CMD_SET, SCHED, a)
+
+        jids = []
+        for wt in [30, 60, 90]:
+            res_req = {'Resource_List.select': '1:ncpus=1',
+                       'Resource_List.walltime': wt}
+            j = Job(TEST_USER, attrs=res_req)
+            j.set_sleep_time(wt)
+            jids.append(self.server.submit(j))
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, jid)
+
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        res_req = {'Resource_List.select': '1:ncpus=2',
+                   'Resource_List.walltime': 100}
+        j4 = Job(TEST_USER, attrs=res_req)
+        jid4 = self.server.submit(j4)
+        res_req = {'Resource_List.select': '1:ncpus=3',
+                   'Resource_List.walltime': 100}
+        j5 = Job(TEST_USER, attrs=res_req)
+        jid5 = self.server.submit(j5)
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+
+        self.server.expect(JOB, 'estimated.start_time', op=SET, id=jid4)
+        self.server.expect(JOB, 'estimated.start_time', op=SET, id=jid5)
+        job2 = self.server.status(JOB, id=jids[1])
+        job4 = self.server.status(JOB, id=jid4)
+        job5 = self.server.status(JOB, id=jid5)
+
+        stime2 = time.mktime(time.strptime(job2[0]['stime'], '%c'))
+        est4 = job4[0]['estimated.start_time']
+        est4 = time.mktime(time.strptime(est4, '%c'))
+        est5 = job5[0]['estimated.start_time']
+        est5 = time.mktime(time.strptime(est5, '%c'))
+        # j4 starts when the second running job ends and j5 can only start
+        # once j4 has ended, even though all running jobs end before that
+        self.assertAlmostEqual(stime2 + 60, est4, delta=1)
+        self.assertAlmostEqual(est4 + 100, est5, delta=1)
+
+    def test_end_before_run_at_same_time(self):
+        """
+        Test that when one reservation ends at the time the next one
+        starts, the calendar simulates the end before the start
+        """
+        self.scheduler.set_sched_config({'strict_ordering': 'true all'})
+        a = {'resources_available.ncpus': 1}
+        self.server.manager(MGR_CMD_SET, NODE, a, self.mom.shortname)
+        self.server.manager(MGR_CMD_SET, SCHED, {'log_events': 2047})
+
+        now = int(time.time())
+        rids = []
+        for start in [now + 1800, now + 3600]:
+            a = {'Resource_List.select': '1:ncpus=1',
+                 'reserve_start': start,
+                 'reserve_end': start + 1800}
+            r = Reservation(TEST_USER, attrs=a)
+            rid = self.server.submit(r)
+            exp = {'reserve_state': (MATCH_RE, 'RESV_CONFIRMED|2')}
+            self.server.expect(RESV, exp, id=rid)
+            rids.append(rid)
+
+        # The job can't finish before the first reservation, so it is
+        # calendared past both of them
+        t = time.time()
+        a = {'Resource_List.select': '1:ncpus=1',
+             'Resource_List.walltime': 7200}
+        j = Job(TEST_USER, attrs=a)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, 'estimated.start_time', op=SET, id=jid)
+
+        end_line, _ = self.scheduler.log_match(
+            rids[0] + ';Simulation: reservation end point', starttime=t)
+        start_line, _ = self.scheduler.log_match(
+            rids[1] + ';Simulation: reservation start point', starttime=t)
+        self.assertLess(end_line, start_line)
@@ -2127,3 +2127,28 @@ else:
                 break
         self.assertTrue(found, "%s didn't found in any sched cycle" % jidh)
         self.assertIn(jid2.split('.')[0], sched_cycle.sched_job_run)
+
+    def test_verdict_kept_across_cycles(self):
+        """
+        Test that an equivalence class which could not run is known to
+        not be able to run in the next cycle if nothing has changed,
+        and that it runs once resources free up
+        """
+        a = {'Resource_List.select': '1:ncpus=8'}
+        (jid1, ) = self.submit_jobs(1, a)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+
+        a = {'Resource_List.select': '1:ncpus=4'}
+        jids = self.submit_jobs(3, a)
+        self.scheduler.run_scheduling_cycle()
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(
+            "1 job equivalence classes can not run since the previous cycle",
+            starttime=t)
+
+        self.server.delete(jid1, wait=True)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[0])
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[1])
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jids[2])
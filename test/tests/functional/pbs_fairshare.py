@@ -38,6 +38,8 @@
 # subject to Altair's trademark licensing policies.
 
 
+import struct
+
 from tests.functional import *
 
 
@@ -63,6 +65,37 @@ class TestFairshare(TestFunctional):
         self.scheduler.fairshare.set_fairshare_usage(TEST_USER1, 100)
         self.scheduler.fairshare.set_fairshare_usage(TEST_USER3, 1000)
 
+    # struct usage_journal_header and struct group_node_usage_v2
+    jnl_header = struct.Struct('@9sdQ')
+    jnl_record = struct.Struct('@50sd')
+
+    def write_usage_journal(self, records, usage_ino=None, tail=b''):
+        """
+        Write sched_priv/usage.journal with the given (name, usage)
+        records.  The journal is tied to the inode of the current usage
+        file unless usage_ino is given.  tail is appended after the
+        records to simulate a record torn by a crash.
+        """
+        usage = os.path.join(self.server.pbs_conf['PBS_HOME'], 'sched_priv',
+                             'usage')
+        if usage_ino is None:
+            ret = self.du.run_cmd(self.scheduler.hostname,
+                                  ['stat', '-c', '%i', usage], sudo=True)
+            self.assertEqual(ret['rc'], 0)
+            usage_ino = int(ret['out'][0])
+        body = self.jnl_header.pack(b'PBS_JNL!', 1, usage_ino)
+        for name, val in records:
+            body += self.jnl_record.pack(str(name).encode(), val)
+        body += tail
+        fn = self.du.create_temp_file()
+        with open(fn, 'wb') as f:
+            f.write(body)
+        ret = self.du.run_copy(self.scheduler.hostname, src=fn,
+                               dest=usage + '.journal', sudo=True,
+                               uid='root', gid='root', mode=0o644)
+        self.assertEqual(ret['rc'], 0)
+        return usage + '.journal'
+
     def test_formula_keyword(self):
         """
         Test to see if 'fairshare_tree_usage' and 'fairshare_perc' are allowed
@@ -458,3 +491,77 @@ class TestFairshare(TestFunctional):
         self.server.expect(JOB, {'job_state': 'R'}, id=jid3, offset=15)
         self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': True})
         self.server.expect(JOB, {'job_state': 'R'}, id=jid1, offset=15)
+
+    def test_usage_journal_replay(self):
+        """
+        Test that usage appended to the usage journal is replayed on top of
+        the usage file
+        """
+        self.scheduler.add_to_resource_group(TEST_USER, 10, 'root', 50)
+        self.scheduler.add_to_resource_group(TEST_USER1, 11, 'root', 50)
+        self.scheduler.fairshare.set_fairshare_usage(TEST_USER, 100)
+        self.scheduler.fairshare.set_fairshare_usage(TEST_USER1, 100)
+        self.write_usage_journal([(TEST_USER, 300), (TEST_USER, 500)])
+
+        fs = self.scheduler.fairshare.query_fairshare(name=str(TEST_USER))
+        self.assertEqual(fs.usage, 500)
+        fs = self.scheduler.fairshare.query_fairshare(name=str(TEST_USER1))
+        self.assertEqual(fs.usage, 100)
+
+    def test_usage_journal_stale(self):
+        """
+        Test that a usage journal started on a usage file which has since
+        been replaced is ignored
+        """
+        self.scheduler.add_to_resource_group(TEST_USER, 10, 'root', 50)
+        self.scheduler.fairshare.set_fairshare_usage(TEST_USER, 100)
+        usage = os.path.join(self.server.pbs_conf['PBS_HOME'], 'sched_priv',
+                             'usage')
+        ret = self.du.run_cmd(self.scheduler.hostname,
+                              ['stat', '-c', '%i', usage], sudo=True)
+        self.assertEqual(ret['rc'], 0)
+        self.write_usage_journal([(TEST_USER, 500)],
+                                 usage_ino=int(ret['out'][0]) + 1)
+
+        fs = self.scheduler.fairshare.query_fairshare(name=str(TEST_USER))
+        self.assertEqual(fs.usage, 100)
+
+    def test_usage_journal_torn_tail(self):
+        """
+        Test that a record torn by a crash at the end of the usage journal
+        is ignored, and that the scheduler does not append new records
+        after it but writes out the whole usage file instead
+        """
+        self.scheduler.set_sched_config({'fair_share': 'True'})
+        self.scheduler.add_to_resource_group(TEST_USER, 10, 'root', 50)
+        self.scheduler.add_to_resource_group(TEST_USER1, 11, 'root', 50)
+        self.scheduler.fairshare.set_fairshare_usage(TEST_USER, 100)
+        jnl = self.write_usage_journal([(TEST_USER, 500)],
+                                       tail=b'\x01' * 10)
+
+        fs = self.scheduler.fairshare.query_fairshare(name=str(TEST_USER))
+        self.assertEqual(fs.usage, 500)
+
+        # the scheduler reads the usage and its journal when it starts
+        self.scheduler.restart()
+        self.server.manager(MGR_CMD_SET, SCHED, {'log_events': 4095})
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        j = Job(TEST_USER1)
+        jid = self.server.submit(j)
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        # usage is saved at the start of a cycle with jobs running
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match('Usage Sync', starttime=t)
+
+        if self.du.isfile(self.scheduler.hostname, path=jnl, sudo=True):
+            ret = self.du.run_cmd(self.scheduler.hostname,
+                                  ['stat', '-c', '%s', jnl], sudo=True)
+            self.assertEqual(ret['rc'], 0)
+            size = int(ret['out'][0]) - self.jnl_header.size
+            self.assertEqual(size % self.jnl_record.size, 0,
+                             'Usage journal ends in a torn record')
+
+        fs = self.scheduler.fairshare.query_fairshare(name=str(TEST_USER))
+        self.assertEqual(fs.usage, 500)
@@ -72,3 +72,32 @@ class TestJobSortFormula(TestFunctional):
             self.assertEqual(job.split('.')[0], c.political_order[i])
 
         self.server.expect(JOB, {'job_state=R': 2})
+
+    def test_job_sort_formula_arithmetic(self):
+        """
+        Test that formulas are evaluated with python's arithmetic
+        (precedence, floor division, modulo and math functions), and
+        that formulas using other python constructs still work
+        """
+        self.server.manager(MGR_CMD_SET, SCHED, {'log_events': 2047})
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+
+        formula = '-ncpus**2 + 7//ncpus + -7%ncpus + sqrt(ncpus) * max(1, 2)'
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_sort_formula': formula},
+                            runas=ROOT_USER)
+        j1 = Job(TEST_USER, attrs={'Resource_List.ncpus': 4})
+        jid1 = self.server.submit(j1)
+        self.scheduler.run_scheduling_cycle()
+        msg = ';Formula Evaluation = '
+        self.scheduler.log_match(str(jid1) + msg + '-10')
+        self.server.deljob(jid1, wait=True)
+
+        formula = 'ncpus * 3 if ncpus > 2 else ncpus'
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_sort_formula': formula},
+                            runas=ROOT_USER)
+        j2 = Job(TEST_USER, attrs={'Resource_List.ncpus': 4})
+        jid2 = self.server.submit(j2)
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(str(jid2) + msg + '12')
@@ -898,6 +898,79 @@ class TestNodeBuckets(TestFunctional):
         for node in n1:
             self.assertTrue(node not in n2, 'Jobs share nodes: ' + node)
 
+    @timeout(900)
+    def test_chunks_from_bucket_runs(self):
+        """
+        Test that a job whose chunks come from long runs of nodes in two
+        buckets gets the right nodes for each chunk
+        """
+        chunk = '100:ncpus=1:color=red+100:ncpus=1:color=orange'
+        a = {'Resource_List.select': chunk,
+             'Resource_List.place': 'excl'}
+        j = Job(TEST_USER, attrs=a)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.scheduler.log_match(jid + ';Chunk: ' + chunk, n=10000)
+
+        s = self.server.status(JOB, 'exec_vnode', id=jid)
+        n = j.get_vnodes(s[0]['exec_vnode'])
+        self.assertEqual(len(n), 200,
+                         'job did not run on correct number of nodes')
+        self.assertEqual(len(set(n)), 200, 'job got a node twice')
+
+        # Nodes 0-1429 are red and nodes 1430-2859 are orange
+        inds = [int(x.split('[')[1].rstrip(']')) for x in n]
+        for ind in inds[:100]:
+            self.assertLess(ind, 1430, 'red chunk not on a red node')
+        for ind in inds[100:]:
+            self.assertTrue(1430 <= ind < 2860,
+                            'orange chunk not on an orange node')
+
+    @timeout(900)
+    def test_buckets_kept_across_cycles(self):
+        """
+        Test that node buckets kept from an earlier cycle follow nodes
+        whose resources or state change between cycles
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        v1 = self.mom.shortname + '[0]'
+        v2 = self.mom.shortname + '[1]'
+
+        a = {'Resource_List.select': '1:ncpus=1:color=black',
+             'Resource_List.place': 'excl'}
+        j1 = Job(TEST_USER, attrs=a)
+        jid1 = self.server.submit(j1)
+        j2 = Job(TEST_USER, attrs=a)
+        jid2 = self.server.submit(j2)
+
+        # No node is black yet
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid1)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.color': 'black'}, id=v1)
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+        s1 = self.server.status(JOB, 'exec_vnode', id=jid1)
+        self.assertEqual(j1.get_vnodes(s1[0]['exec_vnode']), [v1])
+
+        # An offline node leaves its bucket
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.color': 'black',
+                             'state': 'offline'}, id=v2)
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+
+        # and comes back to it once it is online again
+        self.server.manager(MGR_CMD_SET, NODE, {'state': (DECR, 'offline')},
+                            id=v2)
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
+        s2 = self.server.status(JOB, 'exec_vnode', id=jid2)
+        self.assertEqual(j2.get_vnodes(s2[0]['exec_vnode']), [v2])
+
     @timeout(900)
     @skip("issue 2334")
     def test_queue_nodes(self):
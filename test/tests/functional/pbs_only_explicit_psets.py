@@ -77,3 +77,26 @@ class Test_explicit_psets(TestFunctional):
         c = "Can Never Run: can't fit in the largest placement set,\
  and can't span psets"
         self.server.expect(JOB, {'comment': c}, id=jid)
+
+    def test_equal_psets_ordered_by_name(self):
+        """
+        Test that of two placement sets with the same resources, the job
+        is placed in the one whose name sorts first, not in the one whose
+        nodes come first
+        """
+        a = {'resources_available.ncpus': 2}
+        self.mom.create_vnodes(attrib=a, num=2, usenatvnode=False)
+        vn0 = self.mom.shortname + '[0]'
+        vn1 = self.mom.shortname + '[1]'
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.foo': 'b'}, id=vn0)
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.foo': 'a'}, id=vn1)
+
+        a = {'Resource_List.select': '1:ncpus=1',
+             'Resource_List.place': 'group=foo'}
+        j = Job(TEST_USER, attrs=a)
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        s = self.server.status(JOB, 'exec_vnode', id=jid)
+        self.assertEqual(j.get_vnodes(s[0]['exec_vnode']), [vn1])
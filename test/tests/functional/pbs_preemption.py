@@ -826,3 +826,30 @@ exit 3
         self.server.expect(JOB, {'job_state': 'R'}, id=hjid)
         self.server.expect(JOB, {'job_state=R': 5})
         self.server.expect(JOB, {'job_state=S': 1})
+
+    def test_no_candidates_not_simulated(self):
+        """
+        Test that when no running job can be preempted, the scheduler
+        says so before it simulates any preemption
+        """
+        self.server.manager(MGR_CMD_SET, SCHED, {'preempt_order': 'R'})
+
+        # in CLI mode Rerunnable requires a 'n' value
+        m = self.server.get_op_mode()
+        self.server.set_op_mode(PTL_CLI)
+        j1 = Job(TEST_USER, {'Rerunable': 'n'})
+        jid1 = self.server.submit(j1)
+        self.server.set_op_mode(m)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+
+        start_time = time.time()
+        j2 = Job(TEST_USER, {ATTR_q: 'expressq'})
+        jid2 = self.server.submit(j2)
+        self.scheduler.log_match(
+            jid2 + ";Found no preemptable candidates, not simulating "
+            "preemption", starttime=start_time)
+        self.scheduler.log_match(
+            ";Simulation: preempting job", existence=False,
+            starttime=start_time, max_attempts=5)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
@@ -0,0 +1,81 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+import json
+
+from tests.functional import *
+
+
+class TestSchedCycleStats(TestFunctional):
+    """
+    Test the scheduler's cycle_stats sched_config option
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.ncpus': 1},
+                            id=self.mom.shortname)
+        self.scheduler.set_sched_config({'cycle_stats': 'true'})
+        self.server.manager(MGR_CMD_SET, MGR_OBJ_SERVER,
+                            {'scheduling': 'False'})
+
+    def test_cycle_stats_written(self):
+        """
+        Test that a cycle's statistics are written to sched_priv
+        """
+        jid1 = self.server.submit(Job(attrs={'Resource_List.ncpus': 1}))
+        jid2 = self.server.submit(Job(attrs={'Resource_List.ncpus': 1}))
+
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+
+        fn = os.path.join(os.path.dirname(self.scheduler.sched_config_file),
+                          'cycle_stats.json')
+        ret = self.du.cat(self.scheduler.hostname, filename=fn, sudo=True)
+        self.assertEqual(ret['rc'], 0)
+        stats = json.loads('\n'.join(ret['out']))
+
+        for phase in ['query', 'sort', 'node_search', 'updates']:
+            self.assertIn(phase, stats['phases'])
+        self.assertEqual(stats['phases']['query']['calls'], 1)
+        self.assertEqual(stats['counts']['jobs'], 2)
+        self.assertEqual(stats['counts']['jobs_considered'], 2)
+        self.assertEqual(stats['counts']['jobs_run'], 1)
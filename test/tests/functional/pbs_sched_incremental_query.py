@@ -0,0 +1,111 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestSchedIncrementalQuery(TestFunctional):
+    """
+    Test the scheduler's incremental_query sched_config option
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.server.manager(MGR_CMD_SET, NODE,
+                            {'resources_available.ncpus': 1},
+                            id=self.mom.shortname)
+        self.scheduler.set_sched_config({'incremental_query': 'true'})
+        self.server.manager(MGR_CMD_SET, SCHED, {'log_events': 2047},
+                            id='default')
+        self.server.manager(MGR_CMD_SET, MGR_OBJ_SERVER,
+                            {'scheduling': 'False'})
+
+    def test_unchanged_jobs_reused(self):
+        """
+        Test that unchanged queued jobs are cached across cycles and
+        that a changed job is seen with its new values
+        """
+        j1 = Job(attrs={'Resource_List.ncpus': 1})
+        jid1 = self.server.submit(j1)
+        j2 = Job(attrs={'Resource_List.ncpus': 2})
+        jid2 = self.server.submit(j2)
+
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(r'[1-9]\d* unchanged jobs cached',
+                                 regexp=True, starttime=t)
+        self.scheduler.log_match(jid2 + ';Reusing job from the query cache',
+                                 starttime=t)
+
+        # The job changed, so it must not be taken from the cache
+        self.server.delete(jid1, wait=True)
+        self.server.alterjob(jid2, {'Resource_List.ncpus': 1})
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(jid2 + ';Reusing job from the query cache',
+                                 starttime=t, existence=False,
+                                 max_attempts=2)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
+
+    def test_moved_job_not_reused(self):
+        """
+        Test that a job moved to another queue is requeried
+        """
+        a = {'queue_type': 'execution', 'started': 'True',
+             'enabled': 'True'}
+        self.server.manager(MGR_CMD_CREATE, QUEUE, a, id='workq2')
+        self.server.manager(MGR_CMD_SET, QUEUE, {'started': 'False'},
+                            id='workq')
+
+        jid = self.server.submit(Job(attrs={'Resource_List.ncpus': 1}))
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid)
+
+        self.server.movejob(jid, 'workq2')
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match(jid + ';Reusing job from the query cache',
+                                 starttime=t, existence=False,
+                                 max_attempts=2)
+        self.server.expect(JOB, {'job_state': 'R', 'queue': 'workq2'},
+                           id=jid)
@@ -394,3 +394,42 @@ e.accept()"""
         self.server.expect(JOB, a, id=jid)
         self.server.log_match("Type 96 request", starttime=t1, max_attempts=5,
                               existence=False)
+
+    def test_run_job_window_reject(self):
+        """
+        Test that when run_job_window lets the scheduler send several run
+        requests before reading their replies, a job rejected by a runjob
+        hook stays queued with the hook's reason in its comment, and the
+        other jobs sent in the same window still run
+        """
+        a = {'resources_available.ncpus': 4}
+        self.server.manager(MGR_CMD_SET, NODE, a, id=self.mom.shortname)
+        self.server.manager(MGR_CMD_SET, SCHED,
+                            {'job_run_wait': 'runjob_hook'})
+        self.scheduler.set_sched_config({'run_job_window': '4'})
+
+        hook_txt = """
+import pbs
+
+e = pbs.event()
+if e.job.Job_Name == "rejectme":
+    e.reject("%s: job refused" % (e.hook_name))
+e.accept()"""
+        hk_attrs = {'event': 'runjob'}
+        self.server.create_import_hook('rj', hk_attrs, hook_txt)
+
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        jids = []
+        for i in range(4):
+            j = Job(TEST_USER, {'Resource_List.select': '1:ncpus=1'})
+            if i == 1:
+                j.set_attributes({ATTR_N: 'rejectme'})
+            jids.append(self.server.submit(j))
+
+        self.scheduler.run_scheduling_cycle()
+
+        a = {'job_state': 'Q',
+             'comment': (MATCH_RE, 'Not Running: PBS Error: .*job refused')}
+        self.server.expect(JOB, a, id=jids[1], attrop=PTL_AND)
+        for jid in jids[0:1] + jids[2:]:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
@@ -0,0 +1,76 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2021 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of both the OpenPBS software ("OpenPBS")
+# and the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# OpenPBS is free software. You can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the
+# Free Software Foundation, either version 3 of the License, or (at your
+# option) any later version.
+#
+# OpenPBS is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Affero General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# PBS Pro is commercially licensed software that shares a common core with
+# the OpenPBS software.  For a copy of the commercial license terms and
+# conditions, go to: (http://www.pbspro.com/agreement.html) or contact the
+# Altair Legal Department.
+#
+# Altair's dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of OpenPBS and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair's trademarks, including but not limited to "PBS™",
+# "OpenPBS®", "PBS Professional®", and "PBS Pro™" and Altair's logos is
+# subject to Altair's trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestSchedSnapshot(TestFunctional):
+    """
+    Test the scheduler's capture_snapshot sched_config option
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.scheduler.set_sched_config({'capture_snapshot': 'true'})
+        self.server.manager(MGR_CMD_SET, MGR_OBJ_SERVER,
+                            {'scheduling': 'False'})
+
+    def test_snapshot_written(self):
+        """
+        Test that the replies of a cycle are written to sched_priv
+        """
+        jid = self.server.submit(Job())
+
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+
+        fn = os.path.join(os.path.dirname(self.scheduler.sched_config_file),
+                          'snapshot')
+        ret = self.du.cat(self.scheduler.hostname, filename=fn, sudo=True)
+        self.assertEqual(ret['rc'], 0)
+        lines = ret['out']
+
+        self.assertEqual(lines[0], 'PBS_SCHED_SNAPSHOT\t1')
+        self.assertIn('N\tdefault', lines)
+        for req in ['sched', 'rsc', 'server', 'queue', 'node']:
+            self.assertTrue([l for l in lines
+                             if l.startswith('R\t' + req)])
+        self.assertIn('R\tjob\tworkq', lines)
+        self.assertIn('O\t' + jid, lines)
+        self.assertIn('O\t' + self.mom.shortname, lines)
@@ -66,9 +66,11 @@ class TestServerDynRes(TestFunctional):
         self.scheduler.log_match(fp + ' file has a non-secure file access',
                                  starttime=match_from, existence=exist)
 
-    def setup_dyn_res(self, resname, restype, script_body):
+    def setup_dyn_res(self, resname, restype, script_body, cache_time=None):
         """
         Helper function to setup server dynamic resources
+        cache_time, if set, is the number of seconds the output of each
+        script is reused for
         returns a list of dynamic resource scripts created by the function
         """
         self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
@@ -84,6 +86,8 @@ class TestServerDynRes(TestFunctional):
                                                           script_body[i],
                                                           prefix="svr_resc",
                                                           suffix=".scr")
+            if cache_time is not None:
+                name += ' ' + str(cache_time)
             val.append('"' + name + ' ' + '!' + dest_file + '"')
             scripts.append(dest_file)
         a = {'server_dyn_res': val}
@@ -595,6 +599,70 @@ class TestServerDynRes(TestFunctional):
         a = {'job_state': 'Q', 'comment': job_comment}
         self.server.expect(JOB, a, id=jid, attrop=PTL_AND)
 
+    def test_res_cache_time(self):
+        """
+        Test that the output of a server_dyn_res script with a cache time
+        is reused until the cache time has passed, and that the script is
+        run again after that
+        """
+        self.server.manager(MGR_CMD_SET, SCHED, {'log_events': 2047})
+
+        resname = ["foo"]
+        restype = ["long"]
+        resval = ["date +%s"]
+
+        t = time.time()
+        filenames = self.setup_dyn_res(resname, restype, resval,
+                                       cache_time=10)
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        self.scheduler.run_scheduling_cycle()
+        msg = "%s = " % filenames[0]
+        _, line = self.scheduler.log_match(msg, starttime=t)
+        val = line.split(msg)[1].split()[0]
+
+        # Within the cache time the script is not run again
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.scheduler.log_match("%s%s (cached)" % (msg, val), starttime=t)
+
+        # Once the cache time has passed, the script is run again
+        self.logger.info('Sleeping 10 seconds for the cached value to expire')
+        time.sleep(10)
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        _, line = self.scheduler.log_match(msg, starttime=t)
+        self.assertNotIn('(cached)', line)
+        self.assertNotEqual(line.split(msg)[1].split()[0], val)
+
+    def test_res_concurrent(self):
+        """
+        Test that server_dyn_res scripts are run at the same time, so that
+        several slow scripts all finish within one server_dyn_res_alarm
+        """
+        self.server.manager(MGR_CMD_SET, SCHED,
+                            {ATTR_sched_server_dyn_res_alarm: 5})
+
+        resname = ["foo1", "foo2", "foo3"]
+        restype = ["long", "long", "long"]
+        resval = ["sleep 3\necho 4"] * 3
+
+        filenames = self.setup_dyn_res(resname, restype, resval)
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+
+        a = {'Resource_List.foo1': 4, 'Resource_List.foo2': 4,
+             'Resource_List.foo3': 4}
+        j = Job(TEST_USER, attrs=a)
+        jid = self.server.submit(j)
+
+        # Run one after another, the scripts would take 9 seconds
+        t = time.time()
+        self.scheduler.run_scheduling_cycle()
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.assertLess(time.time() - t, 9)
+        for f in filenames:
+            self.scheduler.log_match("%s timed out" % f, starttime=t,
+                                     existence=False, max_attempts=2)
+
     def test_svr_dyn_res_permissions(self):
         """
         Test whether scheduler rejects the server_dyn_res script when the